@@ -19,24 +19,40 @@
  *
  */
 
+#include <assert.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <vector>
+
 #include "7zCrc.h"
 #include "7z.h"
 
 #include "common-alloc.h"
 #include "common-buffer.h"
+#include "common-timing.h"
 
 // Limit maximum size to avoid running into timeouts with too large data.
 static const size_t kMaxInputSize = 100 * 1024;
 
+// Small enough so solid blocks get evicted from the cache.
+static const size_t kFolderCacheSize = 16 * 1024;
+
+struct ExtractResult {
+  bool extracted = false;
+  SRes res;
+  size_t size;
+  UInt32 crc;
+};
+
 extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
-  if (size > kMaxInputSize) {
+  if (IsInputTooLarge(size, kMaxInputSize)) {
     return 0;
   }
 
+  ScopedInputTimer timer(data, size);
+
   CSzArEx db;
   SRes res;
   UInt16 *temp = nullptr;
@@ -44,16 +60,19 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
   UInt32 blockIndex = 0xFFFFFFFF; /* it can have any value before first call (if outBuffer = 0) */
   Byte *outBuffer = 0; /* it must be 0 before first call for each new archive. */
   size_t outBufferSize = 0;  /* it can have any value before first call (if outBuffer = 0) */
+  std::vector<ExtractResult> results;
+  CSzFolderCache cache;
 
   CrcGenerateTable();
   SzArEx_Init(&db);
 
   InputLookBuffer buffer(data, size);
-  res = SzArEx_Open(&db, buffer.stream(), &CommonAlloc, &CommonAlloc);
+  res = SzArEx_Open(&db, buffer.stream(), &CommonAlloc, &CommonAllocTemp);
   if (res != SZ_OK) {
     goto exit;
   }
 
+  results.resize(db.NumFiles);
   for (UInt32 i = 0; i < db.NumFiles; i++) {
     size_t offset = 0;
     size_t outSizeProcessed = 0;
@@ -75,11 +94,39 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
       continue;
     }
 
-    SzArEx_Extract(&db, buffer.stream(), i, &blockIndex, &outBuffer,
-        &outBufferSize, &offset, &outSizeProcessed, &CommonAlloc, &CommonAlloc);
+    res = SzArEx_Extract(&db, buffer.stream(), i, &blockIndex, &outBuffer,
+        &outBufferSize, &offset, &outSizeProcessed, &CommonAlloc, &CommonAllocTemp);
+    timer.add_decoded_size(outSizeProcessed);
+    results[i].extracted = true;
+    results[i].res = res;
+    results[i].size = outSizeProcessed;
+    if (res == SZ_OK) {
+      results[i].crc = CrcCalc(outBuffer + offset, outSizeProcessed);
+    }
   }
   ISzAlloc_Free(&CommonAlloc, outBuffer);
 
+  // Extract the files again in reverse order through a folder cache, the
+  // data must match the extraction with the single cached solid block.
+  SzFolderCache_Init(&cache, kFolderCacheSize);
+  for (UInt32 i = db.NumFiles; i-- > 0;) {
+    if (!results[i].extracted) {
+      continue;
+    }
+
+    const Byte *cacheBuffer;
+    size_t offset;
+    size_t outSizeProcessed;
+    res = SzArEx_ExtractCached(&db, buffer.stream(), i, &cache, &cacheBuffer,
+        &offset, &outSizeProcessed, &CommonAlloc, &CommonAllocTemp);
+    if (res == SZ_OK) {
+      assert(results[i].res == SZ_OK);
+      assert(results[i].size == outSizeProcessed);
+      assert(results[i].crc == CrcCalc(cacheBuffer + offset, outSizeProcessed));
+    }
+  }
+  SzFolderCache_Free(&cache, &CommonAlloc);
+
 exit:
   SzArEx_Free(&db, &CommonAlloc);
   free(temp);
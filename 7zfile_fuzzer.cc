@@ -0,0 +1,133 @@
+/**
+ *
+ * @copyright Copyright (c) 2019 Joachim Bauch <mail@joachim-bauch.de>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+// Compares extracting archives from a memory mapped file (CFileMapInStream)
+// with reading the file through CFileInStream and CLookToRead2.
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "7zCrc.h"
+#include "7z.h"
+#include "7zFile.h"
+
+#include "common-alloc.h"
+
+// Limit maximum size to avoid running into timeouts with too large data.
+static const size_t kMaxInputSize = 100 * 1024;
+
+static const size_t kLookBufferSize = 1 << 14;
+
+struct ExtractResult {
+  SRes res;
+  std::vector<SRes> file_results;
+  std::vector<std::vector<uint8_t>> files;
+};
+
+static void Extract(ILookInStream *stream, ExtractResult *result) {
+  CSzArEx db;
+  UInt32 blockIndex = 0xFFFFFFFF;
+  Byte *outBuffer = nullptr;
+  size_t outBufferSize = 0;
+
+  SzArEx_Init(&db);
+  result->res = SzArEx_Open(&db, stream, &CommonAlloc, &CommonAllocTemp);
+  if (result->res == SZ_OK) {
+    for (UInt32 i = 0; i < db.NumFiles; i++) {
+      if (SzArEx_IsDir(&db, i)) {
+        continue;
+      }
+
+      size_t offset = 0;
+      size_t outSizeProcessed = 0;
+      SRes res = SzArEx_Extract(&db, stream, i, &blockIndex, &outBuffer,
+          &outBufferSize, &offset, &outSizeProcessed, &CommonAlloc,
+          &CommonAllocTemp);
+      result->file_results.push_back(res);
+      if (res == SZ_OK) {
+        result->files.emplace_back(outBuffer + offset,
+            outBuffer + offset + outSizeProcessed);
+      }
+    }
+  }
+  ISzAlloc_Free(&CommonAlloc, outBuffer);
+  SzArEx_Free(&db, &CommonAlloc);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  if (size > kMaxInputSize) {
+    return 0;
+  }
+
+  CrcGenerateTable();
+
+  CSzFile file;
+  File_Construct(&file);
+  file.file = tmpfile();
+  assert(file.file);
+  size_t written = size;
+  WRes wres = File_Write(&file, data, &written);
+  assert(wres == 0 && written == size);
+  fflush(file.file);
+
+  ExtractResult mapped;
+  {
+    CFileMapInStream stream;
+    FileMapInStream_CreateVTable(&stream);
+    FileMapInStream_Construct(&stream);
+    wres = FileMapInStream_Map(&stream, &file);
+    assert(wres == 0 && stream.size == size);
+    FileMapInStream_Advise(&stream, FILE_MAP_ACCESS_RANDOM);
+    Extract(&stream.vt, &mapped);
+    FileMapInStream_Unmap(&stream);
+  }
+
+  ExtractResult buffered;
+  {
+    CFileInStream file_stream;
+    FileInStream_CreateVTable(&file_stream);
+    file_stream.file = file;
+    Int64 pos = 0;
+    wres = File_Seek(&file, &pos, SZ_SEEK_SET);
+    assert(wres == 0);
+
+    CLookToRead2 stream;
+    LookToRead2_CreateVTable(&stream, False);
+    std::vector<Byte> buffer(kLookBufferSize);
+    stream.buf = buffer.data();
+    stream.bufSize = buffer.size();
+    stream.realStream = &file_stream.vt;
+    LookToRead2_Init(&stream);
+    Extract(&stream.vt, &buffered);
+  }
+  File_Close(&file);
+
+  assert(mapped.res == buffered.res);
+  assert(mapped.file_results == buffered.file_results);
+  assert(mapped.files == buffered.files);
+  return 0;
+}
@@ -0,0 +1,302 @@
+/**
+ *
+ * @copyright Copyright (c) 2019 Joachim Bauch <mail@joachim-bauch.de>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+// Compares decoding many small LZMA streams with LzmaDecode (which allocates
+// the probabilities for every stream) against batches of LzmaDecPool_Decode.
+// The records are consecutive slices of the input files. For every mode the
+// throughput of all records and of the slowest batch is reported.
+//
+// Usage: batchdec-benchmark [-level=N] [-batch=N] [-threads=N] [-total=MiB]
+//            <file>...
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "Alloc.h"
+#include "LzmaDec.h"
+#include "LzmaDecPool.h"
+#include "LzmaEnc.h"
+
+static const int kDefaultLevel = 5;
+static const size_t kDefaultBatchSize = 256;
+// Amount of data decoded for every record size.
+static const size_t kDefaultTotalMiB = 16;
+static const size_t kRecordSizes[] = {
+  256, 1024, 4 * 1024, 16 * 1024, 64 * 1024,
+};
+
+typedef std::chrono::steady_clock Clock;
+
+struct Record {
+  const Byte *data;
+  size_t size;
+  std::vector<Byte> encoded;
+  Byte props[LZMA_PROPS_SIZE];
+};
+
+struct Throughput {
+  uint64_t total_ns = 0;
+  // Slowest batch in bytes per nanosecond.
+  double min_batch_rate = 0;
+};
+
+static bool ReadFile(const char *filename, std::vector<uint8_t> *data) {
+  FILE *f = fopen(filename, "rb");
+  if (!f) {
+    return false;
+  }
+
+  uint8_t buffer[64 * 1024];
+  size_t len;
+  while ((len = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+    data->insert(data->end(), buffer, buffer + len);
+  }
+  bool result = !ferror(f);
+  fclose(f);
+  return result;
+}
+
+static bool EncodeRecords(const CLzmaEncProps &props,
+    std::vector<Record> *records) {
+  CLzmaEncHandle enc = LzmaEnc_Create(&g_Alloc);
+  if (!enc) {
+    return false;
+  }
+
+  bool ok = LzmaEnc_SetProps(enc, &props) == SZ_OK;
+  for (size_t i = 0; ok && i < records->size(); i++) {
+    Record &record = (*records)[i];
+    SizeT props_size = LZMA_PROPS_SIZE;
+    record.encoded.resize(record.size + record.size / 2 + 64);
+    SizeT encoded_size = record.encoded.size();
+    LzmaEnc_Reset(enc);
+    ok = LzmaEnc_WriteProperties(enc, record.props, &props_size) == SZ_OK &&
+        LzmaEnc_MemEncode(enc, record.encoded.data(), &encoded_size,
+            record.data, record.size, 0, nullptr, &g_Alloc,
+            &g_BigAlloc) == SZ_OK;
+    record.encoded.resize(encoded_size);
+  }
+  LzmaEnc_Destroy(enc, &g_Alloc, &g_BigAlloc);
+  return ok;
+}
+
+static void AddBatch(Throughput *throughput, size_t size,
+    Clock::time_point start) {
+  uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      Clock::now() - start).count();
+  ns = std::max<uint64_t>(ns, 1);
+  double rate = static_cast<double>(size) / ns;
+  if (!throughput->total_ns || rate < throughput->min_batch_rate) {
+    throughput->min_batch_rate = rate;
+  }
+  throughput->total_ns += ns;
+}
+
+// Decodes every record with LzmaDecode, returns false if an error occurred.
+static bool DecodeSingle(const std::vector<Record> &records,
+    size_t batch_size, std::vector<Byte> *output, Throughput *throughput) {
+  for (size_t first = 0; first < records.size(); first += batch_size) {
+    size_t last = std::min(first + batch_size, records.size());
+    size_t batch_bytes = 0;
+    Clock::time_point start = Clock::now();
+    Byte *dest = output->data();
+    for (size_t i = first; i < last; i++) {
+      const Record &record = records[i];
+      SizeT dest_size = record.size;
+      SizeT src_size = record.encoded.size();
+      ELzmaStatus status;
+      if (LzmaDecode(dest, &dest_size, record.encoded.data(), &src_size,
+          record.props, LZMA_PROPS_SIZE, LZMA_FINISH_END, &status,
+          &g_Alloc) != SZ_OK || dest_size != record.size) {
+        return false;
+      }
+      dest += record.size;
+      batch_bytes += record.size;
+    }
+    AddBatch(throughput, batch_bytes, start);
+  }
+  return true;
+}
+
+// Decodes the records in batches with the same pool, returns false if an
+// error occurred.
+static bool DecodePool(const std::vector<Record> &records, size_t batch_size,
+    unsigned num_threads, std::vector<Byte> *output, Throughput *throughput,
+    unsigned *used_threads) {
+  CLzmaDecPoolHandle pool = LzmaDecPool_Create(&g_Alloc, num_threads);
+  if (!pool) {
+    return false;
+  }
+
+  std::vector<CLzmaDecJob> jobs(batch_size);
+  bool ok = true;
+  *used_threads = 0;
+  for (size_t first = 0; ok && first < records.size(); first += batch_size) {
+    size_t count = std::min(batch_size, records.size() - first);
+    Byte *dest = output->data();
+    for (size_t i = 0; i < count; i++) {
+      const Record &record = records[first + i];
+      CLzmaDecJob &job = jobs[i];
+      job.props = record.props;
+      job.src = record.encoded.data();
+      job.srcLen = record.encoded.size();
+      job.dest = dest;
+      job.destLen = record.size;
+      dest += record.size;
+    }
+
+    CLzmaDecPoolStats stats;
+    Clock::time_point start = Clock::now();
+    ok = LzmaDecPool_Decode(pool, jobs.data(), count, LZMA_FINISH_END,
+        &stats) == SZ_OK && stats.numErrors == 0;
+    AddBatch(throughput, stats.outSize, start);
+    *used_threads = std::max(*used_threads, stats.numThreads);
+  }
+  LzmaDecPool_Destroy(pool);
+  return ok;
+}
+
+static bool VerifyOutput(const std::vector<Record> &records,
+    size_t batch_size, const std::vector<Byte> &output) {
+  // Only the last batch is still in the output buffer.
+  size_t first = (records.size() - 1) / batch_size * batch_size;
+  const Byte *data = output.data();
+  for (size_t i = first; i < records.size(); i++) {
+    if (memcmp(data, records[i].data, records[i].size) != 0) {
+      return false;
+    }
+    data += records[i].size;
+  }
+  return true;
+}
+
+static void PrintThroughput(size_t record_size, size_t num_records,
+    const char *mode, const Throughput &throughput) {
+  double seconds = throughput.total_ns / 1e9;
+  printf("%8zu %8zu %-10s %10.0f %10.1f %10.1f\n", record_size, num_records,
+      mode, num_records / seconds,
+      num_records * record_size / seconds / (1024 * 1024),
+      throughput.min_batch_rate * 1e9 / (1024 * 1024));
+}
+
+static void Usage(const char *program) {
+  fprintf(stderr, "Usage: %s [-level=N] [-batch=N] [-threads=N] "
+      "[-total=MiB] <file>...\n", program);
+}
+
+int main(int argc, char **argv) {
+  int level = kDefaultLevel;
+  size_t batch_size = kDefaultBatchSize;
+  unsigned num_threads = 4;
+  size_t total_mib = kDefaultTotalMiB;
+  std::vector<uint8_t> input;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (!strncmp(arg, "-level=", 7)) {
+      level = atoi(arg + 7);
+    } else if (!strncmp(arg, "-batch=", 7)) {
+      batch_size = strtoul(arg + 7, nullptr, 10);
+    } else if (!strncmp(arg, "-threads=", 9)) {
+      num_threads = static_cast<unsigned>(strtoul(arg + 9, nullptr, 10));
+    } else if (!strncmp(arg, "-total=", 7)) {
+      total_mib = strtoul(arg + 7, nullptr, 10);
+    } else if (arg[0] == '-') {
+      Usage(argv[0]);
+      return 1;
+    } else if (!ReadFile(arg, &input)) {
+      fprintf(stderr, "Could not read %s\n", arg);
+      return 1;
+    }
+  }
+  size_t max_record_size = kRecordSizes[
+      sizeof(kRecordSizes) / sizeof(kRecordSizes[0]) - 1];
+  if (input.size() < max_record_size || !total_mib || !batch_size) {
+    fprintf(stderr, "Need at least %zu bytes of input.\n", max_record_size);
+    Usage(argv[0]);
+    return 1;
+  }
+
+  printf("input: %zu bytes, level: %d, batch: %zu records\n\n", input.size(),
+      level, batch_size);
+  printf("%8s %8s %-10s %10s %10s %10s\n", "size", "records", "mode",
+      "rec/s", "MiB/s", "min MiB/s");
+  for (size_t record_size : kRecordSizes) {
+    std::vector<Record> records(
+        std::max<size_t>(total_mib * 1024 * 1024 / record_size, 1));
+    size_t offset = 0;
+    for (Record &record : records) {
+      if (offset + record_size > input.size()) {
+        offset = 0;
+      }
+      record.data = input.data() + offset;
+      record.size = record_size;
+      offset += record_size;
+    }
+
+    CLzmaEncProps props;
+    LzmaEncProps_Init(&props);
+    props.level = level;
+    props.reduceSize = record_size;
+    if (!EncodeRecords(props, &records)) {
+      fprintf(stderr, "Encoding failed\n");
+      return 1;
+    }
+
+    std::vector<Byte> output(std::min(batch_size, records.size()) *
+        record_size);
+    Throughput single;
+    if (!DecodeSingle(records, batch_size, &output, &single) ||
+        !VerifyOutput(records, batch_size, output)) {
+      fprintf(stderr, "Decoding with LzmaDecode failed\n");
+      return 1;
+    }
+    PrintThroughput(record_size, records.size(), "LzmaDecode", single);
+
+    std::vector<unsigned> thread_counts = {1};
+    if (num_threads > 1) {
+      thread_counts.push_back(num_threads);
+    }
+    for (unsigned threads : thread_counts) {
+      Throughput pool;
+      unsigned used_threads;
+      std::fill(output.begin(), output.end(), 0);
+      if (!DecodePool(records, batch_size, threads, &output, &pool,
+          &used_threads) || !VerifyOutput(records, batch_size, output)) {
+        fprintf(stderr, "Decoding with LzmaDecPool failed\n");
+        return 1;
+      }
+      char mode[32];
+      snprintf(mode, sizeof(mode), "pool/%u", used_threads);
+      PrintThroughput(record_size, records.size(), mode, pool);
+      if (used_threads == 1 && threads != 1) {
+        // Single-threaded build.
+        break;
+      }
+    }
+  }
+  return 0;
+}
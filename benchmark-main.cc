@@ -0,0 +1,201 @@
+/**
+ *
+ * @copyright Copyright (c) 2019 Joachim Bauch <mail@joachim-bauch.de>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+// Standalone driver that replays corpus files through a fuzzer and reports
+// throughput and latency. Used instead of libFuzzer to run the fuzzers as
+// performance regression tests.
+//
+// Usage: <name>_benchmark [-runs=N] [-per_input=0|1] <file or directory>...
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static const int kDefaultRuns = 100;
+
+typedef std::chrono::steady_clock Clock;
+
+struct Input {
+  std::string name;
+  std::vector<uint8_t> data;
+  // Latency of each run in nanoseconds.
+  std::vector<uint64_t> latencies;
+};
+
+static bool ReadFile(const std::string &filename,
+    std::vector<uint8_t> *data) {
+  FILE *f = fopen(filename.c_str(), "rb");
+  if (!f) {
+    return false;
+  }
+
+  uint8_t buffer[64 * 1024];
+  size_t len;
+  while ((len = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+    data->insert(data->end(), buffer, buffer + len);
+  }
+  bool result = !ferror(f);
+  fclose(f);
+  return result;
+}
+
+static bool AddInputs(const std::string &path, std::vector<Input> *inputs) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) {
+    fprintf(stderr, "Could not access %s\n", path.c_str());
+    return false;
+  }
+
+  if (!S_ISDIR(st.st_mode)) {
+    Input input;
+    input.name = path;
+    if (!ReadFile(path, &input.data)) {
+      fprintf(stderr, "Could not read %s\n", path.c_str());
+      return false;
+    }
+    inputs->push_back(std::move(input));
+    return true;
+  }
+
+  DIR *dir = opendir(path.c_str());
+  if (!dir) {
+    fprintf(stderr, "Could not open %s\n", path.c_str());
+    return false;
+  }
+
+  std::vector<std::string> names;
+  while (struct dirent *entry = readdir(dir)) {
+    if (entry->d_name[0] != '.') {
+      names.push_back(entry->d_name);
+    }
+  }
+  closedir(dir);
+  // Process files in a stable order so results can be compared.
+  std::sort(names.begin(), names.end());
+  for (const std::string &name : names) {
+    if (!AddInputs(path + "/" + name, inputs)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static uint64_t Percentile(const std::vector<uint64_t> &sorted,
+    double percentile) {
+  if (sorted.empty()) {
+    return 0;
+  }
+
+  size_t index = static_cast<size_t>(percentile * (sorted.size() - 1) + 0.5);
+  return sorted[index];
+}
+
+static double MegabytesPerSecond(uint64_t bytes, uint64_t nanoseconds) {
+  if (!nanoseconds) {
+    return 0;
+  }
+
+  return (bytes / 1e6) / (nanoseconds / 1e9);
+}
+
+static void Usage(const char *program) {
+  fprintf(stderr,
+      "Usage: %s [-runs=N] [-per_input=0|1] <file or directory>...\n",
+      program);
+}
+
+int main(int argc, char **argv) {
+  int runs = kDefaultRuns;
+  bool per_input = true;
+  std::vector<Input> inputs;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (!strncmp(arg, "-runs=", 6)) {
+      runs = atoi(arg + 6);
+    } else if (!strncmp(arg, "-per_input=", 11)) {
+      per_input = atoi(arg + 11) != 0;
+    } else if (arg[0] == '-') {
+      Usage(argv[0]);
+      return 1;
+    } else if (!AddInputs(arg, &inputs)) {
+      return 1;
+    }
+  }
+  if (inputs.empty() || runs <= 0) {
+    Usage(argv[0]);
+    return 1;
+  }
+
+  uint64_t total_bytes = 0;
+  uint64_t total_ns = 0;
+  std::vector<uint64_t> all_latencies;
+  all_latencies.reserve(inputs.size() * runs);
+  for (int run = 0; run < runs; run++) {
+    for (Input &input : inputs) {
+      Clock::time_point start = Clock::now();
+      LLVMFuzzerTestOneInput(input.data.data(), input.data.size());
+      uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+          Clock::now() - start).count();
+      input.latencies.push_back(ns);
+      all_latencies.push_back(ns);
+      total_bytes += input.data.size();
+      total_ns += ns;
+    }
+  }
+
+  if (per_input) {
+    printf("%10s %10s %10s %10s  %s\n", "bytes", "MB/s", "p50 (us)",
+        "p99 (us)", "input");
+    for (Input &input : inputs) {
+      uint64_t input_ns = 0;
+      for (uint64_t ns : input.latencies) {
+        input_ns += ns;
+      }
+      std::sort(input.latencies.begin(), input.latencies.end());
+      printf("%10zu %10.2f %10.1f %10.1f  %s\n", input.data.size(),
+          MegabytesPerSecond(input.data.size() * runs, input_ns),
+          Percentile(input.latencies, 0.5) / 1e3,
+          Percentile(input.latencies, 0.99) / 1e3, input.name.c_str());
+    }
+    printf("\n");
+  }
+
+  std::sort(all_latencies.begin(), all_latencies.end());
+  printf("inputs: %zu, runs: %d, iterations: %zu\n", inputs.size(), runs,
+      all_latencies.size());
+  printf("iterations/s: %.1f\n",
+      total_ns ? all_latencies.size() / (total_ns / 1e9) : 0);
+  printf("MB/s: %.2f\n", MegabytesPerSecond(total_bytes, total_ns));
+  printf("latency p50: %.1f us, p99: %.1f us\n",
+      Percentile(all_latencies, 0.5) / 1e3,
+      Percentile(all_latencies, 0.99) / 1e3);
+  return 0;
+}
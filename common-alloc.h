@@ -20,7 +20,15 @@
  */
 
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+
+#include <initializer_list>
+#include <map>
+#include <mutex>
+#include <set>
+#include <unordered_map>
 
 #include "7zAlloc.h"
 #include "7zTypes.h"
@@ -32,6 +40,32 @@
 // 0xffffffffffffffff exceeds maximum supported size of 0x200000000".
 static const size_t kMaxAllowedMemory = 2 * 1024 * 1024 * 1024L;
 
+#else
+
+static const size_t kMaxAllowedMemory = SIZE_MAX;
+
+#endif
+
+// The arena allocator below is only used by the benchmark binaries, which
+// define "COMMON_ALLOC_USE_ARENA". Fuzzers always use malloc, so sanitizers see
+// every allocation and libFuzzer's "-malloc_limit_mb" and RSS limits apply.
+// Sanitizer builds use malloc also for the benchmarks, this can also be forced
+// by defining "COMMON_ALLOC_USE_MALLOC".
+#if !defined(COMMON_ALLOC_USE_ARENA)
+#define COMMON_ALLOC_USE_MALLOC
+#endif
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(memory_sanitizer) || \
+    __has_feature(thread_sanitizer)
+#define COMMON_ALLOC_USE_MALLOC
+#endif
+#endif
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define COMMON_ALLOC_USE_MALLOC
+#endif
+
+#if defined(COMMON_ALLOC_USE_MALLOC)
+
 static void *LzmaAlloc(ISzAllocPtr p, size_t size) {
   if (size > kMaxAllowedMemory) {
     return nullptr;
@@ -44,12 +78,363 @@ static void LzmaFree(ISzAllocPtr p, void *address) {
   SzFree(nullptr, address);
 }
 
-static ISzAlloc CommonAlloc = {LzmaAlloc, LzmaFree};
-
 #else
 
-#include "7zAlloc.h"
+// Bump allocator that keeps its memory across fuzzer iterations. Blocks are
+// taken from one large reserved mapping, so the pages of multi-MiB dictionaries
+// and match finder tables only need to be faulted in once. Freeing the last
+// live block resets the arena in O(1), which happens at the end of every
+// iteration as the fuzzers release all memory they allocated. Blocks that are
+// freed before (e.g. by the workers of the multithreaded decoders) are reused
+// for allocations of up to the same size, so the arena stays at the peak of
+// live memory of an iteration.
+class ArenaAlloc {
+ public:
+  ArenaAlloc();
+  ~ArenaAlloc();
+
+  void *Alloc(size_t size);
+  void Free(void *address);
+
+ private:
+  static const size_t kAlignment = 16;
+  // Only virtual address space, pages are committed when they are used.
+  static const size_t kReservedSize =
+      (sizeof(size_t) >= 8 ? 64 : 1) * 1024 * 1024 * 1024ULL;
+  // Memory above this size is returned to the system on reset.
+  static const size_t kMaxRetainedSize = 256 * 1024 * 1024;
+
+  // Stored in front of every block.
+  struct Header {
+    size_t size;
+    size_t padding;
+  };
+
+  bool Contains(void *address) const {
+    return base_ && address >= base_ && address < base_ + kReservedSize;
+  }
+
+  void *TakeFreeBlock(size_t block_size);
+  void RemoveFreeBlock(Header *header);
+
+  std::mutex mutex_;
+  // Freed blocks below "offset_", by size and by address.
+  std::multimap<size_t, Header*> free_by_size_;
+  std::set<Header*> free_by_address_;
+  uint8_t *base_ = nullptr;
+  size_t offset_ = 0;
+  size_t high_water_ = 0;
+  size_t live_ = 0;
+};
+
+ArenaAlloc::ArenaAlloc() {
+  void *base = mmap(nullptr, kReservedSize, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (base != MAP_FAILED) {
+    base_ = static_cast<uint8_t*>(base);
+  }
+}
+
+ArenaAlloc::~ArenaAlloc() {
+  if (base_) {
+    munmap(base_, kReservedSize);
+  }
+}
+
+// Returns the smallest free block of at least "block_size" bytes. Blocks of
+// more than twice the size are left for larger allocations.
+void *ArenaAlloc::TakeFreeBlock(size_t block_size) {
+  auto it = free_by_size_.lower_bound(block_size);
+  if (it == free_by_size_.end() || it->first / 2 > block_size) {
+    return nullptr;
+  }
+
+  Header *header = it->second;
+  free_by_address_.erase(header);
+  free_by_size_.erase(it);
+  live_++;
+  return header + 1;
+}
+
+void ArenaAlloc::RemoveFreeBlock(Header *header) {
+  auto range = free_by_size_.equal_range(header->size);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second == header) {
+      free_by_size_.erase(it);
+      break;
+    }
+  }
+  free_by_address_.erase(header);
+}
+
+void *ArenaAlloc::Alloc(size_t size) {
+  if (size > kMaxAllowedMemory) {
+    return nullptr;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t block_size = (size + kAlignment - 1) & ~(kAlignment - 1);
+  if (block_size >= size) {
+    if (void *address = TakeFreeBlock(block_size)) {
+      return address;
+    }
+  }
+  if (!base_ || block_size < size ||
+      kReservedSize - offset_ < sizeof(Header) + block_size) {
+    // Fall back to malloc if the arena is not available or exhausted.
+    return SzAlloc(nullptr, size);
+  }
+
+  Header *header = reinterpret_cast<Header*>(base_ + offset_);
+  header->size = block_size;
+  offset_ += sizeof(Header) + block_size;
+  if (offset_ > high_water_) {
+    high_water_ = offset_;
+  }
+  live_++;
+  return header + 1;
+}
+
+void ArenaAlloc::Free(void *address) {
+  if (!address) {
+    return;
+  } else if (!Contains(address)) {
+    SzFree(nullptr, address);
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  Header *header = static_cast<Header*>(address) - 1;
+  if (--live_ == 0) {
+    offset_ = 0;
+    free_by_size_.clear();
+    free_by_address_.clear();
+    if (high_water_ > kMaxRetainedSize) {
+      madvise(base_ + kMaxRetainedSize, high_water_ - kMaxRetainedSize,
+          MADV_DONTNEED);
+      high_water_ = kMaxRetainedSize;
+    }
+  } else if (reinterpret_cast<uint8_t*>(address) + header->size ==
+      base_ + offset_) {
+    // The most recent block can be reused directly, together with the free
+    // blocks right below it.
+    offset_ = reinterpret_cast<uint8_t*>(header) - base_;
+    while (!free_by_address_.empty()) {
+      Header *last = *free_by_address_.rbegin();
+      if (reinterpret_cast<uint8_t*>(last + 1) + last->size !=
+          base_ + offset_) {
+        break;
+      }
+      RemoveFreeBlock(last);
+      offset_ = reinterpret_cast<uint8_t*>(last) - base_;
+    }
+  } else {
+    free_by_size_.emplace(header->size, header);
+    free_by_address_.insert(header);
+  }
+}
 
-static ISzAlloc CommonAlloc = {SzAlloc, SzFree};
+static ArenaAlloc g_ArenaAlloc;
+
+static void *LzmaAlloc(ISzAllocPtr p, size_t size) {
+  return g_ArenaAlloc.Alloc(size);
+}
+
+static void LzmaFree(ISzAllocPtr p, void *address) {
+  g_ArenaAlloc.Free(address);
+}
 
 #endif
+
+// Allocators are passed to the SDK for different purposes, e.g. "alloc" and
+// "allocBig" for LzmaEnc_Create / LzmaEnc_Encode or "alloc" and "allocMid"
+// for XzDecMt_Create. Each purpose is tracked as a separate site.
+enum AllocSite {
+  kAllocSiteAlloc,
+  kAllocSiteAllocBig,
+  kAllocSiteAllocMid,
+  kAllocSiteAllocTemp,
+  kNumAllocSites,
+};
+
+// Records allocation statistics if the environment variable
+// "COMMON_ALLOC_REPORT" contains a filename. The statistics are written to
+// that file as JSON when the process exits.
+class AllocReport {
+ public:
+  AllocReport();
+  ~AllocReport();
+
+  bool enabled() const { return filename_ != nullptr; }
+
+  void OnAlloc(AllocSite site, void *address, size_t size);
+  void OnFree(void *address);
+
+ private:
+  // Histogram bucket "i" counts allocations of up to 2^i bytes.
+  static const int kNumBuckets = 8 * sizeof(size_t) + 1;
+
+  struct Stats {
+    uint64_t count = 0;
+    uint64_t failed = 0;
+    uint64_t bytes = 0;
+    size_t max_size = 0;
+    size_t live_bytes = 0;
+    size_t peak_live_bytes = 0;
+    uint64_t histogram[kNumBuckets] = {0};
+  };
+
+  struct Block {
+    AllocSite site;
+    size_t size;
+  };
+
+  static const char *SiteName(int site);
+  static void WriteStats(FILE *f, const Stats &stats);
+
+  const char *filename_;
+  std::mutex mutex_;
+  std::unordered_map<void*, Block> blocks_;
+  Stats sites_[kNumAllocSites];
+  Stats total_;
+};
+
+AllocReport::AllocReport() : filename_(getenv("COMMON_ALLOC_REPORT")) {
+  if (filename_ && !*filename_) {
+    filename_ = nullptr;
+  }
+}
+
+AllocReport::~AllocReport() {
+  if (!enabled()) {
+    return;
+  }
+
+  FILE *f = fopen(filename_, "w");
+  if (!f) {
+    fprintf(stderr, "Could not write allocation report to %s\n", filename_);
+    return;
+  }
+
+  fprintf(f, "{\n  \"sites\": {\n");
+  for (int site = 0; site < kNumAllocSites; site++) {
+    fprintf(f, "    \"%s\": ", SiteName(site));
+    WriteStats(f, sites_[site]);
+    fprintf(f, "%s\n", site + 1 < kNumAllocSites ? "," : "");
+  }
+  fprintf(f, "  },\n  \"total\": ");
+  WriteStats(f, total_);
+  fprintf(f, "\n}\n");
+  fclose(f);
+}
+
+// static
+const char *AllocReport::SiteName(int site) {
+  switch (site) {
+    case kAllocSiteAlloc:
+      return "alloc";
+    case kAllocSiteAllocBig:
+      return "allocBig";
+    case kAllocSiteAllocMid:
+      return "allocMid";
+    case kAllocSiteAllocTemp:
+      return "allocTemp";
+    default:
+      return "unknown";
+  }
+}
+
+// static
+void AllocReport::WriteStats(FILE *f, const Stats &stats) {
+  fprintf(f, "{\"count\": %llu, \"failed\": %llu, \"bytes\": %llu, "
+      "\"max_size\": %zu, \"peak_live_bytes\": %zu, \"histogram\": {",
+      static_cast<unsigned long long>(stats.count),
+      static_cast<unsigned long long>(stats.failed),
+      static_cast<unsigned long long>(stats.bytes),
+      stats.max_size, stats.peak_live_bytes);
+  bool first = true;
+  for (int i = 0; i < kNumBuckets; i++) {
+    if (!stats.histogram[i]) {
+      continue;
+    }
+
+    // Keys are the upper bound of the bucket.
+    fprintf(f, "%s\"%llu\": %llu", first ? "" : ", ",
+        i < 64 ? 1ULL << i : ~0ULL,
+        static_cast<unsigned long long>(stats.histogram[i]));
+    first = false;
+  }
+  fprintf(f, "}}");
+}
+
+void AllocReport::OnAlloc(AllocSite site, void *address, size_t size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  int bucket = 0;
+  while (bucket < kNumBuckets - 1 && (static_cast<size_t>(1) << bucket) < size) {
+    bucket++;
+  }
+  for (Stats *stats : {&sites_[site], &total_}) {
+    stats->count++;
+    stats->histogram[bucket]++;
+    if (size > stats->max_size) {
+      stats->max_size = size;
+    }
+    if (!address) {
+      stats->failed++;
+      continue;
+    }
+
+    stats->bytes += size;
+    stats->live_bytes += size;
+    if (stats->live_bytes > stats->peak_live_bytes) {
+      stats->peak_live_bytes = stats->live_bytes;
+    }
+  }
+  if (address) {
+    blocks_[address] = {site, size};
+  }
+}
+
+void AllocReport::OnFree(void *address) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = blocks_.find(address);
+  if (it == blocks_.end()) {
+    return;
+  }
+
+  sites_[it->second.site].live_bytes -= it->second.size;
+  total_.live_bytes -= it->second.size;
+  blocks_.erase(it);
+}
+
+static AllocReport g_AllocReport;
+
+template <AllocSite site>
+static void *ReportingAlloc(ISzAllocPtr p, size_t size) {
+  void *address = LzmaAlloc(p, size);
+  if (g_AllocReport.enabled()) {
+    g_AllocReport.OnAlloc(site, address, size);
+  }
+  return address;
+}
+
+static void ReportingFree(ISzAllocPtr p, void *address) {
+  if (address && g_AllocReport.enabled()) {
+    g_AllocReport.OnFree(address);
+  }
+  LzmaFree(p, address);
+}
+
+static ISzAlloc CommonAlloc = {
+  ReportingAlloc<kAllocSiteAlloc>, ReportingFree
+};
+// Not all fuzzers use all types of allocators.
+__attribute__((unused)) static ISzAlloc CommonAllocBig = {
+  ReportingAlloc<kAllocSiteAllocBig>, ReportingFree
+};
+__attribute__((unused)) static ISzAlloc CommonAllocMid = {
+  ReportingAlloc<kAllocSiteAllocMid>, ReportingFree
+};
+__attribute__((unused)) static ISzAlloc CommonAllocTemp = {
+  ReportingAlloc<kAllocSiteAllocTemp>, ReportingFree
+};
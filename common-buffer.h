@@ -24,31 +24,57 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+#include <vector>
+
 #include "7zTypes.h"
 
 class OutputBuffer {
  public:
+  // Contiguous part of the written data.
+  struct Segment {
+    const uint8_t *data;
+    size_t size;
+  };
+
   OutputBuffer();
   ~OutputBuffer();
 
   ISeqOutStream *stream() { return &stream_.vt; };
-  const uint8_t *data() const { return data_; }
+  // Return the written data as contiguous memory. If the data is spread over
+  // multiple segments, they are flattened once and cached until more data is
+  // written. Use the segments directly to avoid the copy.
+  const uint8_t *data();
   size_t size() const { return position_; }
 
+  size_t segment_count() const { return chunks_.size(); }
+  Segment segment(size_t index) const;
+
+  // Compare the written data with "data" without flattening the segments.
+  bool Equals(const uint8_t *data, size_t size) const;
+
  private:
   static const size_t kInitialSize = 128;
+  static const size_t kMaxSegmentSize = 1024 * 1024;
 
   typedef struct {
     ISeqOutStream vt;
     OutputBuffer *buffer;
   } OutputBufferStream;
 
+  struct Chunk {
+    uint8_t *data;
+    size_t size;
+    size_t used;
+  };
+
   static size_t _Write(const ISeqOutStream *pp, const void *data, size_t size);
   size_t Write(const void *data, size_t size);
 
   OutputBufferStream stream_;
-  uint8_t *data_ = nullptr;
-  size_t size_ = 0;
+  std::vector<Chunk> chunks_;
+  uint8_t *flat_ = nullptr;
+  size_t flat_size_ = 0;
   size_t position_ = 0;
 };
 
@@ -58,7 +84,51 @@ OutputBuffer::OutputBuffer() {
 }
 
 OutputBuffer::~OutputBuffer() {
-  free(data_);
+  for (const Chunk &chunk : chunks_) {
+    free(chunk.data);
+  }
+  free(flat_);
+}
+
+const uint8_t *OutputBuffer::data() {
+  if (chunks_.empty()) {
+    return nullptr;
+  } else if (chunks_.size() == 1) {
+    return chunks_[0].data;
+  }
+
+  if (flat_size_ != position_) {
+    free(flat_);
+    flat_ = static_cast<uint8_t*>(malloc(position_));
+    assert(flat_);
+    uint8_t *dest = flat_;
+    for (const Chunk &chunk : chunks_) {
+      memcpy(dest, chunk.data, chunk.used);
+      dest += chunk.used;
+    }
+    flat_size_ = position_;
+  }
+  return flat_;
+}
+
+OutputBuffer::Segment OutputBuffer::segment(size_t index) const {
+  assert(index < chunks_.size());
+  const Chunk &chunk = chunks_[index];
+  return {chunk.data, chunk.used};
+}
+
+bool OutputBuffer::Equals(const uint8_t *data, size_t size) const {
+  if (size != position_) {
+    return false;
+  }
+
+  for (const Chunk &chunk : chunks_) {
+    if (memcmp(data, chunk.data, chunk.used) != 0) {
+      return false;
+    }
+    data += chunk.used;
+  }
+  return true;
 }
 
 // static
@@ -69,24 +139,34 @@ size_t OutputBuffer::_Write(const ISeqOutStream *p, const void *data,
 }
 
 size_t OutputBuffer::Write(const void *data, size_t size) {
-  size_t available = size_ - position_;
-  if (available < size) {
-    if (!size_) {
-      size_ = kInitialSize;
-    }
-    while (size_ - position_ < size) {
-      size_ *= 2;
-    }
-    uint8_t *tmp = static_cast<uint8_t*>(malloc(size_));
-    assert(tmp);
-    if (data_) {
-      memcpy(tmp, data_, position_);
-      free(data_);
+  const uint8_t *src = static_cast<const uint8_t*>(data);
+  size_t remaining = size;
+  while (remaining > 0) {
+    if (chunks_.empty() || chunks_.back().used == chunks_.back().size) {
+      // Segments grow exponentially up to a maximum size, existing data is
+      // never moved.
+      size_t chunk_size = kInitialSize;
+      if (!chunks_.empty()) {
+        chunk_size = chunks_.back().size * 2;
+      }
+      while (chunk_size < remaining) {
+        chunk_size *= 2;
+      }
+      if (chunk_size > kMaxSegmentSize) {
+        chunk_size = kMaxSegmentSize;
+      }
+      uint8_t *tmp = static_cast<uint8_t*>(malloc(chunk_size));
+      assert(tmp);
+      chunks_.push_back({tmp, chunk_size, 0});
     }
-    data_ = tmp;
-  }
 
-  memcpy(data_ + position_, data, size);
+    Chunk &chunk = chunks_.back();
+    size_t len = std::min(remaining, chunk.size - chunk.used);
+    memcpy(chunk.data + chunk.used, src, len);
+    chunk.used += len;
+    src += len;
+    remaining -= len;
+  }
   position_ += size;
   return size;
 }
@@ -96,15 +176,18 @@ class OutputByteBuffer {
   OutputByteBuffer();
   ~OutputByteBuffer();
 
-  IByteOut *stream() { return &stream_.vt; };
+  IByteOut *stream() { return &stream_.buf.vt; };
+  // Byte coders that support CByteOutBuf write into the free space of the
+  // buffer directly and only call the stream if the buffer must grow.
+  CByteOutBuf *buf_stream() { return &stream_.buf; };
   const uint8_t *data() const { return data_; }
-  size_t size() const { return position_; }
+  size_t size() const { return stream_.buf.Cur - data_; }
 
  private:
   static const size_t kInitialSize = 128;
 
   typedef struct {
-    IByteOut vt;
+    CByteOutBuf buf;
     OutputByteBuffer *buffer;
   } ByteOutStream;
 
@@ -114,11 +197,11 @@ class OutputByteBuffer {
   ByteOutStream stream_;
   uint8_t *data_ = nullptr;
   size_t size_ = 0;
-  size_t position_ = 0;
 };
 
 OutputByteBuffer::OutputByteBuffer() {
-  stream_.vt.Write = &OutputByteBuffer::_Write;
+  stream_.buf.vt.Write = &OutputByteBuffer::_Write;
+  stream_.buf.Cur = stream_.buf.Lim = nullptr;
   stream_.buffer = this;
 }
 
@@ -128,12 +211,13 @@ OutputByteBuffer::~OutputByteBuffer() {
 
 // static
 void OutputByteBuffer::_Write(const IByteOut *p, Byte b) {
-  ByteOutStream *stream = CONTAINER_FROM_VTBL(p, ByteOutStream, vt);
+  ByteOutStream *stream = CONTAINER_FROM_VTBL(p, ByteOutStream, buf.vt);
   stream->buffer->Write(b);
 }
 
 void OutputByteBuffer::Write(Byte b) {
-  if (size_ == position_) {
+  if (stream_.buf.Cur == stream_.buf.Lim) {
+    size_t position = size();
     if (!size_) {
       size_ = kInitialSize;
     } else {
@@ -142,18 +226,22 @@ void OutputByteBuffer::Write(Byte b) {
     uint8_t *tmp = static_cast<uint8_t*>(malloc(size_));
     assert(tmp);
     if (data_) {
-      memcpy(tmp, data_, position_);
+      memcpy(tmp, data_, position);
       free(data_);
     }
     data_ = tmp;
+    stream_.buf.Cur = data_ + position;
+    stream_.buf.Lim = data_ + size_;
   }
 
-  data_[position_++] = b;
+  *stream_.buf.Cur++ = b;
 }
 
 class InputBuffer {
  public:
   InputBuffer(const uint8_t *data, size_t size);
+  // Read the segments of "buffer" without flattening them.
+  explicit InputBuffer(const OutputBuffer &buffer);
 
   ISeqInStream *stream() { return &stream_.vt; };
 
@@ -169,6 +257,8 @@ class InputBuffer {
   InputBufferStream stream_;
   const uint8_t *data_;
   size_t size_;
+  const OutputBuffer *segments_ = nullptr;
+  size_t segment_ = 0;
 };
 
 InputBuffer::InputBuffer(const uint8_t *data, size_t size)
@@ -177,6 +267,12 @@ InputBuffer::InputBuffer(const uint8_t *data, size_t size)
   stream_.buffer = this;
 }
 
+InputBuffer::InputBuffer(const OutputBuffer &buffer)
+  : data_(nullptr), size_(0), segments_(&buffer) {
+  stream_.vt.Read = &InputBuffer::_Read;
+  stream_.buffer = this;
+}
+
 // static
 SRes InputBuffer::_Read(const ISeqInStream *p, void *data, size_t *size) {
   InputBufferStream *stream = CONTAINER_FROM_VTBL(p, InputBufferStream, vt);
@@ -184,6 +280,11 @@ SRes InputBuffer::_Read(const ISeqInStream *p, void *data, size_t *size) {
 }
 
 SRes InputBuffer::Read(void *data, size_t *size) {
+  if (!size_ && segments_ && segment_ < segments_->segment_count()) {
+    OutputBuffer::Segment segment = segments_->segment(segment_++);
+    data_ = segment.data;
+    size_ = segment.size;
+  }
   if (size_ < *size) {
     *size = size_;
   }
@@ -199,11 +300,14 @@ class InputByteBuffer {
  public:
   InputByteBuffer(const uint8_t *data, size_t size);
 
-  IByteIn *stream() { return &stream_.vt; };
+  IByteIn *stream() { return &stream_.buf.vt; };
+  // Byte coders that support CByteInBuf read the data directly and only call
+  // the stream at the end of the data.
+  CByteInBuf *buf_stream() { return &stream_.buf; };
 
  private:
   typedef struct {
-    IByteIn vt;
+    CByteInBuf buf;
     InputByteBuffer *buffer;
   } ByteInStream;
 
@@ -211,29 +315,27 @@ class InputByteBuffer {
   Byte Read();
 
   ByteInStream stream_;
-  const uint8_t *data_;
-  size_t size_;
-  size_t position_ = 0;
 };
 
-InputByteBuffer::InputByteBuffer(const uint8_t *data, size_t size)
-  : data_(data), size_(size) {
-  stream_.vt.Read = &InputByteBuffer::_Read;
+InputByteBuffer::InputByteBuffer(const uint8_t *data, size_t size) {
+  stream_.buf.vt.Read = &InputByteBuffer::_Read;
+  stream_.buf.Cur = data;
+  stream_.buf.Lim = data + size;
   stream_.buffer = this;
 }
 
 // static
 Byte InputByteBuffer::_Read(const IByteIn *p) {
-  ByteInStream *stream = CONTAINER_FROM_VTBL(p, ByteInStream, vt);
+  ByteInStream *stream = CONTAINER_FROM_VTBL(p, ByteInStream, buf.vt);
   return stream->buffer->Read();
 }
 
 Byte InputByteBuffer::Read() {
-  if (size_ == position_) {
+  if (stream_.buf.Cur == stream_.buf.Lim) {
     return 0;
   }
 
-  return data_[position_++];
+  return *stream_.buf.Cur++;
 }
 
 class InputLookBuffer {
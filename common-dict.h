@@ -0,0 +1,192 @@
+/**
+ *
+ * @copyright Copyright (c) 2019 Joachim Bauch <mail@joachim-bauch.de>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+// Training of preset dictionaries (LzmaEnc_SetPresetDict) and initial
+// probabilities (LzmaEnc_SetPresetProbs) from sample records.
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "Alloc.h"
+#include "LzmaEnc.h"
+
+struct DictSample {
+  const uint8_t *data;
+  size_t size;
+};
+
+// The dictionary is built from segments of this size.
+static const size_t kDictSegmentSize = 64;
+// Length of the substrings that are counted.
+static const size_t kDictGramSize = 8;
+static const int kDictHashBits = 20;
+
+static uint32_t DictHashGram(const uint8_t *data) {
+  uint64_t value;
+  memcpy(&value, data, sizeof(value));
+  return static_cast<uint32_t>(
+      (value * 0x9E3779B97F4A7C15ULL) >> (64 - kDictHashBits));
+}
+
+// Return the unique substring hashes of a segment in "hashes".
+static void DictSegmentHashes(const uint8_t *data, size_t size,
+    std::vector<uint32_t> *hashes) {
+  hashes->clear();
+  for (size_t i = 0; i + kDictGramSize <= size; i++) {
+    hashes->push_back(DictHashGram(data + i));
+  }
+  std::sort(hashes->begin(), hashes->end());
+  hashes->erase(std::unique(hashes->begin(), hashes->end()), hashes->end());
+}
+
+// Build a dictionary of up to "dict_size" bytes. Every substring is scored by
+// the number of samples that contain it, the segments with the highest sum
+// of scores are selected greedily. Substrings of a selected segment don't
+// count for the following segments. The most valuable segments are stored at
+// the end of the dictionary, so they get the shortest distances.
+static void TrainDictionary(const std::vector<DictSample> &samples,
+    size_t dict_size, std::vector<uint8_t> *dict) {
+  std::vector<uint32_t> counts(static_cast<size_t>(1) << kDictHashBits);
+  std::vector<uint32_t> last_sample(counts.size(), UINT32_MAX);
+  for (size_t s = 0; s < samples.size(); s++) {
+    const DictSample &sample = samples[s];
+    for (size_t i = 0; i + kDictGramSize <= sample.size; i++) {
+      uint32_t hash = DictHashGram(sample.data + i);
+      if (last_sample[hash] != s) {
+        last_sample[hash] = static_cast<uint32_t>(s);
+        counts[hash]++;
+      }
+    }
+  }
+
+  std::vector<DictSample> segments;
+  for (const DictSample &sample : samples) {
+    for (size_t offset = 0; offset + kDictGramSize <= sample.size;
+        offset += kDictSegmentSize) {
+      segments.push_back({sample.data + offset,
+          std::min(kDictSegmentSize, sample.size - offset)});
+    }
+  }
+
+  // Substrings that occur in a single sample don't help other records.
+  std::vector<uint32_t> hashes;
+  auto score = [&](const DictSample &segment) {
+    uint64_t result = 0;
+    DictSegmentHashes(segment.data, segment.size, &hashes);
+    for (uint32_t hash : hashes) {
+      if (counts[hash] > 1) {
+        result += counts[hash];
+      }
+    }
+    return result;
+  };
+
+  // Scores only decrease, so a segment whose updated score is still the
+  // highest one can be selected without rescoring the others.
+  std::priority_queue<std::pair<uint64_t, size_t>> queue;
+  for (size_t i = 0; i < segments.size(); i++) {
+    uint64_t value = score(segments[i]);
+    if (value) {
+      queue.push(std::make_pair(value, i));
+    }
+  }
+
+  std::vector<DictSample> selected;
+  size_t total = 0;
+  while (total < dict_size && !queue.empty()) {
+    std::pair<uint64_t, size_t> top = queue.top();
+    queue.pop();
+    const DictSample &segment = segments[top.second];
+    uint64_t value = score(segment);
+    if (!value) {
+      continue;
+    } else if (value < top.first && !queue.empty() &&
+        value < queue.top().first) {
+      queue.push(std::make_pair(value, top.second));
+      continue;
+    }
+
+    size_t size = std::min(segment.size, dict_size - total);
+    selected.push_back({segment.data + segment.size - size, size});
+    total += size;
+    for (uint32_t hash : hashes) {
+      counts[hash] = 0;
+    }
+  }
+
+  dict->clear();
+  dict->reserve(total);
+  for (auto it = selected.rbegin(); it != selected.rend(); ++it) {
+    dict->insert(dict->end(), it->data, it->data + it->size);
+  }
+}
+
+// Encode every sample with the dictionary and average the final
+// probabilities of the encoder. Return false if an error occurred.
+static bool TrainProbs(const CLzmaEncProps &props,
+    const std::vector<uint8_t> &dict, const std::vector<DictSample> &samples,
+    std::vector<UInt16> *probs) {
+  CLzmaEncProps enc_props = props;
+  if (enc_props.dictSize < dict.size()) {
+    enc_props.dictSize = static_cast<UInt32>(dict.size());
+  }
+  CLzmaEncHandle enc = LzmaEnc_Create(&g_Alloc);
+  if (!enc) {
+    return false;
+  }
+
+  bool ok = LzmaEnc_SetProps(enc, &enc_props) == SZ_OK &&
+      LzmaEnc_SetPresetDict(enc, dict.data(), dict.size()) == SZ_OK;
+  std::vector<UInt16> current(ok ? LzmaEnc_GetNumProbs(enc) : 0);
+  std::vector<uint64_t> sums(current.size());
+  std::vector<Byte> encoded;
+  size_t count = 0;
+  for (size_t i = 0; ok && i < samples.size(); i++) {
+    const DictSample &sample = samples[i];
+    encoded.resize(sample.size + sample.size / 2 + 64);
+    SizeT encoded_size = encoded.size();
+    LzmaEnc_Reset(enc);
+    ok = LzmaEnc_MemEncode(enc, encoded.data(), &encoded_size, sample.data,
+        sample.size, 0, nullptr, &g_Alloc, &g_BigAlloc) == SZ_OK;
+    if (ok && sample.size) {
+      LzmaEnc_GetProbs(enc, current.data());
+      for (size_t j = 0; j < current.size(); j++) {
+        sums[j] += current[j];
+      }
+      count++;
+    }
+  }
+  LzmaEnc_Destroy(enc, &g_Alloc, &g_BigAlloc);
+  if (!ok || !count) {
+    return false;
+  }
+
+  probs->resize(sums.size());
+  for (size_t j = 0; j < sums.size(); j++) {
+    (*probs)[j] = static_cast<UInt16>((sums[j] + count / 2) / count);
+  }
+  return true;
+}
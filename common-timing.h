@@ -0,0 +1,273 @@
+/**
+ *
+ * @copyright Copyright (c) 2019 Joachim Bauch <mail@joachim-bauch.de>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+static const size_t kDefaultSlowInputsCount = 10;
+static const std::chrono::seconds kSlowInputsReportInterval(1);
+
+// Times every input if the environment variable "COMMON_SLOW_INPUTS" contains
+// a directory name. A latency histogram and the slowest inputs are written to
+// that directory. The number of slowest inputs to keep can be set with
+// "COMMON_SLOW_INPUTS_COUNT" (default: 10).
+//
+// libFuzzer exits without running static destructors on timeouts, crashes
+// and OOMs, so an input is written as soon as it is one of the slowest and
+// the histogram is rewritten at least every second. The input that exceeded
+// the timeout itself is saved by libFuzzer.
+class InputTiming {
+ public:
+  InputTiming();
+  ~InputTiming();
+
+  bool enabled() const { return directory_ != nullptr; }
+
+  void OnInput(const uint8_t *data, size_t size, size_t decoded_size,
+      uint64_t nanoseconds);
+  void OnTooLargeInput() { too_large_count_++; }
+
+ private:
+  // Histogram bucket "i" counts inputs that took up to 2^i nanoseconds.
+  static const int kNumBuckets = 64;
+
+  struct SlowInput {
+    uint64_t nanoseconds;
+    size_t decoded_size;
+    std::vector<uint8_t> data;
+    // The input is stored as "slow-<slot>".
+    size_t slot;
+
+    bool operator>(const SlowInput &other) const {
+      return nanoseconds > other.nanoseconds;
+    }
+  };
+
+  std::string SlotName(size_t slot) const {
+    return "slow-" + std::to_string(slot);
+  }
+  bool WriteInput(const SlowInput &input);
+  void WriteReport();
+
+  const char *directory_;
+  size_t max_slow_inputs_ = kDefaultSlowInputsCount;
+  uint64_t count_ = 0;
+  uint64_t too_large_count_ = 0;
+  uint64_t total_nanoseconds_ = 0;
+  uint64_t histogram_[kNumBuckets] = {0};
+  // Min-heap, the fastest of the slow inputs is at the front.
+  std::vector<SlowInput> slow_inputs_;
+  std::chrono::steady_clock::time_point last_report_;
+};
+
+InputTiming::InputTiming() : directory_(getenv("COMMON_SLOW_INPUTS")) {
+  if (directory_ && !*directory_) {
+    directory_ = nullptr;
+  }
+  const char *count = getenv("COMMON_SLOW_INPUTS_COUNT");
+  if (count && *count) {
+    max_slow_inputs_ = strtoul(count, nullptr, 10);
+  }
+  last_report_ = std::chrono::steady_clock::now();
+}
+
+InputTiming::~InputTiming() {
+  if (!enabled()) {
+    return;
+  }
+
+  WriteReport();
+}
+
+void InputTiming::WriteReport() {
+  last_report_ = std::chrono::steady_clock::now();
+  std::vector<SlowInput> slowest(slow_inputs_);
+  std::sort_heap(slowest.begin(), slowest.end(), std::greater<SlowInput>());
+
+  // Written to a temporary file first, so the report is always complete if
+  // the process is killed.
+  std::string filename = std::string(directory_) + "/slow-inputs.json";
+  std::string temp_filename = filename + ".tmp";
+  FILE *f = fopen(temp_filename.c_str(), "w");
+  if (!f) {
+    fprintf(stderr, "Could not write input timings to %s\n",
+        temp_filename.c_str());
+    return;
+  }
+
+  fprintf(f, "{\n  \"count\": %llu,\n  \"too_large\": %llu,\n"
+      "  \"total_ns\": %llu,\n  \"histogram\": {",
+      static_cast<unsigned long long>(count_),
+      static_cast<unsigned long long>(too_large_count_),
+      static_cast<unsigned long long>(total_nanoseconds_));
+  bool first = true;
+  for (int i = 0; i < kNumBuckets; i++) {
+    if (!histogram_[i]) {
+      continue;
+    }
+
+    // Keys are the upper bound of the bucket in nanoseconds.
+    fprintf(f, "%s\"%llu\": %llu", first ? "" : ", ", 1ULL << i,
+        static_cast<unsigned long long>(histogram_[i]));
+    first = false;
+  }
+  fprintf(f, "},\n  \"slowest\": [");
+  for (size_t i = 0; i < slowest.size(); i++) {
+    const SlowInput &input = slowest[i];
+    fprintf(f, "%s\n    {\"file\": \"%s\", \"ns\": %llu, \"size\": %zu, "
+        "\"decoded_size\": %zu, \"ratio\": %.2f}", i ? "," : "",
+        SlotName(input.slot).c_str(),
+        static_cast<unsigned long long>(input.nanoseconds),
+        input.data.size(), input.decoded_size,
+        input.data.empty()
+            ? 0 : static_cast<double>(input.decoded_size) / input.data.size());
+  }
+  fprintf(f, "\n  ]\n}\n");
+  if (fclose(f) != 0 || rename(temp_filename.c_str(), filename.c_str()) != 0) {
+    fprintf(stderr, "Could not write input timings to %s\n",
+        filename.c_str());
+  }
+}
+
+bool InputTiming::WriteInput(const SlowInput &input) {
+  std::string filename = std::string(directory_) + "/" +
+      SlotName(input.slot);
+  FILE *f = fopen(filename.c_str(), "wb");
+  if (!f) {
+    fprintf(stderr, "Could not write slow input to %s\n", filename.c_str());
+    return false;
+  }
+
+  bool result = fwrite(input.data.data(), 1, input.data.size(), f) ==
+      input.data.size();
+  fclose(f);
+  return result;
+}
+
+void InputTiming::OnInput(const uint8_t *data, size_t size,
+    size_t decoded_size, uint64_t nanoseconds) {
+  int bucket = 0;
+  while (bucket < kNumBuckets - 1 && (1ULL << bucket) < nanoseconds) {
+    bucket++;
+  }
+  count_++;
+  total_nanoseconds_ += nanoseconds;
+  histogram_[bucket]++;
+
+  bool changed = false;
+  if (max_slow_inputs_ && (slow_inputs_.size() < max_slow_inputs_ ||
+      nanoseconds > slow_inputs_.front().nanoseconds)) {
+    changed = true;
+    // Inputs can be run multiple times (e.g. by the benchmarks), only keep
+    // the slowest run of each.
+    bool found = false;
+    for (SlowInput &input : slow_inputs_) {
+      if (input.data.size() == size &&
+          std::equal(input.data.begin(), input.data.end(), data)) {
+        if (nanoseconds > input.nanoseconds) {
+          input.nanoseconds = nanoseconds;
+          std::make_heap(slow_inputs_.begin(), slow_inputs_.end(),
+              std::greater<SlowInput>());
+        }
+        found = true;
+        break;
+      }
+    }
+
+    if (!found) {
+      // The new input takes the file of the input it replaces.
+      size_t slot = slow_inputs_.size();
+      if (slow_inputs_.size() == max_slow_inputs_) {
+        std::pop_heap(slow_inputs_.begin(), slow_inputs_.end(),
+            std::greater<SlowInput>());
+        slot = slow_inputs_.back().slot;
+        slow_inputs_.pop_back();
+      }
+      slow_inputs_.push_back({nanoseconds, decoded_size,
+          std::vector<uint8_t>(data, data + size), slot});
+      WriteInput(slow_inputs_.back());
+      std::push_heap(slow_inputs_.begin(), slow_inputs_.end(),
+          std::greater<SlowInput>());
+    }
+  }
+
+  if (changed || count_ % 1024 == 0) {
+    std::chrono::steady_clock::time_point now =
+        std::chrono::steady_clock::now();
+    if (now - last_report_ >= kSlowInputsReportInterval) {
+      WriteReport();
+    }
+  }
+}
+
+static InputTiming g_InputTiming;
+
+// Returns true if the input is larger than the limit of the fuzzer. Such
+// inputs are counted separately instead of being timed as fast rejects.
+static inline bool IsInputTooLarge(size_t size, size_t max_size) {
+  if (size <= max_size) {
+    return false;
+  }
+
+  if (g_InputTiming.enabled()) {
+    g_InputTiming.OnTooLargeInput();
+  }
+  return true;
+}
+
+// Times the fuzzer input for the lifetime of the object. Fuzzers should
+// create it after rejecting inputs with IsInputTooLarge, but before other
+// checks so rejected inputs are timed, too.
+class ScopedInputTimer {
+ public:
+  ScopedInputTimer(const uint8_t *data, size_t size)
+    : data_(data), size_(size) {
+    if (g_InputTiming.enabled()) {
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~ScopedInputTimer() {
+    if (!g_InputTiming.enabled()) {
+      return;
+    }
+
+    uint64_t nanoseconds =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_).count();
+    g_InputTiming.OnInput(data_, size_, decoded_size_, nanoseconds);
+  }
+
+  void add_decoded_size(size_t size) { decoded_size_ += size; }
+
+ private:
+  const uint8_t *data_;
+  size_t size_;
+  size_t decoded_size_ = 0;
+  std::chrono::steady_clock::time_point start_;
+};
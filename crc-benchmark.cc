@@ -0,0 +1,161 @@
+/**
+ *
+ * @copyright Copyright (c) 2019 Joachim Bauch <mail@joachim-bauch.de>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+// Compares the speed of the CRC functions selected for the CPU with the
+// table versions and, for CRC32, every implementation CrcGenerateTable can
+// select. Random buffers of 64 bytes to 1 MiB are checksummed until the given
+// amount of data was processed, the best run of each is reported in GB/s.
+//
+// Usage: crc-benchmark [-size=MiB] [-runs=N]
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "7zCrc.h"
+#include "CpuArch.h"
+#include "XzCrc64.h"
+
+static const size_t kDefaultSizeMiB = 256;
+static const int kDefaultRuns = 3;
+static const size_t kBufferSizes[] = {
+  64, 256, 4 * 1024, 64 * 1024, 1024 * 1024,
+};
+static const char *kCrcFuncNames[CRC_FUNC_NUM] = {
+  "T1", "T4", "T8", "T16", "CLMUL",
+};
+
+typedef std::chrono::steady_clock Clock;
+
+// Returns the best time of processing "total" bytes in buffers of "size"
+// bytes with "func". The buffers start at an odd address.
+template <typename T, typename F>
+static uint64_t Measure(F func, const std::vector<uint8_t> &data, size_t size,
+    size_t total, int runs, T *result) {
+  uint64_t best = 0;
+  for (int i = 0; i < runs; i++) {
+    T v = 0;
+    Clock::time_point start = Clock::now();
+    for (size_t done = 0; done < total; done += size) {
+      v = func(v, data.data() + 1, size);
+    }
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now() - start).count();
+    ns = std::max<uint64_t>(ns, 1);
+    if (!best || ns < best) {
+      best = ns;
+    }
+    *result = v;
+  }
+  return best;
+}
+
+static void Usage(const char *program) {
+  fprintf(stderr, "Usage: %s [-size=MiB] [-runs=N]\n", program);
+}
+
+int main(int argc, char **argv) {
+  size_t size_mib = kDefaultSizeMiB;
+  int runs = kDefaultRuns;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (!strncmp(arg, "-size=", 6)) {
+      size_mib = strtoul(arg + 6, nullptr, 10);
+    } else if (!strncmp(arg, "-runs=", 6)) {
+      runs = atoi(arg + 6);
+    } else {
+      Usage(argv[0]);
+      return 1;
+    }
+  }
+  if (!size_mib || runs < 1) {
+    Usage(argv[0]);
+    return 1;
+  }
+
+  CrcGenerateTable();
+  Crc64GenerateTable();
+
+  size_t max_size = *std::max_element(std::begin(kBufferSizes),
+      std::end(kBufferSizes));
+  std::vector<uint8_t> data(max_size + 1);
+  std::mt19937 rng(1);
+  for (uint8_t &b : data) {
+    b = static_cast<uint8_t>(rng());
+  }
+  size_t total = size_mib * 1024 * 1024;
+
+#ifdef MY_CPU_X86_OR_AMD64
+  printf("PCLMULQDQ: %s\n\n", CPU_IsSupported_PCLMUL() ? "yes" : "no");
+#endif
+  printf("%-6s %8s %8s %8s %8s\n", "crc64", "buffer", "table", "selected",
+      "speedup");
+  for (size_t size : kBufferSizes) {
+    UInt64 table_crc, crc;
+    uint64_t table_ns = Measure(Crc64UpdateTable, data, size, total, runs,
+        &table_crc);
+    uint64_t ns = Measure(Crc64Update, data, size, total, runs, &crc);
+    if (crc != table_crc) {
+      fprintf(stderr, "CRC64 mismatch for %zu bytes\n", size);
+      return 1;
+    }
+    printf("%-6s %8zu %8.2f %8.2f %7.2fx\n", "", size,
+        static_cast<double>(total) / table_ns,
+        static_cast<double>(total) / ns,
+        static_cast<double>(table_ns) / ns);
+  }
+
+  printf("\n%-6s %8s", "crc32", "buffer");
+  for (unsigned id = 0; id < CRC_FUNC_NUM; id++) {
+    printf(" %8s", kCrcFuncNames[id]);
+  }
+  printf(" %8s\n", "selected");
+  for (size_t size : kBufferSizes) {
+    UInt32 expected;
+    uint64_t ns = Measure(CrcUpdate, data, size, total, runs, &expected);
+    printf("%-6s %8zu", "", size);
+    for (unsigned id = 0; id < CRC_FUNC_NUM; id++) {
+      CRC_FUNC func = CrcGetFunc(id);
+      if (!func) {
+        printf(" %8s", "-");
+        continue;
+      }
+      UInt32 crc;
+      uint64_t func_ns = Measure([func](UInt32 v, const void *p, size_t n) {
+        return func(v, p, n, g_CrcTable);
+      }, data, size, total, runs, &crc);
+      if (crc != expected) {
+        fprintf(stderr, "CRC32 mismatch of %s for %zu bytes\n",
+            kCrcFuncNames[id], size);
+        return 1;
+      }
+      printf(" %8.2f", static_cast<double>(total) / func_ns);
+    }
+    printf(" %8.2f\n", static_cast<double>(total) / ns);
+  }
+  return 0;
+}
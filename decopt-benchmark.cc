@@ -0,0 +1,174 @@
+/**
+ *
+ * @copyright Copyright (c) 2019 Joachim Bauch <mail@joachim-bauch.de>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+// Compares the decoding speed of the optimized decoding loop ("LzmaDecOpt.c")
+// with the generic loop of "LzmaDec.c". Every input file is encoded with the
+// given levels and decoded several times with both loops, the best run of
+// each is reported.
+//
+// Usage: decopt-benchmark [-runs=N] <file>...
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "Alloc.h"
+#include "LzmaDec.h"
+#include "LzmaEnc.h"
+
+static const int kDefaultRuns = 5;
+static const int kLevels[] = {
+  1, 5, 9,
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static bool ReadFile(const char *filename, std::vector<uint8_t> *data) {
+  FILE *f = fopen(filename, "rb");
+  if (!f) {
+    return false;
+  }
+
+  uint8_t buffer[64 * 1024];
+  size_t len;
+  while ((len = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+    data->insert(data->end(), buffer, buffer + len);
+  }
+  bool result = !ferror(f);
+  fclose(f);
+  return result;
+}
+
+static bool Encode(const std::vector<uint8_t> &input, int level,
+    std::vector<Byte> *encoded, Byte *props) {
+  CLzmaEncProps enc_props;
+  LzmaEncProps_Init(&enc_props);
+  enc_props.level = level;
+  enc_props.reduceSize = input.size();
+  encoded->resize(input.size() + input.size() / 2 + 64);
+  SizeT encoded_size = encoded->size();
+  SizeT props_size = LZMA_PROPS_SIZE;
+  SRes res = LzmaEncode(encoded->data(), &encoded_size, input.data(),
+      input.size(), &enc_props, props, &props_size, 0, nullptr, &g_Alloc,
+      &g_BigAlloc);
+  encoded->resize(encoded_size);
+  return res == SZ_OK;
+}
+
+// Returns the best decoding time in nanoseconds, or 0 if decoding failed.
+static uint64_t Decode(const std::vector<Byte> &encoded, const Byte *props,
+    const std::vector<uint8_t> &input, int runs) {
+  std::vector<Byte> output(input.size());
+  uint64_t best = 0;
+  for (int i = 0; i < runs; i++) {
+    SizeT dest_size = output.size();
+    SizeT src_size = encoded.size();
+    ELzmaStatus status;
+    Clock::time_point start = Clock::now();
+    SRes res = LzmaDecode(output.data(), &dest_size, encoded.data(),
+        &src_size, props, LZMA_PROPS_SIZE, LZMA_FINISH_END, &status,
+        &g_Alloc);
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now() - start).count();
+    if (res != SZ_OK || dest_size != input.size() ||
+        memcmp(output.data(), input.data(), input.size()) != 0) {
+      return 0;
+    }
+    ns = std::max<uint64_t>(ns, 1);
+    if (!best || ns < best) {
+      best = ns;
+    }
+  }
+  return best;
+}
+
+static void Usage(const char *program) {
+  fprintf(stderr, "Usage: %s [-runs=N] <file>...\n", program);
+}
+
+int main(int argc, char **argv) {
+  int runs = kDefaultRuns;
+  std::vector<const char *> filenames;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (!strncmp(arg, "-runs=", 6)) {
+      runs = atoi(arg + 6);
+    } else if (arg[0] == '-') {
+      Usage(argv[0]);
+      return 1;
+    } else {
+      filenames.push_back(arg);
+    }
+  }
+  if (filenames.empty() || runs < 1) {
+    Usage(argv[0]);
+    return 1;
+  }
+
+#ifndef _LZMA_DEC_OPT
+  printf("built without _LZMA_DEC_OPT, only the generic loop is used\n\n");
+#endif
+  printf("%-32s %5s %10s %10s %12s %12s %8s\n", "file", "level", "size",
+      "encoded", "generic MB/s", "opt MB/s", "speedup");
+  for (const char *filename : filenames) {
+    std::vector<uint8_t> input;
+    if (!ReadFile(filename, &input)) {
+      fprintf(stderr, "Could not read %s\n", filename);
+      return 1;
+    }
+    if (input.empty()) {
+      continue;
+    }
+
+    for (int level : kLevels) {
+      std::vector<Byte> encoded;
+      Byte props[LZMA_PROPS_SIZE];
+      if (!Encode(input, level, &encoded, props)) {
+        fprintf(stderr, "Encoding %s failed\n", filename);
+        return 1;
+      }
+
+#ifdef _LZMA_DEC_OPT
+      LzmaDec_SetDecodeOpt(False);
+#endif
+      uint64_t generic_ns = Decode(encoded, props, input, runs);
+#ifdef _LZMA_DEC_OPT
+      LzmaDec_SetDecodeOpt(True);
+#endif
+      uint64_t opt_ns = Decode(encoded, props, input, runs);
+      if (!generic_ns || !opt_ns) {
+        fprintf(stderr, "Decoding %s failed\n", filename);
+        return 1;
+      }
+
+      printf("%-32s %5d %10zu %10zu %12.1f %12.1f %7.2fx\n", filename, level,
+          input.size(), encoded.size(), input.size() * 1e3 / generic_ns,
+          input.size() * 1e3 / opt_ns,
+          static_cast<double>(generic_ns) / opt_ns);
+    }
+  }
+  return 0;
+}
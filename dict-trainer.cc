@@ -0,0 +1,157 @@
+/**
+ *
+ * @copyright Copyright (c) 2019 Joachim Bauch <mail@joachim-bauch.de>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+// Trains a preset dictionary for LzmaEnc_SetPresetDict / LzmaDec_InitPreset
+// from sample files. Every file is a sample, "-record=N" splits the files
+// into samples of N bytes instead. "-probs=file" also writes the initial
+// probabilities for LzmaEnc_SetPresetProbs: one byte with the "lc", "lp" and
+// "pb" properties (as in the LZMA header) followed by the probabilities as
+// 16 bit little endian values.
+//
+// Usage: dict-trainer [-size=KiB] [-record=N] [-level=N] [-probs=file]
+//            -o=file <file>...
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "common-dict.h"
+
+static const size_t kDefaultDictKiB = 64;
+static const int kDefaultLevel = 5;
+
+static bool ReadFile(const char *filename, std::vector<uint8_t> *data) {
+  FILE *f = fopen(filename, "rb");
+  if (!f) {
+    return false;
+  }
+
+  uint8_t buffer[64 * 1024];
+  size_t len;
+  while ((len = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+    data->insert(data->end(), buffer, buffer + len);
+  }
+  bool result = !ferror(f);
+  fclose(f);
+  return result;
+}
+
+static bool WriteFile(const char *filename, const void *data, size_t size) {
+  FILE *f = fopen(filename, "wb");
+  if (!f) {
+    return false;
+  }
+
+  bool result = fwrite(data, 1, size, f) == size;
+  return fclose(f) == 0 && result;
+}
+
+static void Usage(const char *program) {
+  fprintf(stderr, "Usage: %s [-size=KiB] [-record=N] [-level=N] "
+      "[-probs=file] -o=file <file>...\n", program);
+}
+
+int main(int argc, char **argv) {
+  size_t dict_kib = kDefaultDictKiB;
+  size_t record_size = 0;
+  int level = kDefaultLevel;
+  const char *output = nullptr;
+  const char *probs_output = nullptr;
+  std::vector<std::vector<uint8_t>> files;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (!strncmp(arg, "-size=", 6)) {
+      dict_kib = strtoul(arg + 6, nullptr, 10);
+    } else if (!strncmp(arg, "-record=", 8)) {
+      record_size = strtoul(arg + 8, nullptr, 10);
+    } else if (!strncmp(arg, "-level=", 7)) {
+      level = atoi(arg + 7);
+    } else if (!strncmp(arg, "-probs=", 7)) {
+      probs_output = arg + 7;
+    } else if (!strncmp(arg, "-o=", 3)) {
+      output = arg + 3;
+    } else if (arg[0] == '-') {
+      Usage(argv[0]);
+      return 1;
+    } else {
+      files.emplace_back();
+      if (!ReadFile(arg, &files.back())) {
+        fprintf(stderr, "Could not read %s\n", arg);
+        return 1;
+      }
+    }
+  }
+  if (!output || files.empty() || !dict_kib) {
+    Usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<DictSample> samples;
+  for (const std::vector<uint8_t> &file : files) {
+    size_t step = record_size ? record_size : file.size();
+    for (size_t offset = 0; offset < file.size(); offset += step) {
+      samples.push_back({file.data() + offset,
+          std::min(step, file.size() - offset)});
+    }
+  }
+
+  std::vector<uint8_t> dict;
+  TrainDictionary(samples, dict_kib * 1024, &dict);
+  if (dict.empty()) {
+    fprintf(stderr, "The samples have no common data.\n");
+    return 1;
+  }
+  if (!WriteFile(output, dict.data(), dict.size())) {
+    fprintf(stderr, "Could not write %s\n", output);
+    return 1;
+  }
+  printf("%zu samples, dictionary: %zu bytes\n", samples.size(), dict.size());
+
+  if (probs_output) {
+    CLzmaEncProps props;
+    LzmaEncProps_Init(&props);
+    props.level = level;
+    LzmaEncProps_Normalize(&props);
+    std::vector<UInt16> probs;
+    if (!TrainProbs(props, dict, samples, &probs)) {
+      fprintf(stderr, "Could not train the probabilities.\n");
+      return 1;
+    }
+
+    std::vector<uint8_t> data;
+    data.push_back(static_cast<uint8_t>(
+        (props.pb * 5 + props.lp) * 9 + props.lc));
+    for (UInt16 prob : probs) {
+      data.push_back(static_cast<uint8_t>(prob));
+      data.push_back(static_cast<uint8_t>(prob >> 8));
+    }
+    if (!WriteFile(probs_output, data.data(), data.size())) {
+      fprintf(stderr, "Could not write %s\n", probs_output);
+      return 1;
+    }
+    printf("probabilities: %zu\n", probs.size());
+  }
+  return 0;
+}
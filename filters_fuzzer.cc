@@ -30,6 +30,7 @@
 #include "Aes.h"
 #include "Bra.h"
 #include "Delta.h"
+#include "LzFind.h"
 #include "Sha256.h"
 #include "XzCrc64.h"
 
@@ -52,7 +53,24 @@ class SevenzCrcFuzzer : public FilterFuzzer {
   }
 
   void RunFuzzer() override {
-    CrcCalc(data_, size_);
+    UInt32 crc = CrcCalc(data_, size_);
+    // Compare every implementation that is supported by the CPU with the
+    // selected one, also for data that is split at any position.
+    size_t split = size_ ? data_[0] * size_ / 256 : 0;
+    UInt32 v = CrcUpdate(CRC_INIT_VAL, data_, split);
+    assert(crc == CRC_GET_DIGEST(
+        CrcUpdate(v, data_ + split, size_ - split)));
+    for (unsigned id = 0; id < CRC_FUNC_NUM; id++) {
+      CRC_FUNC func = CrcGetFunc(id);
+      if (!func) {
+        continue;
+      }
+      assert(crc == CRC_GET_DIGEST(
+          func(CRC_INIT_VAL, data_, size_, g_CrcTable)));
+      assert(v == func(CRC_INIT_VAL, data_, split, g_CrcTable));
+      assert(crc == CRC_GET_DIGEST(
+          func(v, data_ + split, size_ - split, g_CrcTable)));
+    }
   }
 };
 
@@ -63,7 +81,18 @@ class XzCrcFuzzer : public FilterFuzzer {
   }
 
   void RunFuzzer() override {
-    Crc64Calc(data_, size_);
+    UInt64 crc = Crc64Calc(data_, size_);
+    // Compare the optimized version (if supported by the CPU) with the
+    // table version, also for data that is split at any position.
+    assert(crc == CRC64_GET_DIGEST(
+        Crc64UpdateTable(CRC64_INIT_VAL, data_, size_)));
+    if (size_) {
+      size_t split = data_[0] * size_ / 256;
+      UInt64 v = Crc64Update(CRC64_INIT_VAL, data_, split);
+      assert(v == Crc64UpdateTable(CRC64_INIT_VAL, data_, split));
+      v = Crc64Update(v, data_ + split, size_ - split);
+      assert(crc == CRC64_GET_DIGEST(v));
+    }
   }
 };
 
@@ -267,6 +296,39 @@ class Sha256Fuzzer : public FilterFuzzer {
   CSha256 sha256_;
 };
 
+class MatchFinderNormalizeFuzzer : public FilterFuzzer {
+ public:
+  MatchFinderNormalizeFuzzer(const uint8_t *data, size_t size)
+    : FilterFuzzer(data, size) {
+    // Selects the optimized implementation of "MatchFinder_Normalize3".
+    CMatchFinder mf;
+    MatchFinder_Construct(&mf);
+  }
+
+  void RunFuzzer() override {
+    if (size_ < sizeof(UInt32)) {
+      return;
+    }
+
+    // The first bytes contain the value to subtract, the remaining data
+    // contains the references to normalize.
+    UInt32 sub_value;
+    memcpy(&sub_value, data_, sizeof(sub_value));
+    size_t count = (size_ - sizeof(sub_value)) / sizeof(CLzRef);
+    CLzRef *items = static_cast<CLzRef*>(malloc(count * sizeof(CLzRef) + 1));
+    assert(items);
+    memcpy(items, data_ + sizeof(sub_value), count * sizeof(CLzRef));
+    MatchFinder_Normalize3(sub_value, items, count);
+    for (size_t i = 0; i < count; i++) {
+      CLzRef value;
+      memcpy(&value, data_ + sizeof(sub_value) + i * sizeof(CLzRef),
+          sizeof(value));
+      assert(items[i] == (value <= sub_value ? 0 : value - sub_value));
+    }
+    free(items);
+  }
+};
+
 extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
   if (!size) {
     return 0;
@@ -281,6 +343,7 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
     new BraSparcFuzzer(data, size),
     new BraX86Fuzzer(data, size),
     new DeltaFuzzer(data, size),
+    new MatchFinderNormalizeFuzzer(data, size),
     new SevenzCrcFuzzer(data, size),
     new Sha256Fuzzer(data, size),
     new XzCrcFuzzer(data, size),
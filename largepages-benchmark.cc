@@ -0,0 +1,336 @@
+/**
+ *
+ * @copyright Copyright (c) 2019 Joachim Bauch <mail@joachim-bauch.de>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+// Compares LZMA encoding and decoding with levels 7 to 9 when the match finder
+// tables and the dictionary are allocated through "g_BigAlloc" with and
+// without huge pages (see "SetLargePageMode" in Alloc.h). Reports throughput,
+// minor page faults and data TLB misses (if perf events are available).
+//
+// Usage: largepages-benchmark [-runs=N] [-size=MiB] [file...]
+//
+// Without files, a compressible input of "-size" MiB (default: 8) is
+// generated.
+
+#include <assert.h>
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "Alloc.h"
+#include "LzmaDec.h"
+#include "LzmaEnc.h"
+
+#ifndef _7ZIP_LINUX_LARGE_PAGES
+#error "Large pages are not available in this build (e.g. with sanitizers)."
+#endif
+
+static const int kDefaultRuns = 1;
+static const size_t kDefaultSizeMiB = 8;
+static const int kMinLevel = 7;
+static const int kMaxLevel = 9;
+
+typedef std::chrono::steady_clock Clock;
+
+struct Mode {
+  const char *name;
+  unsigned mode;
+};
+
+static const Mode kModes[] = {
+  {"none", LARGE_PAGES_MODE_NONE},
+  {"thp", LARGE_PAGES_MODE_THP},
+  {"hugetlb", LARGE_PAGES_MODE_HUGETLB},
+};
+
+struct Counters {
+  uint64_t nanoseconds = 0;
+  uint64_t page_faults = 0;
+  // UINT64_MAX if the TLB misses could not be counted.
+  uint64_t tlb_misses = 0;
+};
+
+// Counts the data TLB misses of the calling thread.
+class TlbMissCounter {
+ public:
+  TlbMissCounter() {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB |
+        (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd_ = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+
+  ~TlbMissCounter() {
+    if (fd_ != -1) {
+      close(fd_);
+    }
+  }
+
+  bool available() const { return fd_ != -1; }
+
+  void Start() {
+    if (available()) {
+      ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+
+  uint64_t Stop() {
+    uint64_t count = 0;
+    if (!available()) {
+      return UINT64_MAX;
+    }
+
+    ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd_, &count, sizeof(count)) != sizeof(count)) {
+      return UINT64_MAX;
+    }
+    return count;
+  }
+
+ private:
+  int fd_;
+};
+
+static uint64_t MinorPageFaults() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_minflt;
+}
+
+// Measures the time, page faults and TLB misses between construction and
+// "Stop".
+class Measurement {
+ public:
+  explicit Measurement(TlbMissCounter *tlb)
+    : tlb_(tlb), page_faults_(MinorPageFaults()), start_(Clock::now()) {
+    tlb_->Start();
+  }
+
+  void Stop(Counters *counters) {
+    uint64_t tlb_misses = tlb_->Stop();
+    counters->nanoseconds +=
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - start_).count();
+    counters->page_faults += MinorPageFaults() - page_faults_;
+    if (tlb_misses == UINT64_MAX || counters->tlb_misses == UINT64_MAX) {
+      counters->tlb_misses = UINT64_MAX;
+    } else {
+      counters->tlb_misses += tlb_misses;
+    }
+  }
+
+ private:
+  TlbMissCounter *tlb_;
+  uint64_t page_faults_;
+  Clock::time_point start_;
+};
+
+static bool ReadFile(const char *filename, std::vector<uint8_t> *data) {
+  FILE *f = fopen(filename, "rb");
+  if (!f) {
+    return false;
+  }
+
+  uint8_t buffer[64 * 1024];
+  size_t len;
+  while ((len = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+    data->insert(data->end(), buffer, buffer + len);
+  }
+  bool result = !ferror(f);
+  fclose(f);
+  return result;
+}
+
+// Text-like data built from a small vocabulary, so matches are found over
+// the whole dictionary.
+static void GenerateInput(size_t size, std::vector<uint8_t> *data) {
+  static const char *kWords[] = {
+    "lzma", "match", "finder", "dictionary", "decoder", "encoder", "range",
+    "literal", "distance", "length", "state", "probability", "stream",
+    "block", "filter", "index", "check", "header", "footer", "padding",
+  };
+  static const size_t kNumWords = sizeof(kWords) / sizeof(kWords[0]);
+  uint32_t seed = 1;
+  while (data->size() < size) {
+    seed = seed * 1103515245 + 12345;
+    const char *word = kWords[(seed >> 16) % kNumWords];
+    data->insert(data->end(), word, word + strlen(word));
+    data->push_back((seed >> 8) % 13 ? ' ' : '\n');
+    if ((seed >> 4) % 97 == 0) {
+      // Some numbers to reduce the number of long matches.
+      std::string number = std::to_string(seed % 100000);
+      data->insert(data->end(), number.begin(), number.end());
+    }
+  }
+  data->resize(size);
+}
+
+static double MegabytesPerSecond(uint64_t bytes, uint64_t nanoseconds) {
+  if (!nanoseconds) {
+    return 0;
+  }
+
+  return (bytes / 1e6) / (nanoseconds / 1e9);
+}
+
+static std::string FormatCount(uint64_t count) {
+  if (count == UINT64_MAX) {
+    return "n/a";
+  }
+
+  char buffer[32];
+  if (count >= 1000000) {
+    snprintf(buffer, sizeof(buffer), "%.1fM", count / 1e6);
+  } else if (count >= 1000) {
+    snprintf(buffer, sizeof(buffer), "%.1fk", count / 1e3);
+  } else {
+    snprintf(buffer, sizeof(buffer), "%llu",
+        static_cast<unsigned long long>(count));
+  }
+  return buffer;
+}
+
+static void Usage(const char *program) {
+  fprintf(stderr, "Usage: %s [-runs=N] [-size=MiB] [file...]\n", program);
+}
+
+int main(int argc, char **argv) {
+  int runs = kDefaultRuns;
+  size_t size_mib = kDefaultSizeMiB;
+  std::vector<uint8_t> input;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (!strncmp(arg, "-runs=", 6)) {
+      runs = atoi(arg + 6);
+    } else if (!strncmp(arg, "-size=", 6)) {
+      size_mib = strtoul(arg + 6, nullptr, 10);
+    } else if (arg[0] == '-') {
+      Usage(argv[0]);
+      return 1;
+    } else if (!ReadFile(arg, &input)) {
+      fprintf(stderr, "Could not read %s\n", arg);
+      return 1;
+    }
+  }
+  if (input.empty()) {
+    GenerateInput(size_mib * 1024 * 1024, &input);
+  }
+  if (input.empty() || runs <= 0) {
+    Usage(argv[0]);
+    return 1;
+  }
+
+  TlbMissCounter tlb;
+  if (!tlb.available()) {
+    fprintf(stderr, "Data TLB misses can not be counted, perf events are "
+        "not available.\n");
+  }
+
+  printf("input: %zu bytes, runs: %d\n\n", input.size(), runs);
+  printf("%5s %8s %10s %10s %10s %10s %10s %10s %8s\n", "level", "pages",
+      "enc MB/s", "enc dTLB", "enc flt", "dec MB/s", "dec dTLB", "dec flt",
+      "huge");
+  for (int level = kMinLevel; level <= kMaxLevel; level++) {
+    for (const Mode &mode : kModes) {
+      SetLargePageMode(mode.mode);
+      CLargePageStats stats_before;
+      LargePages_GetStats(&stats_before);
+
+      CLzmaEncProps props;
+      LzmaEncProps_Init(&props);
+      props.level = level;
+      props.reduceSize = input.size();
+      LzmaEncProps_Normalize(&props);
+
+      Counters encode;
+      Counters decode;
+      for (int run = 0; run < runs; run++) {
+        // Enough for incompressible data.
+        SizeT compressed_size = input.size() + input.size() / 2 + (1 << 16);
+        Byte *compressed = static_cast<Byte*>(BigAlloc(compressed_size));
+        Byte props_data[LZMA_PROPS_SIZE];
+        SizeT props_size = LZMA_PROPS_SIZE;
+        assert(compressed);
+
+        Measurement encode_measurement(&tlb);
+        SRes res = LzmaEncode(compressed, &compressed_size, input.data(),
+            input.size(), &props, props_data, &props_size, 0, nullptr,
+            &g_Alloc, &g_BigAlloc);
+        encode_measurement.Stop(&encode);
+        if (res != SZ_OK) {
+          fprintf(stderr, "Encoding failed with %d\n", res);
+          return 1;
+        }
+
+        // The output buffer is the dictionary of the decoder.
+        SizeT output_size = input.size();
+        SizeT input_size = compressed_size;
+        ELzmaStatus status;
+        Measurement decode_measurement(&tlb);
+        Byte *output = static_cast<Byte*>(BigAlloc(output_size));
+        assert(output);
+        res = LzmaDecode(output, &output_size, compressed, &input_size,
+            props_data, props_size, LZMA_FINISH_END, &status, &g_Alloc);
+        decode_measurement.Stop(&decode);
+        if (res != SZ_OK || output_size != input.size() ||
+            memcmp(output, input.data(), input.size()) != 0) {
+          fprintf(stderr, "Decoding failed with %d\n", res);
+          return 1;
+        }
+
+        BigFree(output);
+        BigFree(compressed);
+      }
+
+      CLargePageStats stats;
+      LargePages_GetStats(&stats);
+      uint64_t total_bytes = static_cast<uint64_t>(input.size()) * runs;
+      printf("%5d %8s %10.2f %10s %10s %10.2f %10s %10s %7lluM\n", level,
+          mode.name, MegabytesPerSecond(total_bytes, encode.nanoseconds),
+          FormatCount(encode.tlb_misses).c_str(),
+          FormatCount(encode.page_faults).c_str(),
+          MegabytesPerSecond(total_bytes, decode.nanoseconds),
+          FormatCount(decode.tlb_misses).c_str(),
+          FormatCount(decode.page_faults).c_str(),
+          static_cast<unsigned long long>(
+              (stats.thpBytes - stats_before.thpBytes +
+               stats.hugeTlbBytes - stats_before.hugeTlbBytes) >> 20));
+    }
+  }
+  return 0;
+}
@@ -19,13 +19,19 @@
  *
  */
 
+#include <assert.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+#include <vector>
+
+#include "Alloc.h"
 #include "Lzma2Dec.h"
 
 #include "common-alloc.h"
+#include "common-timing.h"
 
 static const size_t kBufferSize = 8192;
 
@@ -34,6 +40,13 @@ static const size_t kMaxDictionarySize = 32 * 1024 * 1024;
 // Limit maximum size to avoid running into timeouts with too large data.
 static const size_t kMaxInputSize = 100 * 1024;
 
+// Inputs are decoded again with a ring dictionary (see "RingAlloc") if
+// their dictionary and decoded data are not larger than this. Only inputs
+// that decode to more than the dictionary size wrap around in the ring, the
+// others are not decoded again.
+static const size_t kMaxRingDictionarySize = 1024 * 1024;
+static const size_t kMaxRingDecodedSize = 4 * 1024 * 1024;
+
 // Copied from sdk/C/Lzma2Dec.c
 #define LZMA2_DIC_SIZE_FROM_PROP(p) \
     (((UInt32)2 | ((p) & 1)) << ((p) / 2 + 11))
@@ -49,8 +62,86 @@ static bool GetDictionarySize(Byte prop, size_t* size) {
   return true;
 }
 
+// Returns the ring dictionary for "prop", or nullptr if it could not be
+// mapped. The rings are kept for all inputs, as creating the mappings costs
+// more than decoding most inputs.
+static Byte *GetRing(Byte prop, size_t *ring_size) {
+  static Byte *rings[41];
+  static size_t ring_sizes[41];
+  static bool failed[41];
+  if (!rings[prop] && !failed[prop]) {
+    ring_sizes[prop] = LZMA2_DIC_SIZE_FROM_PROP(prop);
+    rings[prop] = static_cast<Byte *>(RingAlloc(&ring_sizes[prop]));
+    failed[prop] = !rings[prop];
+  }
+  *ring_size = ring_sizes[prop];
+  return rings[prop];
+}
+
+// Decodes the input into a dictionary that is mapped twice and checks the
+// last decoded bytes at "dic + dicPos" after every call, which cross the end
+// of the buffer once it wrapped around.
+static void CheckRing(Byte prop, const uint8_t *data, size_t size,
+    const std::vector<Byte> &decoded, bool finished) {
+  CLzma2Dec dec;
+  Lzma2Dec_Construct(&dec);
+  size_t ring_size;
+  Byte *ring = GetRing(prop, &ring_size);
+  if (!ring) {
+    return;
+  }
+  if (Lzma2Dec_AllocateProbs(&dec, prop, &CommonAlloc) != SZ_OK) {
+    return;
+  }
+  dec.decoder.dic = ring;
+  dec.decoder.dicBufSize = ring_size;
+  dec.decoder.dicRing = True;
+
+  Lzma2Dec_Init(&dec);
+  size_t total = 0;
+  ELzmaStatus status = LZMA_STATUS_NOT_SPECIFIED;
+  while (size > 0) {
+    if (dec.decoder.dicPos == ring_size) {
+      dec.decoder.dicPos = 0;
+    }
+    SizeT dic_pos = dec.decoder.dicPos;
+    SizeT limit = dic_pos + std::min(kBufferSize, ring_size - dic_pos);
+    SizeT srcLen = size;
+    SRes res = Lzma2Dec_DecodeToDic(&dec, limit, data, &srcLen,
+        LZMA_FINISH_ANY, &status);
+    size_t cur = dec.decoder.dicPos - dic_pos;
+    total += cur;
+    if (total > decoded.size()) {
+      // The other decoder stopped at an error before.
+      assert(!finished);
+      break;
+    }
+
+    size_t check_size = std::min(total, std::min(ring_size, 2 * kBufferSize));
+    assert(!check_size || memcmp(ring + dec.decoder.dicPos - check_size,
+        decoded.data() + total - check_size, check_size) == 0);
+    if (res != SZ_OK || status == LZMA_STATUS_FINISHED_WITH_MARK ||
+        status == LZMA_STATUS_NEEDS_MORE_INPUT || (cur == 0 && srcLen == 0)) {
+      break;
+    }
+
+    size -= srcLen;
+    data += srcLen;
+  }
+  if (finished && status == LZMA_STATUS_FINISHED_WITH_MARK) {
+    assert(total == decoded.size());
+  }
+
+  Lzma2Dec_FreeProbs(&dec, &CommonAlloc);
+}
+
 extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
-  if (size < 1 || size > kMaxInputSize) {
+  if (IsInputTooLarge(size, kMaxInputSize)) {
+    return 0;
+  }
+
+  ScopedInputTimer timer(data, size);
+  if (size < 1) {
     return 0;
   }
 
@@ -70,9 +161,16 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
     return 0;
   }
 
+  const Byte prop = data[0];
   data += 1;
   size -= 1;
 
+  const uint8_t *input = data;
+  const size_t input_size = size;
+  bool check_ring = dictionarySize <= kMaxRingDictionarySize;
+  bool finished = false;
+  std::vector<Byte> decoded;
+
   Lzma2Dec_Init(&dec);
   while (size > 0) {
     Byte buf[kBufferSize];
@@ -82,8 +180,17 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
     ELzmaStatus status;
     res = Lzma2Dec_DecodeToBuf(&dec, buf, &destLen, data, &srcLen,
         LZMA_FINISH_ANY, &status);
+    timer.add_decoded_size(destLen);
+    if (check_ring) {
+      if (decoded.size() + destLen > kMaxRingDecodedSize) {
+        check_ring = false;
+      } else {
+        decoded.insert(decoded.end(), buf, buf + destLen);
+      }
+    }
     if (res != SZ_OK || status == LZMA_STATUS_FINISHED_WITH_MARK ||
         status == LZMA_STATUS_NEEDS_MORE_INPUT) {
+      finished = res == SZ_OK && status == LZMA_STATUS_FINISHED_WITH_MARK;
       goto exit;
     }
 
@@ -93,5 +200,8 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
 
 exit:
   Lzma2Dec_Free(&dec, &CommonAlloc);
+  if (check_ring && decoded.size() > dictionarySize) {
+    CheckRing(prop, input, input_size, decoded, finished);
+  }
   return 0;
 }
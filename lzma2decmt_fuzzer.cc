@@ -0,0 +1,155 @@
+/**
+ *
+ * @copyright Copyright (c) 2019 Joachim Bauch <mail@joachim-bauch.de>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "Lzma2DecMt.h"
+
+#include "common-alloc.h"
+#include "common-buffer.h"
+
+// The first bytes of the input contain the LZMA2 dictionary property and
+// select the properties of the multithreaded decoder, the remaining data is
+// the LZMA2 stream.
+static const size_t kPropsSize = 5;
+
+static const size_t kMaxDictionarySize = 32 * 1024 * 1024;
+
+// Maximum number of threads to use for decoding.
+static const unsigned kMaxThreads = 8;
+
+// Copied from sdk/C/Lzma2Dec.c
+#define LZMA2_DIC_SIZE_FROM_PROP(p) \
+    (((UInt32)2 | ((p) & 1)) << ((p) / 2 + 11))
+
+// If the environment variable "BENCHMARK_MT_ONLY" is set, the single-threaded
+// reference decoding is skipped so benchmarks only measure the multithreaded
+// decoder (see "scripts/benchmark-decmt.sh").
+static bool SkipReference() {
+  static const bool skip = getenv("BENCHMARK_MT_ONLY") != nullptr;
+  return skip;
+}
+
+static SRes Decode(Byte prop, const CLzma2DecMtProps &props,
+    const uint8_t *data, size_t size, OutputBuffer *out_buffer) {
+  InputBuffer in_buffer(data, size);
+  UInt64 inProcessed;
+  int isMt;
+
+  CLzma2DecMtHandle handle = Lzma2DecMt_Create(&CommonAlloc, &CommonAllocMid);
+  if (!handle) {
+    return SZ_ERROR_MEM;
+  }
+
+  SRes res = Lzma2DecMt_Decode(handle, prop, &props, out_buffer->stream(),
+      nullptr, 0, in_buffer.stream(), &inProcessed, &isMt, nullptr);
+  Lzma2DecMt_Destroy(handle);
+  return res;
+}
+
+// Decode using the streaming interface, reading "read_size" bytes at a time.
+static SRes DecodeStreaming(Byte prop, const CLzma2DecMtProps &props,
+    const uint8_t *data, size_t size, size_t read_size,
+    OutputBuffer *out_buffer) {
+  InputBuffer in_buffer(data, size);
+
+  CLzma2DecMtHandle handle = Lzma2DecMt_Create(&CommonAlloc, &CommonAllocMid);
+  if (!handle) {
+    return SZ_ERROR_MEM;
+  }
+
+  SRes res = Lzma2DecMt_Init(handle, prop, &props, nullptr, 0,
+      in_buffer.stream());
+  Byte *buf = static_cast<Byte*>(malloc(read_size));
+  assert(buf);
+  while (res == SZ_OK) {
+    size_t outSize = read_size;
+    UInt64 inProcessed;
+    res = Lzma2DecMt_Read(handle, buf, &outSize, &inProcessed);
+    if (!outSize) {
+      break;
+    }
+
+    ISeqOutStream_Write(out_buffer->stream(), buf, outSize);
+  }
+  free(buf);
+  Lzma2DecMt_Destroy(handle);
+  return res;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  if (size < kPropsSize) {
+    return 0;
+  }
+
+  Byte prop = data[0];
+  // Avoid using too much memory.
+  if (prop > 40 || (prop < 40 &&
+      LZMA2_DIC_SIZE_FROM_PROP(prop) > kMaxDictionarySize)) {
+    return 0;
+  }
+
+  CLzma2DecMtProps props;
+  Lzma2DecMtProps_Init(&props);
+#ifndef _7ZIP_ST
+  props.numThreads = 1 + data[1] % kMaxThreads;
+  props.inBufSize_MT = static_cast<size_t>(1) << (10 + data[2] % 9);
+  props.outBlockMax = static_cast<size_t>(1) << (12 + data[3] % 17);
+  props.inBlockMax = props.outBlockMax + props.outBlockMax / 16;
+#else
+  // Only the buffer sizes can be changed in single-threaded builds.
+  props.inBufSize_ST = static_cast<size_t>(1) << (10 + data[2] % 11);
+  props.outStep_ST = static_cast<size_t>(1) << (10 + data[3] % 11);
+#endif
+  size_t read_size = static_cast<size_t>(1) << (data[4] % 17);
+  data += kPropsSize;
+  size -= kPropsSize;
+
+  OutputBuffer out_buffer;
+  SRes res = Decode(prop, props, data, size, &out_buffer);
+  if (SkipReference()) {
+    return 0;
+  }
+
+  CLzma2DecMtProps reference_props;
+  Lzma2DecMtProps_Init(&reference_props);
+  OutputBuffer reference_buffer;
+  SRes reference_res = Decode(prop, reference_props, data, size,
+      &reference_buffer);
+
+  OutputBuffer streaming_buffer;
+  SRes streaming_res = DecodeStreaming(prop, reference_props, data, size,
+      read_size, &streaming_buffer);
+
+  if (reference_res == SZ_OK) {
+    // Valid streams must decode to the same data with any number of threads
+    // and with the streaming interface.
+    assert(res == SZ_OK);
+    assert(out_buffer.Equals(reference_buffer.data(),
+        reference_buffer.size()));
+    assert(streaming_res == SZ_OK);
+    assert(streaming_buffer.Equals(reference_buffer.data(),
+        reference_buffer.size()));
+  }
+  return 0;
+}
@@ -33,6 +33,13 @@
 // Limit maximum size to avoid running into timeouts with too large data.
 static const size_t kMaxInputSize = 100 * 1024;
 
+#ifndef _7ZIP_ST
+// Encode blocks in parallel if built with "ENABLE_MT=1". The block size is
+// small enough so inputs can be split into multiple blocks.
+static const int kNumThreads = 2;
+static const UInt64 kBlockSize = 16 * 1024;
+#endif
+
 extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
   if (size <= 10 || size > kMaxInputSize) {
     return 0;
@@ -54,11 +61,16 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
   props.lzmaProps.mc = 1 + data[8];
   props.lzmaProps.writeEndMark = data[9] ? 1 : 0;
   props.lzmaProps.dictSize = 1 << 24;
+#ifndef _7ZIP_ST
+  props.blockSize = kBlockSize;
+  props.numBlockThreads_Max = kNumThreads;
+  props.numTotalThreads = kNumThreads;
+#endif
   data += 10;
   size -= 10;
   Lzma2EncProps_Normalize(&props);
 
-  CLzma2EncHandle enc = Lzma2Enc_Create(&CommonAlloc, &CommonAlloc);
+  CLzma2EncHandle enc = Lzma2Enc_Create(&CommonAlloc, &CommonAllocBig);
   if (!enc) {
     return 0;
   }
@@ -66,9 +78,10 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
   OutputBuffer out_buffer;
   InputBuffer in_buffer(data, size);
   Byte *dest = nullptr;
+  CLzma2Dec dec;
   SizeT srcLen;
-  SizeT destLen;
-  ELzmaStatus status;
+  SizeT totalSrcLen = 0;
+  ELzmaStatus status = LZMA_STATUS_NOT_SPECIFIED;
 
   SRes res = Lzma2Enc_SetProps(enc, &props);
   if (res != SZ_OK) {
@@ -83,19 +96,31 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
   assert(res == SZ_OK);
   assert(out_buffer.size() > 0);
 
-  // Decompress and compare with input data.
+  // Decompress and compare with input data. The segments of the output
+  // buffer are passed to the decoder directly to avoid flattening them.
   dest = static_cast<Byte*>(malloc(size));
   assert(dest);
-  destLen = size;
-  srcLen = out_buffer.size();
 
-  res = Lzma2Decode(dest, &destLen, out_buffer.data(), &srcLen, props_data,
-      LZMA_FINISH_END, &status, &CommonAlloc);
+  Lzma2Dec_Construct(&dec);
+  res = Lzma2Dec_AllocateProbs(&dec, props_data, &CommonAlloc);
   assert(res == SZ_OK);
+  dec.decoder.dic = dest;
+  dec.decoder.dicBufSize = size;
+  Lzma2Dec_Init(&dec);
+  for (size_t i = 0; i < out_buffer.segment_count(); i++) {
+    OutputBuffer::Segment segment = out_buffer.segment(i);
+    srcLen = segment.size;
+    res = Lzma2Dec_DecodeToDic(&dec, size, segment.data, &srcLen,
+        LZMA_FINISH_END, &status);
+    assert(res == SZ_OK);
+    totalSrcLen += srcLen;
+  }
   assert(status == LZMA_STATUS_FINISHED_WITH_MARK ||
       status == LZMA_STATUS_MAYBE_FINISHED_WITHOUT_MARK);
-  assert(srcLen == out_buffer.size());
+  assert(totalSrcLen == out_buffer.size());
+  assert(dec.decoder.dicPos == size);
   assert(memcmp(dest, data, size) == 0);
+  Lzma2Dec_FreeProbs(&dec, &CommonAlloc);
 
 exit:
   Lzma2Enc_Destroy(enc);
@@ -19,13 +19,19 @@
  *
  */
 
+#include <assert.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <vector>
+
+#include "Alloc.h"
 #include "LzmaDec.h"
+#include "LzmaDecPool.h"
 
 #include "common-alloc.h"
+#include "common-timing.h"
 
 static const size_t kBufferSize = 8192;
 
@@ -34,8 +40,69 @@ static const size_t kMaxDictionarySize = 32 * 1024 * 1024;
 // Limit maximum size to avoid running into timeouts with too large data.
 static const size_t kMaxInputSize = 100 * 1024;
 
+// Inputs that decode to at most this size are also decoded as a batch with
+// LzmaDecPool_Decode and compared.
+static const size_t kMaxPoolDecodedSize = 64 * 1024;
+// Number of jobs in the batch, a full and a half copy of the stream.
+static const size_t kPoolJobs = 2;
+// Inputs that decode to at most this size use a batch that is large enough
+// for all threads with ENABLE_MT=1, if the probs arrays are small (lc + lp
+// as in LZMA2), as every job initializes them.
+static const size_t kMaxPoolThreadsDecodedSize = 1024;
+static const unsigned kMaxPoolThreadsLcLp = 4;
+static const size_t kPoolThreadsJobs = 32;
+static const unsigned kPoolThreads = 2;
+
+// The pool (and its threads) is shared by all inputs, so its decoders keep
+// their probs arrays between the batches. It doesn't use "CommonAlloc", as
+// its memory lives longer than one input.
+static CLzmaDecPoolHandle GetPool() {
+  static CLzmaDecPoolHandle pool = LzmaDecPool_Create(&g_Alloc, kPoolThreads);
+  assert(pool);
+  return pool;
+}
+
+// Decode copies of the stream with the full and with half of the output
+// size in one batch, they must match the data decoded by the stream API.
+static void CheckPool(const CLzmaProps &lzma_props, const uint8_t *props,
+    const uint8_t *data, size_t size, const std::vector<uint8_t> &decoded) {
+  const size_t num_jobs = (decoded.size() <= kMaxPoolThreadsDecodedSize &&
+      lzma_props.lc + lzma_props.lp <= kMaxPoolThreadsLcLp) ?
+      kPoolThreadsJobs : kPoolJobs;
+  std::vector<uint8_t> dest(num_jobs * decoded.size());
+  std::vector<CLzmaDecJob> jobs(num_jobs);
+  for (size_t i = 0; i < num_jobs; i++) {
+    CLzmaDecJob &job = jobs[i];
+    job.props = props;
+    job.src = data;
+    job.srcLen = size;
+    job.dest = dest.data() + i * decoded.size();
+    job.destLen = (i % 2) ? decoded.size() / 2 : decoded.size();
+  }
+
+  CLzmaDecPoolStats stats;
+  SRes res = LzmaDecPool_Decode(GetPool(), jobs.data(), num_jobs,
+      LZMA_FINISH_ANY, &stats);
+  assert(res == SZ_OK);
+  uint64_t out_size = 0;
+  for (const CLzmaDecJob &job : jobs) {
+    assert(job.res == SZ_OK || (job.res == SZ_ERROR_INPUT_EOF &&
+        job.destLen == decoded.size()));
+    assert(job.destProcessed == job.destLen);
+    assert(memcmp(job.dest, decoded.data(), job.destProcessed) == 0);
+    out_size += job.destProcessed;
+  }
+  assert(stats.outSize == out_size);
+  assert(stats.numAllocs <= stats.numThreads);
+}
+
 extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
-  if (size < LZMA_PROPS_SIZE || size > kMaxInputSize) {
+  if (IsInputTooLarge(size, kMaxInputSize)) {
+    return 0;
+  }
+
+  ScopedInputTimer timer(data, size);
+  if (size < LZMA_PROPS_SIZE) {
     return 0;
   }
 
@@ -55,8 +122,13 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
     return 0;
   }
 
+  const uint8_t *props_data = data;
   data += LZMA_PROPS_SIZE;
   size -= LZMA_PROPS_SIZE;
+  const uint8_t *stream_data = data;
+  size_t stream_size = size;
+  std::vector<uint8_t> decoded;
+  bool check_pool = true;
 
   LzmaDec_Init(&dec);
   while (size > 0) {
@@ -67,6 +139,12 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
     ELzmaStatus status;
     res = LzmaDec_DecodeToBuf(&dec, buf, &destLen, data, &srcLen,
         LZMA_FINISH_ANY, &status);
+    timer.add_decoded_size(destLen);
+    if (res != SZ_OK || decoded.size() + destLen > kMaxPoolDecodedSize) {
+      check_pool = false;
+    } else {
+      decoded.insert(decoded.end(), buf, buf + destLen);
+    }
     if (res != SZ_OK || status == LZMA_STATUS_FINISHED_WITH_MARK ||
         status == LZMA_STATUS_NEEDS_MORE_INPUT) {
       goto exit;
@@ -78,5 +156,8 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
 
 exit:
   LzmaDec_Free(&dec, &CommonAlloc);
+  if (check_pool && !decoded.empty()) {
+    CheckPool(props, props_data, stream_data, stream_size, decoded);
+  }
   return 0;
 }
@@ -0,0 +1,136 @@
+/**
+ *
+ * @copyright Copyright (c) 2019 Joachim Bauch <mail@joachim-bauch.de>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+// Decodes the input (same format as for the "lzmadec" fuzzer) with the
+// optimized decoding loop of "LzmaDecOpt.c" and with the generic loop of
+// "LzmaDec.c", the results of every call must be identical.
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include "LzmaDec.h"
+
+#include "common-alloc.h"
+#include "common-timing.h"
+
+static const size_t kMaxDictionarySize = 32 * 1024 * 1024;
+
+// Limit maximum size to avoid running into timeouts with too large data.
+static const size_t kMaxInputSize = 100 * 1024;
+
+// The output sizes of the calls cycle through these, so the decoding loops
+// also stop at odd limits and in the middle of matches.
+static const size_t kOutputSizes[] = {
+  8192, 1, 3, 300, 17, 65536,
+};
+
+struct DecodeCall {
+  SRes res;
+  ELzmaStatus status;
+  SizeT srcLen;
+  SizeT destLen;
+};
+
+static void Decode(const uint8_t *data, size_t size, bool use_opt,
+    std::vector<DecodeCall> *calls, std::vector<uint8_t> *decoded) {
+  CLzmaDec dec;
+  LzmaDec_Construct(&dec);
+  if (LzmaDec_Allocate(&dec, data, LZMA_PROPS_SIZE, &CommonAlloc) != SZ_OK) {
+    return;
+  }
+
+#ifdef _LZMA_DEC_OPT
+  LzmaDec_SetDecodeOpt(use_opt ? True : False);
+#else
+  (void) use_opt;
+#endif
+  data += LZMA_PROPS_SIZE;
+  size -= LZMA_PROPS_SIZE;
+
+  LzmaDec_Init(&dec);
+  for (size_t i = 0; size > 0; i++) {
+    size_t out_size = kOutputSizes[i % (sizeof(kOutputSizes) /
+        sizeof(kOutputSizes[0]))];
+    size_t pos = decoded->size();
+    decoded->resize(pos + out_size);
+    DecodeCall call;
+    call.srcLen = size;
+    call.destLen = out_size;
+    call.res = LzmaDec_DecodeToBuf(&dec, decoded->data() + pos,
+        &call.destLen, data, &call.srcLen, LZMA_FINISH_ANY, &call.status);
+    decoded->resize(pos + call.destLen);
+    calls->push_back(call);
+    if (call.res != SZ_OK || call.status == LZMA_STATUS_FINISHED_WITH_MARK ||
+        call.status == LZMA_STATUS_NEEDS_MORE_INPUT) {
+      break;
+    }
+
+    size -= call.srcLen;
+    data += call.srcLen;
+  }
+  LzmaDec_Free(&dec, &CommonAlloc);
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  if (IsInputTooLarge(size, kMaxInputSize)) {
+    return 0;
+  }
+
+  ScopedInputTimer timer(data, size);
+  if (size < LZMA_PROPS_SIZE) {
+    return 0;
+  }
+
+  CLzmaProps props;
+  if (LzmaProps_Decode(&props, data, LZMA_PROPS_SIZE) != SZ_OK) {
+    return 0;
+  }
+
+  // Avoid using too much memory.
+  if (props.dicSize > kMaxDictionarySize) {
+    return 0;
+  }
+
+  std::vector<DecodeCall> opt_calls;
+  std::vector<uint8_t> opt_decoded;
+  Decode(data, size, true, &opt_calls, &opt_decoded);
+  timer.add_decoded_size(opt_decoded.size());
+
+  std::vector<DecodeCall> generic_calls;
+  std::vector<uint8_t> generic_decoded;
+  Decode(data, size, false, &generic_calls, &generic_decoded);
+
+  assert(opt_calls.size() == generic_calls.size());
+  for (size_t i = 0; i < opt_calls.size(); i++) {
+    const DecodeCall &opt = opt_calls[i];
+    const DecodeCall &generic = generic_calls[i];
+    assert(opt.res == generic.res);
+    assert(opt.status == generic.status);
+    assert(opt.srcLen == generic.srcLen);
+    assert(opt.destLen == generic.destLen);
+  }
+  assert(opt_decoded == generic_decoded);
+  return 0;
+}
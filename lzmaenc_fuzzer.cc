@@ -24,6 +24,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <vector>
+
 #include "LzmaEnc.h"
 #include "LzmaDec.h"
 
@@ -33,6 +35,54 @@
 // Limit maximum size to avoid running into timeouts with too large data.
 static const size_t kMaxInputSize = 100 * 1024;
 
+#ifndef _7ZIP_ST
+// Use a separate match finder thread if built with "ENABLE_MT=1".
+static const int kNumThreads = 2;
+#endif
+
+// Decompresses the encoded data and compares it with the input data. The
+// segments of the output buffer are passed to the decoder directly to avoid
+// flattening them. If "dict" is set, the data was encoded after it as preset
+// dictionary with the initial probabilities "probs".
+static void CheckEncoded(const OutputBuffer &out_buffer, const Byte *props_data,
+    SizeT props_size, const uint8_t *data, size_t size,
+    const uint8_t *dict = nullptr, size_t dict_size = 0,
+    const UInt16 *probs = nullptr) {
+  Byte *dest = static_cast<Byte*>(malloc(dict_size + size));
+  assert(dest);
+
+  CLzmaDec dec;
+  SizeT srcLen;
+  SizeT totalSrcLen = 0;
+  ELzmaStatus status = LZMA_STATUS_NOT_SPECIFIED;
+  LzmaDec_Construct(&dec);
+  SRes res = LzmaDec_AllocateProbs(&dec, props_data, props_size, &CommonAlloc);
+  assert(res == SZ_OK);
+  dec.dic = dest;
+  dec.dicBufSize = dict_size + size;
+  if (dict) {
+    res = LzmaDec_InitPreset(&dec, dict, dict_size, probs);
+    assert(res == SZ_OK);
+  } else {
+    LzmaDec_Init(&dec);
+  }
+  for (size_t i = 0; i < out_buffer.segment_count(); i++) {
+    OutputBuffer::Segment segment = out_buffer.segment(i);
+    srcLen = segment.size;
+    res = LzmaDec_DecodeToDic(&dec, dict_size + size, segment.data, &srcLen,
+        LZMA_FINISH_END, &status);
+    assert(res == SZ_OK);
+    totalSrcLen += srcLen;
+  }
+  assert(status == LZMA_STATUS_FINISHED_WITH_MARK ||
+      status == LZMA_STATUS_MAYBE_FINISHED_WITHOUT_MARK);
+  assert(totalSrcLen == out_buffer.size());
+  assert(dec.dicPos == dict_size + size);
+  assert(memcmp(dest + dict_size, data, size) == 0);
+  LzmaDec_FreeProbs(&dec, &CommonAlloc);
+  free(dest);
+}
+
 extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
   if (size <= 10 || size > kMaxInputSize) {
     return 0;
@@ -54,6 +104,9 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
   props.mc = 1 + data[8];
   props.writeEndMark = data[9] ? 1 : 0;
   props.dictSize = 1 << 24;
+#ifndef _7ZIP_ST
+  props.numThreads = kNumThreads;
+#endif
   data += 10;
   size -= 10;
   LzmaEncProps_Normalize(&props);
@@ -63,13 +116,6 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
     return 0;
   }
 
-  OutputBuffer out_buffer;
-  InputBuffer in_buffer(data, size);
-  Byte *dest = nullptr;
-  SizeT srcLen;
-  SizeT destLen;
-  ELzmaStatus status;
-
   SRes res = LzmaEnc_SetProps(enc, &props);
   if (res != SZ_OK) {
     goto exit;
@@ -81,27 +127,65 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
   }
   assert(props_size == LZMA_PROPS_SIZE);
 
-  res = LzmaEnc_Encode(enc, out_buffer.stream(), in_buffer.stream(), nullptr,
-      &CommonAlloc, &CommonAlloc);
-  assert(res == SZ_OK);
-  assert(out_buffer.size() > 0);
+  {
+    OutputBuffer out_buffer;
+    InputBuffer in_buffer(data, size);
+    res = LzmaEnc_Encode(enc, out_buffer.stream(), in_buffer.stream(), nullptr,
+        &CommonAlloc, &CommonAllocBig);
+    assert(res == SZ_OK);
+    assert(out_buffer.size() > 0);
+    CheckEncoded(out_buffer, props_data, props_size, data, size);
+  }
 
-  // Decompress and compare with input data.
-  dest = static_cast<Byte*>(malloc(size));
-  assert(dest);
-  destLen = size;
-  srcLen = out_buffer.size();
+  {
+    // Encode the same data again with the match finder of the first run.
+    // Its old entries would be valid matches if they were not ignored.
+    OutputBuffer out_buffer;
+    InputBuffer in_buffer(data, size);
+    LzmaEnc_Reset(enc);
+    res = LzmaEnc_Encode(enc, out_buffer.stream(), in_buffer.stream(), nullptr,
+        &CommonAlloc, &CommonAllocBig);
+    assert(res == SZ_OK);
+    CheckEncoded(out_buffer, props_data, props_size, data, size);
+  }
 
-  res = LzmaDecode(dest, &destLen, out_buffer.data(), &srcLen, props_data,
-      props_size, LZMA_FINISH_END, &status, &CommonAlloc);
-  assert(res == SZ_OK);
-  assert(status == LZMA_STATUS_FINISHED_WITH_MARK ||
-      status == LZMA_STATUS_MAYBE_FINISHED_WITHOUT_MARK);
-  assert(srcLen == out_buffer.size());
-  assert(memcmp(dest, data, size) == 0);
+  {
+    // Encode the second half of the data with the first half as preset
+    // dictionary and the final probabilities of the last run. The first run
+    // primes the match finder, the second one must undo the changes of the
+    // first run to the primed tables.
+    size_t dict_size = size / 2;
+    std::vector<UInt16> probs(LzmaEnc_GetNumProbs(enc));
+    LzmaEnc_GetProbs(enc, probs.data());
+    res = LzmaEnc_SetPresetDict(enc, data, dict_size);
+    assert(res == SZ_OK);
+    res = LzmaEnc_SetPresetProbs(enc, probs.data());
+    assert(res == SZ_OK);
+
+    OutputBuffer mem_buffer;
+    SizeT encoded_size = size + size / 2 + 64;
+    Byte *encoded = static_cast<Byte*>(malloc(encoded_size));
+    assert(encoded);
+    res = LzmaEnc_MemEncode(enc, encoded, &encoded_size, data + dict_size,
+        size - dict_size, props.writeEndMark, nullptr, &CommonAlloc,
+        &CommonAllocBig);
+    assert(res == SZ_OK);
+    ISeqOutStream_Write(mem_buffer.stream(), encoded, encoded_size);
+    free(encoded);
+    CheckEncoded(mem_buffer, props_data, props_size, data + dict_size,
+        size - dict_size, data, dict_size, probs.data());
+
+    OutputBuffer out_buffer;
+    InputBuffer in_buffer(data + dict_size, size - dict_size);
+    LzmaEnc_Reset(enc);
+    res = LzmaEnc_Encode(enc, out_buffer.stream(), in_buffer.stream(), nullptr,
+        &CommonAlloc, &CommonAllocBig);
+    assert(res == SZ_OK);
+    CheckEncoded(out_buffer, props_data, props_size, data + dict_size,
+        size - dict_size, data, dict_size, probs.data());
+  }
 
 exit:
-  LzmaEnc_Destroy(enc, &CommonAlloc, &CommonAlloc);
-  free(dest);
+  LzmaEnc_Destroy(enc, &CommonAlloc, &CommonAllocBig);
   return 0;
 }
@@ -0,0 +1,278 @@
+/**
+ *
+ * @copyright Copyright (c) 2019 Joachim Bauch <mail@joachim-bauch.de>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+// Builds a checkpoint index (see LzmaIndex.h) for the input (same format as
+// for the "lzmadec" fuzzer) and checks that reading ranges of the decoded
+// data through the index returns the same bytes as decoding from the start.
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "7zCrc.h"
+#include "CpuArch.h"
+#include "LzmaDec.h"
+#include "LzmaIndex.h"
+
+#include "common-alloc.h"
+#include "common-buffer.h"
+#include "common-timing.h"
+
+static const size_t kBufferSize = 8192;
+
+static const size_t kMaxDictionarySize = 32 * 1024 * 1024;
+
+// Limit maximum size to avoid running into timeouts with too large data.
+static const size_t kMaxInputSize = 100 * 1024;
+// Every checkpoint stores up to a dictionary of data, so only inputs that
+// decode to at most this size get an index.
+static const size_t kMaxDecodedSize = 1024 * 1024;
+static const size_t kMaxCheckpoints = 16;
+static const size_t kNumReads = 8;
+
+// Layout of the index file, see sdk/C/LzmaIndex.c.
+static const size_t kCheckpointHeaderSize = 4 * 12 + LZMA_REQUIRED_INPUT_MAX;
+static const size_t kCheckpointProcessedPosOffset = 8;
+static const size_t kCheckpointWinSizeOffset = 44;
+static const size_t kIndexEntrySize = 32;
+static const size_t kIndexFooterSize = 32;
+// Maximum number of checkpoint header fields that are changed together.
+static const size_t kMaxCheckpointChanges = 4;
+
+// How the index file was changed before it is read.
+enum IndexChange {
+  kUnchanged,
+  // The change must be detected (all parts are covered by CRCs) or give the
+  // same data.
+  kChanged,
+  // The CRCs were updated, so reads can also return other data.
+  kChangedWithCrc,
+};
+
+// Decode the stream from the start, returns false if it's not valid.
+static bool Decode(const uint8_t *data, size_t size,
+    std::vector<uint8_t> *decoded, bool *has_end_mark) {
+  CLzmaDec dec;
+  LzmaDec_Construct(&dec);
+  if (LzmaDec_Allocate(&dec, data, LZMA_PROPS_SIZE, &CommonAlloc) != SZ_OK) {
+    return false;
+  }
+
+  data += LZMA_PROPS_SIZE;
+  size -= LZMA_PROPS_SIZE;
+  bool result = false;
+  LzmaDec_Init(&dec);
+  for (;;) {
+    Byte buf[kBufferSize];
+    SizeT srcLen = size;
+    SizeT destLen = kBufferSize;
+    ELzmaStatus status;
+    SRes res = LzmaDec_DecodeToBuf(&dec, buf, &destLen, data, &srcLen,
+        LZMA_FINISH_ANY, &status);
+    decoded->insert(decoded->end(), buf, buf + destLen);
+    size -= srcLen;
+    data += srcLen;
+    if (res != SZ_OK || decoded->size() > kMaxDecodedSize) {
+      break;
+    } else if (status == LZMA_STATUS_FINISHED_WITH_MARK) {
+      *has_end_mark = true;
+      result = true;
+      break;
+    } else if (srcLen == 0 && destLen == 0) {
+      // Streams without end mark must use all input.
+      result = size == 0 && status == LZMA_STATUS_MAYBE_FINISHED_WITHOUT_MARK;
+      break;
+    }
+  }
+  LzmaDec_Free(&dec, &CommonAlloc);
+  return result;
+}
+
+// Read ranges of the data through the index file, they must match the
+// decoded data. The reads can only fail if the index file was changed.
+static void CheckReads(const std::vector<uint8_t> &file,
+    const uint8_t *index_data, size_t index_size,
+    const std::vector<uint8_t> &decoded, size_t seed, IndexChange change) {
+  const bool modified = change != kUnchanged;
+  InputLookBuffer index_stream(index_data, index_size);
+  CLzmaIndex index;
+  LzmaIndex_Construct(&index);
+  SRes res = LzmaIndex_ReadIndex(&index, index_stream.stream(),
+      &CommonAlloc);
+  assert(res == SZ_OK || modified);
+  if (res != SZ_OK) {
+    return;
+  }
+  assert(index.outSize == decoded.size());
+
+  InputLookBuffer file_stream(file.data(), file.size());
+  CLzmaDec dec;
+  LzmaDec_Construct(&dec);
+  std::vector<uint8_t> dest;
+  for (size_t i = 0; i < kNumReads; i++) {
+    size_t offset = decoded.size() * i / kNumReads + seed % (i + 1);
+    size_t size = (seed >> i) % (decoded.size() / 2 + 1) + i;
+    dest.resize(size);
+    res = LzmaIndex_Read(&index, index_stream.stream(), file_stream.stream(),
+        &dec, offset, dest.data(), &size, &CommonAlloc);
+    assert(res == SZ_OK || modified);
+    if (res != SZ_OK) {
+      continue;
+    }
+
+    assert(size <= dest.size());
+    if (change == kChangedWithCrc) {
+      continue;
+    }
+
+    size_t expected = offset < decoded.size() ?
+        std::min(dest.size(), decoded.size() - offset) : 0;
+    assert(size == expected);
+    assert(!size || !memcmp(dest.data(), decoded.data() + offset, size));
+  }
+  LzmaDec_Free(&dec, &CommonAlloc);
+  LzmaIndex_Free(&index, &CommonAlloc);
+}
+
+// Changes fields in the header of a checkpoint to values close to the limits
+// of the checks in LzmaIndex_ReadCheckpoint and updates the CRC of the
+// checkpoint and of the table, so only these checks can reject it.
+static bool ModifyCheckpoint(std::vector<uint8_t> *index_data,
+    uint32_t dic_size, size_t seed) {
+  uint8_t *data = index_data->data();
+  uint8_t *footer = data + index_data->size() - kIndexFooterSize;
+  size_t num_entries = GetUi64(footer + 16);
+  if (num_entries == 0) {
+    return false;
+  }
+
+  uint8_t *table = footer - num_entries * kIndexEntrySize;
+  size_t entry_index = seed % num_entries;
+  uint8_t *entry = table + entry_index * kIndexEntrySize;
+  size_t offset = GetUi64(entry + 16);
+  size_t end = (entry_index + 1 < num_entries) ?
+      GetUi64(entry + kIndexEntrySize + 16) : table - data;
+  uint8_t *checkpoint = data + offset;
+  uint32_t processed_pos = GetUi32(checkpoint + kCheckpointProcessedPosOffset);
+  uint32_t win_size = GetUi32(checkpoint + kCheckpointWinSizeOffset);
+  size_t probs_size = end - offset - kCheckpointHeaderSize - win_size;
+
+  const uint32_t values[] = {
+    0, dic_size, processed_pos, win_size, static_cast<uint32_t>(seed),
+  };
+  const size_t num_values = sizeof(values) / sizeof(values[0]);
+  uint64_t random = seed;
+  size_t num_changes = 1 + (seed >> 8) % kMaxCheckpointChanges;
+  for (size_t i = 0; i < num_changes; i++) {
+    random = random * 6364136223846793005ULL + 1442695040888963407ULL;
+    uint32_t r = static_cast<uint32_t>(random >> 32);
+    size_t field = r % 12;
+    uint32_t value = values[(r >> 8) % num_values] + (r >> 16) % 3 - 1;
+    SetUi32(checkpoint + field * 4, value);
+  }
+
+  // The reader gets the size of the window from the changed header.
+  size_t crc_size = kCheckpointHeaderSize + probs_size +
+      GetUi32(checkpoint + kCheckpointWinSizeOffset);
+  crc_size = std::min(crc_size, index_data->size() - offset);
+  SetUi32(entry + 24, CrcCalc(checkpoint, crc_size));
+  SetUi32(footer + 24, CrcCalc(table, num_entries * kIndexEntrySize + 24));
+  return true;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  if (IsInputTooLarge(size, kMaxInputSize)) {
+    return 0;
+  }
+
+  ScopedInputTimer timer(data, size);
+  if (size < LZMA_PROPS_SIZE) {
+    return 0;
+  }
+
+  CLzmaProps props;
+  if (LzmaProps_Decode(&props, data, LZMA_PROPS_SIZE) != SZ_OK) {
+    return 0;
+  }
+
+  // Avoid using too much memory.
+  if (props.dicSize > kMaxDictionarySize) {
+    return 0;
+  }
+
+  std::vector<uint8_t> decoded;
+  bool has_end_mark = false;
+  bool valid = Decode(data, size, &decoded, &has_end_mark);
+  timer.add_decoded_size(decoded.size());
+  if (!valid) {
+    return 0;
+  }
+
+  CrcGenerateTable();
+
+  // Build a .lzma file with the unpack size if the stream has no end mark.
+  std::vector<uint8_t> file(data, data + LZMA_PROPS_SIZE);
+  file.resize(LZMA_PROPS_SIZE + 8);
+  SetUi64(file.data() + LZMA_PROPS_SIZE,
+      has_end_mark ? (UInt64)(Int64)-1 : decoded.size());
+  file.insert(file.end(), data + LZMA_PROPS_SIZE, data + size);
+
+  size_t num_checkpoints = 1 + size % kMaxCheckpoints;
+  UInt64 step = decoded.size() / num_checkpoints + 1;
+  CLzmaIndex index;
+  LzmaIndex_Construct(&index);
+  InputBuffer file_input(file.data(), file.size());
+  OutputBuffer output;
+  OutputBuffer index_output;
+  SRes res = LzmaIndex_Build(&index, file_input.stream(), output.stream(),
+      index_output.stream(), step, &CommonAlloc);
+  assert(res == SZ_OK);
+  assert(output.Equals(decoded.data(), decoded.size()));
+  assert(index.outSize == decoded.size());
+  // A checkpoint at the end of the data is only written before an end mark.
+  assert(index.numEntries == (has_end_mark ? decoded.size() / step :
+      (decoded.size() ? (decoded.size() - 1) / step : 0)));
+  LzmaIndex_Free(&index, &CommonAlloc);
+
+  size_t seed = size;
+  for (size_t i = 0; i < size; i++) {
+    seed = seed * 31 + data[i];
+  }
+  std::vector<uint8_t> index_data(index_output.data(),
+      index_output.data() + index_output.size());
+  CheckReads(file, index_data.data(), index_data.size(), decoded, seed,
+      kUnchanged);
+
+  std::vector<uint8_t> changed_data(index_data);
+  if (ModifyCheckpoint(&changed_data, props.dicSize, seed)) {
+    CheckReads(file, changed_data.data(), changed_data.size(), decoded, seed,
+        kChangedWithCrc);
+  }
+
+  index_data[seed % index_data.size()] ^= 1 << (seed % 8);
+  CheckReads(file, index_data.data(), index_data.size(), decoded, seed,
+      kChanged);
+  return 0;
+}
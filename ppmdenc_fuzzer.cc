@@ -49,7 +49,7 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
   OutputByteBuffer out_buffer;
   CPpmd7z_RangeEnc enc;
   Ppmd7z_RangeEnc_Init(&enc);
-  enc.Stream = out_buffer.stream();
+  Ppmd7z_RangeEnc_SetBuf(&enc, out_buffer.buf_stream());
   for (size_t i = 0; i < size; ++i) {
     Ppmd7_EncodeSymbol(&p_enc, &enc, data[i]);
   }
@@ -65,7 +65,7 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
     Ppmd7_Init(&p_dec, order);
     CPpmd7z_RangeDec dec;
     Ppmd7z_RangeDec_CreateVTable(&dec);
-    dec.Stream = in_buffer.stream();
+    Ppmd7z_RangeDec_SetBuf(&dec, in_buffer.buf_stream());
     assert(Ppmd7z_RangeDec_Init(&dec));
 
     for (size_t i = 0; i < size; ++i) {
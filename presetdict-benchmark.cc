@@ -0,0 +1,270 @@
+/**
+ *
+ * @copyright Copyright (c) 2019 Joachim Bauch <mail@joachim-bauch.de>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+// Compares encoding and decoding small records without a dictionary, with a
+// preset dictionary and with a preset dictionary and trained probabilities.
+// The records are consecutive slices of the input files, the dictionary is
+// trained on the even records and the odd records are encoded.
+//
+// Usage: presetdict-benchmark [-level=N] [-dict=KiB] [-total=MiB] <file>...
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "Alloc.h"
+#include "LzmaDec.h"
+#include "LzmaEnc.h"
+#include "common-dict.h"
+
+static const int kDefaultLevel = 5;
+static const size_t kDefaultDictKiB = 64;
+// Amount of data encoded for every record size.
+static const size_t kDefaultTotalMiB = 4;
+static const size_t kRecordSizes[] = {
+  256, 1024, 4 * 1024, 16 * 1024, 64 * 1024,
+};
+
+typedef std::chrono::steady_clock Clock;
+
+struct Record {
+  const Byte *data;
+  size_t size;
+  std::vector<Byte> encoded;
+};
+
+struct Preset {
+  const char *name;
+  const std::vector<uint8_t> *dict;
+  const std::vector<UInt16> *probs;
+};
+
+static bool ReadFile(const char *filename, std::vector<uint8_t> *data) {
+  FILE *f = fopen(filename, "rb");
+  if (!f) {
+    return false;
+  }
+
+  uint8_t buffer[64 * 1024];
+  size_t len;
+  while ((len = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+    data->insert(data->end(), buffer, buffer + len);
+  }
+  bool result = !ferror(f);
+  fclose(f);
+  return result;
+}
+
+// Encodes every record with the same encoder, returns the time in
+// nanoseconds or 0 if an error occurred.
+static uint64_t EncodeRecords(const CLzmaEncProps &props, const Preset &preset,
+    std::vector<Record> *records, Byte *props_encoded) {
+  Clock::time_point start = Clock::now();
+  CLzmaEncHandle enc = LzmaEnc_Create(&g_Alloc);
+  if (!enc) {
+    return 0;
+  }
+
+  SizeT props_size = LZMA_PROPS_SIZE;
+  bool ok = LzmaEnc_SetProps(enc, &props) == SZ_OK &&
+      LzmaEnc_WriteProperties(enc, props_encoded, &props_size) == SZ_OK;
+  if (ok && preset.dict) {
+    ok = LzmaEnc_SetPresetDict(enc, preset.dict->data(),
+        preset.dict->size()) == SZ_OK;
+  }
+  if (ok && preset.probs) {
+    ok = LzmaEnc_SetPresetProbs(enc, preset.probs->data()) == SZ_OK;
+  }
+  for (size_t i = 0; ok && i < records->size(); i++) {
+    Record &record = (*records)[i];
+    record.encoded.resize(record.size + record.size / 2 + 64);
+    SizeT encoded_size = record.encoded.size();
+    LzmaEnc_Reset(enc);
+    ok = LzmaEnc_MemEncode(enc, record.encoded.data(), &encoded_size,
+        record.data, record.size, 0, nullptr, &g_Alloc, &g_BigAlloc) == SZ_OK;
+    record.encoded.resize(encoded_size);
+  }
+  LzmaEnc_Destroy(enc, &g_Alloc, &g_BigAlloc);
+  if (!ok) {
+    return 0;
+  }
+
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      Clock::now() - start).count();
+}
+
+// Decodes and verifies every record with the same decoder. The dictionary is
+// copied into the buffer only for the first record. Returns the time in
+// nanoseconds or 0 if an error occurred.
+static uint64_t DecodeRecords(const Byte *props_encoded, const Preset &preset,
+    const std::vector<Record> &records) {
+  size_t dict_size = preset.dict ? preset.dict->size() : 0;
+  size_t max_size = 0;
+  for (const Record &record : records) {
+    max_size = std::max(max_size, record.size);
+  }
+  std::vector<Byte> dic(dict_size + max_size);
+
+  CLzmaDec dec;
+  LzmaDec_Construct(&dec);
+  if (LzmaDec_AllocateProbs(&dec, props_encoded, LZMA_PROPS_SIZE,
+      &g_Alloc) != SZ_OK) {
+    return 0;
+  }
+  dec.dic = dic.data();
+  dec.dicBufSize = dic.size();
+
+  uint64_t total_ns = 0;
+  bool ok = true;
+  const Byte *dict = dict_size ? preset.dict->data() : nullptr;
+  for (size_t i = 0; ok && i < records.size(); i++) {
+    const Record &record = records[i];
+    Clock::time_point start = Clock::now();
+    if (dict_size) {
+      ok = LzmaDec_InitPreset(&dec, dict, dict_size,
+          preset.probs ? preset.probs->data() : nullptr) == SZ_OK;
+      dict = nullptr;
+    } else {
+      LzmaDec_Init(&dec);
+    }
+    SizeT src_size = record.encoded.size();
+    ELzmaStatus status;
+    ok = ok && LzmaDec_DecodeToDic(&dec, dict_size + record.size,
+        record.encoded.data(), &src_size, LZMA_FINISH_END,
+        &status) == SZ_OK;
+    total_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now() - start).count();
+    ok = ok && dec.dicPos == dict_size + record.size &&
+        memcmp(dic.data() + dict_size, record.data, record.size) == 0;
+  }
+  LzmaDec_FreeProbs(&dec, &g_Alloc);
+  return ok ? std::max<uint64_t>(total_ns, 1) : 0;
+}
+
+static void Usage(const char *program) {
+  fprintf(stderr, "Usage: %s [-level=N] [-dict=KiB] [-total=MiB] <file>...\n",
+      program);
+}
+
+int main(int argc, char **argv) {
+  int level = kDefaultLevel;
+  size_t dict_kib = kDefaultDictKiB;
+  size_t total_mib = kDefaultTotalMiB;
+  std::vector<uint8_t> input;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (!strncmp(arg, "-level=", 7)) {
+      level = atoi(arg + 7);
+    } else if (!strncmp(arg, "-dict=", 6)) {
+      dict_kib = strtoul(arg + 6, nullptr, 10);
+    } else if (!strncmp(arg, "-total=", 7)) {
+      total_mib = strtoul(arg + 7, nullptr, 10);
+    } else if (arg[0] == '-') {
+      Usage(argv[0]);
+      return 1;
+    } else if (!ReadFile(arg, &input)) {
+      fprintf(stderr, "Could not read %s\n", arg);
+      return 1;
+    }
+  }
+  size_t max_record_size = kRecordSizes[
+      sizeof(kRecordSizes) / sizeof(kRecordSizes[0]) - 1];
+  if (input.size() < 2 * max_record_size || !total_mib || !dict_kib) {
+    fprintf(stderr, "Need at least %zu bytes of input.\n",
+        2 * max_record_size);
+    Usage(argv[0]);
+    return 1;
+  }
+
+  printf("input: %zu bytes, level: %d, dictionary: %zu KiB\n\n",
+      input.size(), level, dict_kib);
+  printf("%8s %8s %-11s %12s %8s %12s %12s\n", "size", "records", "mode",
+      "bytes", "ratio", "enc rec/s", "dec rec/s");
+  for (size_t record_size : kRecordSizes) {
+    std::vector<DictSample> samples;
+    std::vector<Record> records;
+    // The input is not repeated, the odd records must not occur in the
+    // training data.
+    size_t count = std::min(total_mib * 1024 * 1024,
+        input.size() / 2) / record_size;
+    size_t offset = 0;
+    for (size_t i = 0; i < 2 * count; i++) {
+      if (i % 2) {
+        records.push_back({input.data() + offset, record_size, {}});
+      } else {
+        samples.push_back({input.data() + offset, record_size});
+      }
+      offset += record_size;
+    }
+
+    CLzmaEncProps props;
+    LzmaEncProps_Init(&props);
+    props.level = level;
+    props.reduceSize = record_size;
+    LzmaEncProps_Normalize(&props);
+
+    std::vector<uint8_t> dict;
+    std::vector<UInt16> probs;
+    TrainDictionary(samples, dict_kib * 1024, &dict);
+    CLzmaEncProps dict_props = props;
+    dict_props.reduceSize = dict.size() + record_size;
+    dict_props.dictSize = 0;
+    LzmaEncProps_Normalize(&dict_props);
+    if (dict.empty() || !TrainProbs(dict_props, dict, samples, &probs)) {
+      fprintf(stderr, "Training failed for records of %zu bytes\n",
+          record_size);
+      return 1;
+    }
+
+    const Preset presets[] = {
+      {"plain", nullptr, nullptr},
+      {"dict", &dict, nullptr},
+      {"dict+probs", &dict, &probs},
+    };
+    for (const Preset &preset : presets) {
+      Byte props_encoded[LZMA_PROPS_SIZE];
+      uint64_t encode_ns = EncodeRecords(preset.dict ? dict_props : props,
+          preset, &records, props_encoded);
+      uint64_t decode_ns = encode_ns ?
+          DecodeRecords(props_encoded, preset, records) : 0;
+      if (!encode_ns || !decode_ns) {
+        fprintf(stderr, "Mode %s failed for records of %zu bytes\n",
+            preset.name, record_size);
+        return 1;
+      }
+
+      size_t encoded_size = 0;
+      for (const Record &record : records) {
+        encoded_size += record.encoded.size();
+      }
+      printf("%8zu %8zu %-11s %12zu %8.3f %12.0f %12.0f\n", record_size,
+          records.size(), preset.name, encoded_size,
+          static_cast<double>(encoded_size) / (records.size() * record_size),
+          records.size() / (encode_ns / 1e9),
+          records.size() / (decode_ns / 1e9));
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,226 @@
+/**
+ *
+ * @copyright Copyright (c) 2019 Joachim Bauch <mail@joachim-bauch.de>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+// Compares encoding many small records with a new encoder for every record
+// (LzmaEnc_Create / LzmaEnc_Destroy) against reusing one encoder with
+// LzmaEnc_Reset. The records are consecutive slices of the input files.
+//
+// Usage: records-benchmark [-level=N] [-total=MiB] <file>...
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "Alloc.h"
+#include "LzmaDec.h"
+#include "LzmaEnc.h"
+
+static const int kDefaultLevel = 5;
+// Amount of data encoded for every record size.
+static const size_t kDefaultTotalMiB = 4;
+static const size_t kRecordSizes[] = {
+  256, 1024, 4 * 1024, 16 * 1024, 64 * 1024,
+};
+
+typedef std::chrono::steady_clock Clock;
+
+struct Record {
+  const Byte *data;
+  size_t size;
+  std::vector<Byte> encoded;
+  Byte props[LZMA_PROPS_SIZE];
+};
+
+static bool ReadFile(const char *filename, std::vector<uint8_t> *data) {
+  FILE *f = fopen(filename, "rb");
+  if (!f) {
+    return false;
+  }
+
+  uint8_t buffer[64 * 1024];
+  size_t len;
+  while ((len = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+    data->insert(data->end(), buffer, buffer + len);
+  }
+  bool result = !ferror(f);
+  fclose(f);
+  return result;
+}
+
+static bool EncodeRecord(CLzmaEncHandle enc, Record *record) {
+  SizeT props_size = LZMA_PROPS_SIZE;
+  if (LzmaEnc_WriteProperties(enc, record->props, &props_size) != SZ_OK) {
+    return false;
+  }
+
+  record->encoded.resize(record->size + record->size / 2 + 64);
+  SizeT encoded_size = record->encoded.size();
+  if (LzmaEnc_MemEncode(enc, record->encoded.data(), &encoded_size,
+      record->data, record->size, 0, nullptr, &g_Alloc,
+      &g_BigAlloc) != SZ_OK) {
+    return false;
+  }
+  record->encoded.resize(encoded_size);
+  return true;
+}
+
+// Encodes every record with a new encoder, returns the time in nanoseconds
+// or 0 if an error occurred.
+static uint64_t EncodeCreate(const CLzmaEncProps &props,
+    std::vector<Record> *records) {
+  Clock::time_point start = Clock::now();
+  for (Record &record : *records) {
+    CLzmaEncHandle enc = LzmaEnc_Create(&g_Alloc);
+    if (!enc) {
+      return 0;
+    }
+
+    bool ok = LzmaEnc_SetProps(enc, &props) == SZ_OK &&
+        EncodeRecord(enc, &record);
+    LzmaEnc_Destroy(enc, &g_Alloc, &g_BigAlloc);
+    if (!ok) {
+      return 0;
+    }
+  }
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      Clock::now() - start).count();
+}
+
+// Encodes every record with the same encoder, returns the time in
+// nanoseconds or 0 if an error occurred.
+static uint64_t EncodeReset(const CLzmaEncProps &props,
+    std::vector<Record> *records) {
+  Clock::time_point start = Clock::now();
+  CLzmaEncHandle enc = LzmaEnc_Create(&g_Alloc);
+  if (!enc) {
+    return 0;
+  }
+
+  bool ok = LzmaEnc_SetProps(enc, &props) == SZ_OK;
+  for (size_t i = 0; ok && i < records->size(); i++) {
+    LzmaEnc_Reset(enc);
+    ok = EncodeRecord(enc, &(*records)[i]);
+  }
+  LzmaEnc_Destroy(enc, &g_Alloc, &g_BigAlloc);
+  if (!ok) {
+    return 0;
+  }
+
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      Clock::now() - start).count();
+}
+
+static bool VerifyRecords(const std::vector<Record> &records,
+    size_t *encoded_size) {
+  std::vector<Byte> decoded;
+  *encoded_size = 0;
+  for (const Record &record : records) {
+    decoded.resize(record.size);
+    SizeT decoded_size = decoded.size();
+    SizeT src_size = record.encoded.size();
+    ELzmaStatus status;
+    if (LzmaDecode(decoded.data(), &decoded_size, record.encoded.data(),
+        &src_size, record.props, LZMA_PROPS_SIZE, LZMA_FINISH_END, &status,
+        &g_Alloc) != SZ_OK || decoded_size != record.size ||
+        memcmp(decoded.data(), record.data, record.size) != 0) {
+      return false;
+    }
+    *encoded_size += record.encoded.size();
+  }
+  return true;
+}
+
+static void Usage(const char *program) {
+  fprintf(stderr, "Usage: %s [-level=N] [-total=MiB] <file>...\n", program);
+}
+
+int main(int argc, char **argv) {
+  int level = kDefaultLevel;
+  size_t total_mib = kDefaultTotalMiB;
+  std::vector<uint8_t> input;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (!strncmp(arg, "-level=", 7)) {
+      level = atoi(arg + 7);
+    } else if (!strncmp(arg, "-total=", 7)) {
+      total_mib = strtoul(arg + 7, nullptr, 10);
+    } else if (arg[0] == '-') {
+      Usage(argv[0]);
+      return 1;
+    } else if (!ReadFile(arg, &input)) {
+      fprintf(stderr, "Could not read %s\n", arg);
+      return 1;
+    }
+  }
+  size_t max_record_size = kRecordSizes[
+      sizeof(kRecordSizes) / sizeof(kRecordSizes[0]) - 1];
+  if (input.size() < max_record_size || !total_mib) {
+    fprintf(stderr, "Need at least %zu bytes of input.\n", max_record_size);
+    Usage(argv[0]);
+    return 1;
+  }
+
+  printf("input: %zu bytes, level: %d\n\n", input.size(), level);
+  printf("%8s %8s %12s %12s %8s %12s %12s\n", "size", "records",
+      "create rec/s", "reset rec/s", "speedup", "create bytes",
+      "reset bytes");
+  for (size_t record_size : kRecordSizes) {
+    std::vector<Record> records(total_mib * 1024 * 1024 / record_size);
+    size_t offset = 0;
+    for (Record &record : records) {
+      if (offset + record_size > input.size()) {
+        offset = 0;
+      }
+      record.data = input.data() + offset;
+      record.size = record_size;
+      offset += record_size;
+    }
+
+    CLzmaEncProps props;
+    LzmaEncProps_Init(&props);
+    props.level = level;
+    props.reduceSize = record_size;
+
+    size_t create_bytes;
+    size_t reset_bytes;
+    uint64_t create_ns = EncodeCreate(props, &records);
+    if (!create_ns || !VerifyRecords(records, &create_bytes)) {
+      fprintf(stderr, "Encoding with new encoders failed\n");
+      return 1;
+    }
+    uint64_t reset_ns = EncodeReset(props, &records);
+    if (!reset_ns || !VerifyRecords(records, &reset_bytes)) {
+      fprintf(stderr, "Encoding with LzmaEnc_Reset failed\n");
+      return 1;
+    }
+
+    printf("%8zu %8zu %12.0f %12.0f %7.2fx %12zu %12zu\n", record_size,
+        records.size(), records.size() / (create_ns / 1e9),
+        records.size() / (reset_ns / 1e9),
+        static_cast<double>(create_ns) / reset_ns, create_bytes,
+        reset_bytes);
+  }
+  return 0;
+}
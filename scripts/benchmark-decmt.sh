@@ -0,0 +1,84 @@
+#!/bin/bash -eu
+
+##
+## @copyright Copyright (c) 2019 Joachim Bauch <mail@joachim-bauch.de>
+##
+## @license GNU GPL version 3 or any later version
+##
+## This program is free software: you can redistribute it and/or modify
+## it under the terms of the GNU General Public License as published by
+## the Free Software Foundation, either version 3 of the License, or
+## (at your option) any later version.
+##
+## This program is distributed in the hope that it will be useful,
+## but WITHOUT ANY WARRANTY; without even the implied warranty of
+## MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+## GNU General Public License for more details.
+##
+## You should have received a copy of the GNU General Public License
+## along with this program.  If not, see <https://www.gnu.org/licenses/>.
+##
+
+# Report the speedup of the multithreaded decoders (xzdecmt and lzma2decmt)
+# for different numbers of threads compared to a single thread. The corpus
+# files are replayed with the number of threads patched into their
+# properties.
+#
+# Usage: scripts/benchmark-decmt.sh [name...]
+#
+# The environment variable "RUNS" controls how often each corpus file is
+# processed (default: 20), "THREADS" contains the numbers of threads to
+# compare (default: "1 2 4 8").
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+RUNS=${RUNS:-20}
+THREADS=${THREADS:-1 2 4 8}
+NAMES=${*:-xzdecmt lzma2decmt}
+BUILD_DIR=$(mktemp -d)
+trap 'rm -rf "${BUILD_DIR}"' EXIT
+
+# The binaries are built in a copy of the sources, so the build in the source
+# tree is kept.
+SRC_DIR="${BUILD_DIR}/src"
+mkdir "${SRC_DIR}"
+cp -R "${ROOT}/Makefile" "${ROOT}"/*.cc "${ROOT}"/*.h "${ROOT}/sdk" "${SRC_DIR}"
+
+# Offset of the byte containing the number of threads in the inputs.
+function threads_offset {
+	case "$1" in
+		lzma2decmt) echo 1 ;;
+		*) echo 0 ;;
+	esac
+}
+
+make -C "${SRC_DIR}" clean > /dev/null
+for name in ${NAMES}; do
+	make -C "${SRC_DIR}" -j"$(nproc)" ENABLE_MT=1 "${name}_benchmark" > /dev/null
+	cp "${SRC_DIR}/${name}_benchmark" "${BUILD_DIR}/${name}"
+done
+
+for name in ${NAMES}; do
+	offset=$(threads_offset "${name}")
+	echo "${name}:"
+	printf "%8s %14s %10s %8s\n" "threads" "iter/s" "MB/s" "speedup"
+	base=
+	for threads in ${THREADS}; do
+		corpus="${BUILD_DIR}/${name}-${threads}"
+		mkdir "${corpus}"
+		for filename in "${ROOT}/corpus/${name}_fuzzer"/*; do
+			# The fuzzers use "1 + value % 8" threads.
+			{
+				head -c "${offset}" "${filename}"
+				printf "\\x$(printf %02x $((threads - 1)))"
+				tail -c +$((offset + 2)) "${filename}"
+			} > "${corpus}/$(basename "${filename}")"
+		done
+		result=$(BENCHMARK_MT_ONLY=1 "${BUILD_DIR}/${name}" -runs="${RUNS}" \
+			-per_input=0 "${corpus}")
+		iterations=$(echo "${result}" | awk '/^iterations\/s:/ { print $2 }')
+		mbs=$(echo "${result}" | awk '/^MB\/s:/ { print $2 }')
+		base=${base:-${iterations}}
+		printf "%8s %14s %10s %8s\n" "${threads}" "${iterations}" "${mbs}" \
+			"$(awk "BEGIN { printf \"%.2fx\", ${iterations} / ${base} }")"
+	done
+done
@@ -0,0 +1,75 @@
+#!/bin/bash -eu
+
+##
+## @copyright Copyright (c) 2019 Joachim Bauch <mail@joachim-bauch.de>
+##
+## @license GNU GPL version 3 or any later version
+##
+## This program is free software: you can redistribute it and/or modify
+## it under the terms of the GNU General Public License as published by
+## the Free Software Foundation, either version 3 of the License, or
+## (at your option) any later version.
+##
+## This program is distributed in the hope that it will be useful,
+## but WITHOUT ANY WARRANTY; without even the implied warranty of
+## MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+## GNU General Public License for more details.
+##
+## You should have received a copy of the GNU General Public License
+## along with this program.  If not, see <https://www.gnu.org/licenses/>.
+##
+
+# Compare the throughput of the benchmark binaries (see benchmark-main.cc)
+# built with "ENABLE_MT=1" against the default single-threaded build by
+# replaying the corpus files.
+#
+# Usage: scripts/benchmark-mt.sh [name...]
+#
+# The environment variable "RUNS" controls how often each corpus file is
+# processed (default: 100).
+
+ROOT=$(cd "$(dirname "$0")/.." && pwd)
+RUNS=${RUNS:-100}
+NAMES=${*:-lzmaenc lzma2enc xzenc}
+BUILD_DIR=$(mktemp -d)
+trap 'rm -rf "${BUILD_DIR}"' EXIT
+
+# The binaries are built in a copy of the sources, so the build in the source
+# tree is kept.
+SRC_DIR="${BUILD_DIR}/src"
+mkdir "${SRC_DIR}"
+cp -R "${ROOT}/Makefile" "${ROOT}"/*.cc "${ROOT}"/*.h "${ROOT}/sdk" "${SRC_DIR}"
+
+function build {
+	local suffix=$1
+	shift
+	make -C "${SRC_DIR}" clean > /dev/null
+	for name in ${NAMES}; do
+		make -C "${SRC_DIR}" -j"$(nproc)" "$@" "${name}_benchmark" > /dev/null
+		cp "${SRC_DIR}/${name}_benchmark" "${BUILD_DIR}/${name}-${suffix}"
+	done
+}
+
+function run {
+	local binary=$1
+	local corpus=$2
+	"${binary}" -runs="${RUNS}" -per_input=0 "${corpus}" | \
+		awk '/^iterations\/s:/ { print $2 }'
+}
+
+build st
+build mt ENABLE_MT=1
+
+printf "%-12s %14s %14s %8s\n" "name" "st (iter/s)" "mt (iter/s)" "speedup"
+for name in ${NAMES}; do
+	corpus="${ROOT}/corpus/${name}_fuzzer"
+	if [ ! -d "${corpus}" ]; then
+		# The encoders take their properties from the first bytes of the input,
+		# the headers of the .lzma files are valid values for all of them.
+		corpus="${ROOT}/corpus/lzmadec_fuzzer"
+	fi
+	st=$(run "${BUILD_DIR}/${name}-st" "${corpus}")
+	mt=$(run "${BUILD_DIR}/${name}-mt" "${corpus}")
+	printf "%-12s %14s %14s %8s\n" "${name}" "${st}" "${mt}" \
+		"$(awk "BEGIN { printf \"%.2fx\", ${mt} / ${st} }")"
+done
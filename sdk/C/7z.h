@@ -183,6 +183,62 @@ SRes SzArEx_Extract(
     ISzAllocPtr allocTemp);
 
 
+/*
+  Folder cache for SzArEx_ExtractCached
+
+  Keeps decoded solid blocks (folders) up to a total of (maxSize) bytes.
+  If a new folder doesn't fit, the least recently used folders are freed
+  after it was decoded successfully, so a failed decode keeps the cache,
+  but the new folder is allocated in addition to the cached ones.
+  A folder that is larger than (maxSize) is kept as the only entry.
+  The buffers are allocated with allocMain of SzArEx_ExtractCached, so
+  SzFolderCache_Free must be called with the same allocator.
+*/
+
+typedef struct
+{
+  UInt32 folderIndex;
+  Byte *buf;
+  size_t size;
+  UInt64 lastUse;
+} CSzFolderCacheItem;
+
+typedef struct
+{
+  CSzFolderCacheItem *items;
+  unsigned numItems;
+  unsigned numItemsAllocated;
+  size_t totalSize;
+  size_t maxSize;
+  UInt64 useCounter;
+
+  /* statistics */
+  UInt64 numHits;
+  UInt64 numMisses;
+} CSzFolderCache;
+
+void SzFolderCache_Init(CSzFolderCache *p, size_t maxSize);
+void SzFolderCache_Free(CSzFolderCache *p, ISzAllocPtr alloc);
+
+/*
+  SzArEx_ExtractCached works like SzArEx_Extract, but uses (cache) instead
+  of the single blockIndex / outBuffer slot, so accessing files from
+  several solid blocks alternately doesn't decode the blocks again.
+  *outBuffer points into the cache and is valid until the next call.
+*/
+
+SRes SzArEx_ExtractCached(
+    const CSzArEx *db,
+    ILookInStream *inStream,
+    UInt32 fileIndex,         /* index of file */
+    CSzFolderCache *cache,
+    const Byte **outBuffer,   /* pointer to the decoded solid block */
+    size_t *offset,           /* offset of stream for required file in *outBuffer */
+    size_t *outSizeProcessed, /* size of file in *outBuffer */
+    ISzAllocPtr allocMain,
+    ISzAllocPtr allocTemp);
+
+
 /*
 SzArEx_Open Errors:
 SZ_ERROR_NO_ARCHIVE
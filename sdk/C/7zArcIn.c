@@ -1632,6 +1632,27 @@ SRes SzArEx_Open(CSzArEx *p, ILookInStream *inStream,
 }
 
 
+static SRes SzArEx_GetFileInFolder(
+    const CSzArEx *p,
+    UInt32 fileIndex,
+    UInt32 folderIndex,
+    const Byte *buf,
+    size_t bufSize,
+    size_t *offset,
+    size_t *outSizeProcessed)
+{
+  UInt64 unpackPos = p->UnpackPositions[fileIndex];
+  *offset = (size_t)(unpackPos - p->UnpackPositions[p->FolderToFile[folderIndex]]);
+  *outSizeProcessed = (size_t)(p->UnpackPositions[(size_t)fileIndex + 1] - unpackPos);
+  if (*offset + *outSizeProcessed > bufSize)
+    return SZ_ERROR_FAIL;
+  if (SzBitWithVals_Check(&p->CRCs, fileIndex))
+    if (CrcCalc(buf + *offset, *outSizeProcessed) != p->CRCs.Vals[fileIndex])
+      return SZ_ERROR_CRC;
+  return SZ_OK;
+}
+
+
 SRes SzArEx_Extract(
     const CSzArEx *p,
     ILookInStream *inStream,
@@ -1694,18 +1715,141 @@ SRes SzArEx_Extract(
   }
 
   if (res == SZ_OK)
+    res = SzArEx_GetFileInFolder(p, fileIndex, folderIndex,
+        *tempBuf, *outBufferSize, offset, outSizeProcessed);
+
+  return res;
+}
+
+
+/* ---------- Folder Cache ---------- */
+
+void SzFolderCache_Init(CSzFolderCache *p, size_t maxSize)
+{
+  p->items = NULL;
+  p->numItems = 0;
+  p->numItemsAllocated = 0;
+  p->totalSize = 0;
+  p->maxSize = maxSize;
+  p->useCounter = 0;
+  p->numHits = 0;
+  p->numMisses = 0;
+}
+
+void SzFolderCache_Free(CSzFolderCache *p, ISzAllocPtr alloc)
+{
+  unsigned i;
+  for (i = 0; i < p->numItems; i++)
+    ISzAlloc_Free(alloc, p->items[i].buf);
+  ISzAlloc_Free(alloc, p->items);
+  SzFolderCache_Init(p, p->maxSize);
+}
+
+static void SzFolderCache_Remove(CSzFolderCache *p, unsigned index, ISzAllocPtr alloc)
+{
+  p->totalSize -= p->items[index].size;
+  ISzAlloc_Free(alloc, p->items[index].buf);
+  p->items[index] = p->items[--p->numItems];
+}
+
+/* evicts the least recently used folders until (needSize) more bytes fit into the budget */
+static void SzFolderCache_Evict(CSzFolderCache *p, size_t needSize, ISzAllocPtr alloc)
+{
+  while (p->numItems != 0 && p->totalSize + needSize > p->maxSize)
   {
-    UInt64 unpackPos = p->UnpackPositions[fileIndex];
-    *offset = (size_t)(unpackPos - p->UnpackPositions[p->FolderToFile[folderIndex]]);
-    *outSizeProcessed = (size_t)(p->UnpackPositions[(size_t)fileIndex + 1] - unpackPos);
-    if (*offset + *outSizeProcessed > *outBufferSize)
-      return SZ_ERROR_FAIL;
-    if (SzBitWithVals_Check(&p->CRCs, fileIndex))
-      if (CrcCalc(*tempBuf + *offset, *outSizeProcessed) != p->CRCs.Vals[fileIndex])
-        res = SZ_ERROR_CRC;
+    unsigned i, lru = 0;
+    for (i = 1; i < p->numItems; i++)
+      if (p->items[i].lastUse < p->items[lru].lastUse)
+        lru = i;
+    SzFolderCache_Remove(p, lru, alloc);
   }
+}
 
-  return res;
+SRes SzArEx_ExtractCached(
+    const CSzArEx *p,
+    ILookInStream *inStream,
+    UInt32 fileIndex,
+    CSzFolderCache *cache,
+    const Byte **outBuffer,
+    size_t *offset,
+    size_t *outSizeProcessed,
+    ISzAllocPtr allocMain,
+    ISzAllocPtr allocTemp)
+{
+  UInt32 folderIndex = p->FileToFolder[fileIndex];
+  CSzFolderCacheItem *item = NULL;
+  unsigned i;
+  
+  *outBuffer = NULL;
+  *offset = 0;
+  *outSizeProcessed = 0;
+  
+  if (folderIndex == (UInt32)-1)
+    return SZ_OK;
+
+  for (i = 0; i < cache->numItems; i++)
+    if (cache->items[i].folderIndex == folderIndex)
+    {
+      item = &cache->items[i];
+      break;
+    }
+
+  if (item)
+    cache->numHits++;
+  else
+  {
+    UInt64 unpackSizeSpec = SzAr_GetFolderUnpackSize(&p->db, folderIndex);
+    size_t unpackSize = (size_t)unpackSizeSpec;
+    Byte *buf = NULL;
+    SRes res;
+
+    if (unpackSize != unpackSizeSpec)
+      return SZ_ERROR_MEM;
+    cache->numMisses++;
+
+    if (cache->numItems == cache->numItemsAllocated)
+    {
+      unsigned num = cache->numItemsAllocated ? cache->numItemsAllocated * 2 : 4;
+      CSzFolderCacheItem *items = (CSzFolderCacheItem *)ISzAlloc_Alloc(allocMain, num * sizeof(CSzFolderCacheItem));
+      if (!items)
+        return SZ_ERROR_MEM;
+      if (cache->numItems != 0)
+        memcpy(items, cache->items, cache->numItems * sizeof(CSzFolderCacheItem));
+      ISzAlloc_Free(allocMain, cache->items);
+      cache->items = items;
+      cache->numItemsAllocated = num;
+    }
+
+    if (unpackSize != 0)
+    {
+      buf = (Byte *)ISzAlloc_Alloc(allocMain, unpackSize);
+      if (!buf)
+        return SZ_ERROR_MEM;
+    }
+
+    res = SzAr_DecodeFolder(&p->db, folderIndex,
+        inStream, p->dataPos, buf, unpackSize, allocTemp);
+    if (res != SZ_OK)
+    {
+      /* don't cache folders that could not be decoded, the cached folders are kept */
+      ISzAlloc_Free(allocMain, buf);
+      return res;
+    }
+
+    /* a folder that is larger than the budget is still cached alone */
+    SzFolderCache_Evict(cache, unpackSize, allocMain);
+
+    item = &cache->items[cache->numItems++];
+    item->folderIndex = folderIndex;
+    item->buf = buf;
+    item->size = unpackSize;
+    cache->totalSize += unpackSize;
+  }
+
+  item->lastUse = ++cache->useCounter;
+  *outBuffer = item->buf;
+  return SzArEx_GetFileInFolder(p, fileIndex, folderIndex,
+      item->buf, item->size, offset, outSizeProcessed);
 }
 
 
@@ -6,10 +6,15 @@
 #include "7zCrc.h"
 #include "CpuArch.h"
 
+#if !defined(_7ZIP_ST) && !defined(_WIN32)
+  #define CRC_GENERATE_ONCE
+  #include <pthread.h>
+#endif
+
 #define kCrcPoly 0xEDB88320
 
 #ifdef MY_CPU_LE
-  #define CRC_NUM_TABLES 8
+  #define CRC_NUM_TABLES 16
 #else
   #define CRC_NUM_TABLES 9
 
@@ -24,7 +29,21 @@
   UInt32 MY_FAST_CALL CrcUpdateT8(UInt32 v, const void *data, size_t size, const UInt32 *table);
 #endif
 
-typedef UInt32 (MY_FAST_CALL *CRC_FUNC)(UInt32 v, const void *data, size_t size, const UInt32 *table);
+#ifdef MY_CPU_LE
+  UInt32 MY_FAST_CALL CrcUpdateT16(UInt32 v, const void *data, size_t size, const UInt32 *table);
+#endif
+
+#if defined(MY_CPU_X86_OR_AMD64) && ( \
+    (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) || \
+    defined(__clang__) || (defined(_MSC_VER) && _MSC_VER >= 1800))
+  #define CRC_CLMUL
+  #include <wmmintrin.h>
+  #if defined(__GNUC__) || defined(__clang__)
+    #define CRC_TARGET_CLMUL __attribute__((target("sse2,pclmul")))
+  #else
+    #define CRC_TARGET_CLMUL
+  #endif
+#endif
 
 CRC_FUNC g_CrcUpdateT4;
 CRC_FUNC g_CrcUpdateT8;
@@ -53,7 +72,114 @@ UInt32 MY_FAST_CALL CrcUpdateT1(UInt32 v, const void *data, size_t size, const U
   return v;
 }
 
-void MY_FAST_CALL CrcGenerateTable()
+#ifdef CRC_CLMUL
+
+/*
+CrcUpdateClmul() folds the data 64 bytes at a time with carry-less
+multiplications like XzCrc64UpdateClmul() in XzCrc64.c. The constants are
+(x^k mod P) shifted to the upper half of 64 bits, that is the 64-bit
+reflected order of the 32-bit remainder:
+  g_CrcFold[0, 1] : (x^575, x^511) to fold by 64 bytes
+  g_CrcFold[2, 3] : (x^447, x^383) to fold by 48 bytes
+  g_CrcFold[4, 5] : (x^319, x^255) to fold by 32 bytes
+  g_CrcFold[6, 7] : (x^191, x^127) to fold by 16 bytes
+
+Buffers smaller than the four lanes (CRC_CLMUL_SIZE_MIN) and the last bytes
+are processed with slicing-by-16.
+*/
+
+#define CRC_CLMUL_SIZE_MIN 64
+
+static BoolInt g_CrcClmul;
+static UInt64 g_CrcFold[8];
+
+/* returns (x^n mod P) for (n >= 31) */
+
+static UInt32 Crc_GetPow(unsigned n)
+{
+  UInt32 r = 1; /* x^31 */
+  for (; n != 31; n--)
+    r = (r >> 1) ^ (kCrcPoly & ((UInt32)0 - (r & 1)));
+  return r;
+}
+
+static void Crc_InitFold()
+{
+  unsigned i;
+  for (i = 0; i < 4; i++)
+  {
+    unsigned dist = (4 - i) * 128;
+    g_CrcFold[i * 2] = (UInt64)Crc_GetPow(dist + 64 - 1) << 32;
+    g_CrcFold[i * 2 + 1] = (UInt64)Crc_GetPow(dist - 1) << 32;
+  }
+}
+
+#define CRC_LOAD(p) _mm_loadu_si128((const __m128i *)(const void *)(p))
+
+#define CRC_FOLD(x, k) _mm_xor_si128( \
+    _mm_clmulepi64_si128(x, k, 0x00), \
+    _mm_clmulepi64_si128(x, k, 0x11))
+
+CRC_TARGET_CLMUL
+static UInt32 MY_FAST_CALL CrcUpdateClmul(UInt32 v, const void *data, size_t size, const UInt32 *table)
+{
+  const Byte *p = (const Byte *)data;
+  __m128i x0, x1, x2, x3, k;
+  Byte buf[16];
+
+  if (size < CRC_CLMUL_SIZE_MIN)
+    return CrcUpdateT16(v, data, size, table);
+
+  /* (v) is the remainder of the data before, that is XORed to the first 4 bytes */
+  x0 = _mm_xor_si128(CRC_LOAD(p), _mm_cvtsi32_si128((int)v));
+  x1 = CRC_LOAD(p + 16);
+  x2 = CRC_LOAD(p + 32);
+  x3 = CRC_LOAD(p + 48);
+  p += 64;
+  size -= 64;
+
+  k = CRC_LOAD(g_CrcFold);
+  for (; size >= 64; size -= 64, p += 64)
+  {
+    x0 = _mm_xor_si128(CRC_FOLD(x0, k), CRC_LOAD(p));
+    x1 = _mm_xor_si128(CRC_FOLD(x1, k), CRC_LOAD(p + 16));
+    x2 = _mm_xor_si128(CRC_FOLD(x2, k), CRC_LOAD(p + 32));
+    x3 = _mm_xor_si128(CRC_FOLD(x3, k), CRC_LOAD(p + 48));
+  }
+
+  x3 = _mm_xor_si128(x3, CRC_FOLD(x0, CRC_LOAD(g_CrcFold + 2)));
+  x3 = _mm_xor_si128(x3, CRC_FOLD(x1, CRC_LOAD(g_CrcFold + 4)));
+  k = CRC_LOAD(g_CrcFold + 6);
+  x3 = _mm_xor_si128(x3, CRC_FOLD(x2, k));
+  for (; size >= 16; size -= 16, p += 16)
+    x3 = _mm_xor_si128(CRC_FOLD(x3, k), CRC_LOAD(p));
+
+  /* the remainder of the folded 16 bytes is the CRC of the data up to (p) */
+  _mm_storeu_si128((__m128i *)(void *)buf, x3);
+  v = CrcUpdateT16(0, buf, 16, table);
+  return CrcUpdateT16(v, p, size, table);
+}
+
+#endif
+
+CRC_FUNC CrcGetFunc(unsigned id)
+{
+  switch (id)
+  {
+    case CRC_FUNC_T1: return CrcUpdateT1;
+    case CRC_FUNC_T4: return g_CrcUpdateT4;
+    case CRC_FUNC_T8: return g_CrcUpdateT8;
+    #ifdef MY_CPU_LE
+    case CRC_FUNC_T16: return CrcUpdateT16;
+    #endif
+    #ifdef CRC_CLMUL
+    case CRC_FUNC_CLMUL: return g_CrcClmul ? CrcUpdateClmul : NULL;
+    #endif
+  }
+  return NULL;
+}
+
+static void Crc_GenerateTable(void)
 {
   UInt32 i;
   for (i = 0; i < 256; i++)
@@ -83,11 +209,21 @@ void MY_FAST_CALL CrcGenerateTable()
 
     #if CRC_NUM_TABLES >= 8
       g_CrcUpdateT8 = CrcUpdateT8;
-  
+    #endif
+    #if CRC_NUM_TABLES >= 16
       #ifdef MY_CPU_X86_OR_AMD64
       if (!CPU_Is_InOrder())
       #endif
-        g_CrcUpdate = CrcUpdateT8;
+        g_CrcUpdate = CrcUpdateT16;
+    #endif
+
+    #ifdef CRC_CLMUL
+    if (CPU_IsSupported_PCLMUL())
+    {
+      Crc_InitFold();
+      g_CrcClmul = True;
+      g_CrcUpdate = CrcUpdateClmul;
+    }
     #endif
 
   #else
@@ -126,3 +262,28 @@ void MY_FAST_CALL CrcGenerateTable()
 
   #endif
 }
+
+/*
+  Only the first call builds the (CRC_NUM_TABLES * 256) tables and checks
+  the CPU. With threads, pthread_once() also makes the other callers wait
+  until the tables are complete.
+*/
+
+#ifdef CRC_GENERATE_ONCE
+
+static pthread_once_t g_Crc_Once = PTHREAD_ONCE_INIT;
+
+void MY_FAST_CALL CrcGenerateTable()
+{
+  pthread_once(&g_Crc_Once, Crc_GenerateTable);
+}
+
+#else
+
+void MY_FAST_CALL CrcGenerateTable()
+{
+  if (!g_CrcUpdate)
+    Crc_GenerateTable();
+}
+
+#endif
@@ -20,6 +20,25 @@ void MY_FAST_CALL CrcGenerateTable(void);
 UInt32 MY_FAST_CALL CrcUpdate(UInt32 crc, const void *data, size_t size);
 UInt32 MY_FAST_CALL CrcCalc(const void *data, size_t size);
 
+typedef UInt32 (MY_FAST_CALL *CRC_FUNC)(UInt32 v, const void *data, size_t size, const UInt32 *table);
+
+#define CRC_FUNC_T1     0  /* one table */
+#define CRC_FUNC_T4     1  /* slicing-by-4 */
+#define CRC_FUNC_T8     2  /* slicing-by-8 */
+#define CRC_FUNC_T16    3  /* slicing-by-16, little-endian only */
+#define CRC_FUNC_CLMUL  4  /* folding with PCLMULQDQ, slicing-by-16 for small buffers */
+#define CRC_FUNC_NUM    5
+
+/*
+CrcGenerateTable() selects the implementation used by CrcUpdate() from the
+CPU: CLMUL if supported, else T16 on out-of-order CPUs, else T4.
+CrcGetFunc() returns one of the implementations to be called with
+g_CrcTable, or NULL if it is not supported by the build or the CPU.
+Call it after CrcGenerateTable().
+*/
+
+CRC_FUNC CrcGetFunc(unsigned id);
+
 EXTERN_C_END
 
 #endif
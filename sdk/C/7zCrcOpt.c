@@ -54,6 +54,55 @@ UInt32 MY_FAST_CALL CrcUpdateT8(UInt32 v, const void *data, size_t size, const U
   return v;
 }
 
+/* 16 tables are generated only for MY_CPU_LE */
+
+#ifdef MY_CPU_LE
+
+UInt32 MY_FAST_CALL CrcUpdateT16(UInt32 v, const void *data, size_t size, const UInt32 *table)
+{
+  const Byte *p = (const Byte *)data;
+  for (; size > 0 && ((unsigned)(ptrdiff_t)p & 3) != 0; size--, p++)
+    v = CRC_UPDATE_BYTE_2(v, *p);
+  for (; size >= 16; size -= 16, p += 16)
+  {
+    UInt32 d1 = *((const UInt32 *)p + 1);
+    UInt32 d2 = *((const UInt32 *)p + 2);
+    UInt32 d3 = *((const UInt32 *)p + 3);
+    v ^= *(const UInt32 *)p;
+    v =
+          (table + 0xF00)[((v       ) & 0xFF)]
+        ^ (table + 0xE00)[((v  >>  8) & 0xFF)]
+        ^ (table + 0xD00)[((v  >> 16) & 0xFF)]
+        ^ (table + 0xC00)[((v  >> 24))]
+        ^ (table + 0xB00)[((d1      ) & 0xFF)]
+        ^ (table + 0xA00)[((d1 >>  8) & 0xFF)]
+        ^ (table + 0x900)[((d1 >> 16) & 0xFF)]
+        ^ (table + 0x800)[((d1 >> 24))]
+        ^ (table + 0x700)[((d2      ) & 0xFF)]
+        ^ (table + 0x600)[((d2 >>  8) & 0xFF)]
+        ^ (table + 0x500)[((d2 >> 16) & 0xFF)]
+        ^ (table + 0x400)[((d2 >> 24))]
+        ^ (table + 0x300)[((d3      ) & 0xFF)]
+        ^ (table + 0x200)[((d3 >>  8) & 0xFF)]
+        ^ (table + 0x100)[((d3 >> 16) & 0xFF)]
+        ^ (table + 0x000)[((d3 >> 24))];
+  }
+  for (; size >= 4; size -= 4, p += 4)
+  {
+    v ^= *(const UInt32 *)p;
+    v =
+          (table + 0x300)[((v      ) & 0xFF)]
+        ^ (table + 0x200)[((v >>  8) & 0xFF)]
+        ^ (table + 0x100)[((v >> 16) & 0xFF)]
+        ^ (table + 0x000)[((v >> 24))];
+  }
+  for (; size > 0; size--, p++)
+    v = CRC_UPDATE_BYTE_2(v, *p);
+  return v;
+}
+
+#endif
+
 #endif
 
 
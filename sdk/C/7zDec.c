@@ -39,9 +39,7 @@
 
 typedef struct
 {
-  IByteIn vt;
-  const Byte *cur;
-  const Byte *end;
+  CByteInBuf buf;
   const Byte *begin;
   UInt64 processed;
   BoolInt extra;
@@ -49,22 +47,23 @@ typedef struct
   const ILookInStream *inStream;
 } CByteInToLook;
 
+/* the range decoder reads from the (buf) window directly and calls ReadByte() only to get the next block */
 static Byte ReadByte(const IByteIn *pp)
 {
-  CByteInToLook *p = CONTAINER_FROM_VTBL(pp, CByteInToLook, vt);
-  if (p->cur != p->end)
-    return *p->cur++;
+  CByteInToLook *p = CONTAINER_FROM_VTBL(pp, CByteInToLook, buf.vt);
+  if (p->buf.Cur != p->buf.Lim)
+    return *p->buf.Cur++;
   if (p->res == SZ_OK)
   {
-    size_t size = p->cur - p->begin;
+    size_t size = p->buf.Cur - p->begin;
     p->processed += size;
     p->res = ILookInStream_Skip(p->inStream, size);
     size = (1 << 25);
     p->res = ILookInStream_Look(p->inStream, (const void **)&p->begin, &size);
-    p->cur = p->begin;
-    p->end = p->begin + size;
+    p->buf.Cur = p->begin;
+    p->buf.Lim = p->begin + size;
     if (size != 0)
-      return *p->cur++;;
+      return *p->buf.Cur++;;
   }
   p->extra = True;
   return 0;
@@ -77,9 +76,9 @@ static SRes SzDecodePpmd(const Byte *props, unsigned propsSize, UInt64 inSize, c
   CByteInToLook s;
   SRes res = SZ_OK;
 
-  s.vt.Read = ReadByte;
+  s.buf.vt.Read = ReadByte;
   s.inStream = inStream;
-  s.begin = s.end = s.cur = NULL;
+  s.begin = s.buf.Lim = s.buf.Cur = NULL;
   s.extra = False;
   s.res = SZ_OK;
   s.processed = 0;
@@ -103,7 +102,7 @@ static SRes SzDecodePpmd(const Byte *props, unsigned propsSize, UInt64 inSize, c
   {
     CPpmd7z_RangeDec rc;
     Ppmd7z_RangeDec_CreateVTable(&rc);
-    rc.Stream = &s.vt;
+    Ppmd7z_RangeDec_SetBuf(&rc, &s.buf);
     if (!Ppmd7z_RangeDec_Init(&rc))
       res = SZ_ERROR_DATA;
     else if (s.extra)
@@ -120,7 +119,7 @@ static SRes SzDecodePpmd(const Byte *props, unsigned propsSize, UInt64 inSize, c
       }
       if (i != outSize)
         res = (s.res != SZ_OK ? s.res : SZ_ERROR_DATA);
-      else if (s.processed + (s.cur - s.begin) != inSize || !Ppmd7z_RangeDec_IsFinishedOK(&rc))
+      else if (s.processed + (s.buf.Cur - s.begin) != inSize || !Ppmd7z_RangeDec_IsFinishedOK(&rc))
         res = SZ_ERROR_DATA;
     }
   }
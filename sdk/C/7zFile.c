@@ -11,6 +11,12 @@
 #include <errno.h>
 #endif
 
+#ifdef _7Z_FILE_MAP_SUPPORTED
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #else
 
 /*
@@ -271,6 +277,127 @@ void FileInStream_CreateVTable(CFileInStream *p)
 }
 
 
+/* ---------- FileMapInStream ---------- */
+
+#ifdef _7Z_FILE_MAP_SUPPORTED
+
+static SRes FileMapInStream_Look(const ILookInStream *pp, const void **buf, size_t *size)
+{
+  CFileMapInStream *p = CONTAINER_FROM_VTBL(pp, CFileMapInStream, vt);
+  size_t rem = (p->pos < p->size) ? p->size - p->pos : 0;
+  if (*size > rem)
+    *size = rem;
+  *buf = (rem != 0) ? p->data + p->pos : p->data;
+  return SZ_OK;
+}
+
+static SRes FileMapInStream_Skip(const ILookInStream *pp, size_t offset)
+{
+  CFileMapInStream *p = CONTAINER_FROM_VTBL(pp, CFileMapInStream, vt);
+  p->pos += offset;
+  return SZ_OK;
+}
+
+static SRes FileMapInStream_Read(const ILookInStream *pp, void *buf, size_t *size)
+{
+  CFileMapInStream *p = CONTAINER_FROM_VTBL(pp, CFileMapInStream, vt);
+  size_t rem = (p->pos < p->size) ? p->size - p->pos : 0;
+  if (*size > rem)
+    *size = rem;
+  if (*size != 0)
+  {
+    memcpy(buf, p->data + p->pos, *size);
+    p->pos += *size;
+  }
+  return SZ_OK;
+}
+
+static SRes FileMapInStream_Seek(const ILookInStream *pp, Int64 *pos, ESzSeek origin)
+{
+  CFileMapInStream *p = CONTAINER_FROM_VTBL(pp, CFileMapInStream, vt);
+  Int64 newPos = *pos;
+  switch (origin)
+  {
+    case SZ_SEEK_SET: break;
+    case SZ_SEEK_CUR: newPos += (Int64)p->pos; break;
+    case SZ_SEEK_END: newPos += (Int64)p->size; break;
+    default: return SZ_ERROR_PARAM;
+  }
+  /* same as fseek(): positions after the end are allowed */
+  if (newPos < 0)
+  {
+    *pos = (Int64)p->pos;
+    return SZ_ERROR_PARAM;
+  }
+  p->pos = (size_t)newPos;
+  *pos = newPos;
+  return SZ_OK;
+}
+
+void FileMapInStream_CreateVTable(CFileMapInStream *p)
+{
+  p->vt.Look = FileMapInStream_Look;
+  p->vt.Skip = FileMapInStream_Skip;
+  p->vt.Read = FileMapInStream_Read;
+  p->vt.Seek = FileMapInStream_Seek;
+}
+
+void FileMapInStream_Construct(CFileMapInStream *p)
+{
+  p->data = NULL;
+  p->size = 0;
+  p->pos = 0;
+}
+
+WRes FileMapInStream_Map(CFileMapInStream *p, CSzFile *file)
+{
+  struct stat st;
+  void *data;
+  int fd = fileno(file->file);
+
+  FileMapInStream_Unmap(p);
+  if (fd < 0 || fstat(fd, &st) != 0)
+    return errno;
+  if (st.st_size < 0 || (UInt64)st.st_size > (size_t)0 - 1)
+    return EFBIG;
+  if (st.st_size == 0)
+    return 0;
+
+  data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED)
+    return errno;
+  p->data = (const Byte *)data;
+  p->size = (size_t)st.st_size;
+  return 0;
+}
+
+WRes FileMapInStream_Unmap(CFileMapInStream *p)
+{
+  WRes res = 0;
+  if (p->data)
+    if (munmap((void *)p->data, p->size) != 0)
+      res = errno;
+  FileMapInStream_Construct(p);
+  return res;
+}
+
+void FileMapInStream_Advise(CFileMapInStream *p, EFileMapAccess access)
+{
+  int advice;
+  if (!p->data)
+    return;
+  switch (access)
+  {
+    case FILE_MAP_ACCESS_SEQUENTIAL: advice = MADV_SEQUENTIAL; break;
+    case FILE_MAP_ACCESS_RANDOM: advice = MADV_RANDOM; break;
+    default: advice = MADV_NORMAL; break;
+  }
+  madvise((void *)p->data, p->size, advice);
+}
+
+#endif
+
+
 /* ---------- FileOutStream ---------- */
 
 static size_t FileOutStream_Write(const ISeqOutStream *pp, const void *data, size_t size)
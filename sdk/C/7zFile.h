@@ -70,6 +70,48 @@ typedef struct
 void FileInStream_CreateVTable(CFileInStream *p);
 
 
+/* ---------- FileMapInStream ---------- */
+
+/*
+  ILookInStream that reads from a memory mapping of the whole file.
+  Look() returns pointers into the mapping, so no data is copied and
+  no system calls are required for reading.
+*/
+
+#if !defined(USE_WINDOWS_FILE) && !defined(UNDER_CE)
+#define _7Z_FILE_MAP_SUPPORTED
+#endif
+
+#ifdef _7Z_FILE_MAP_SUPPORTED
+
+typedef enum
+{
+  FILE_MAP_ACCESS_NORMAL,
+  FILE_MAP_ACCESS_SEQUENTIAL,
+  FILE_MAP_ACCESS_RANDOM
+} EFileMapAccess;
+
+typedef struct
+{
+  ILookInStream vt;
+  const Byte *data;
+  size_t size;
+  size_t pos;
+} CFileMapInStream;
+
+void FileMapInStream_CreateVTable(CFileMapInStream *p);
+void FileMapInStream_Construct(CFileMapInStream *p);
+
+/* maps the whole file. (file) can be closed after the call */
+WRes FileMapInStream_Map(CFileMapInStream *p, CSzFile *file);
+WRes FileMapInStream_Unmap(CFileMapInStream *p);
+
+/* hint for the expected access pattern of the following reads */
+void FileMapInStream_Advise(CFileMapInStream *p, EFileMapAccess access);
+
+#endif
+
+
 typedef struct
 {
   ISeqOutStream vt;
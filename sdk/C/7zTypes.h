@@ -109,6 +109,28 @@ typedef int BoolInt;
 #define False 0
 
 
+#ifndef _WIN32
+
+/* Win32 types and HRESULT codes that are used by the multithreading code
+   (MtCoder, MtDec, XzDec). The values match CPP/Common/MyWindows.h. */
+
+typedef Int32 LONG;
+
+#ifndef S_OK
+#define HRESULT LONG
+#define S_OK    ((HRESULT)0x00000000L)
+#define S_FALSE ((HRESULT)0x00000001L)
+#define E_NOTIMPL ((HRESULT)0x80004001L)
+#define E_NOINTERFACE ((HRESULT)0x80004002L)
+#define E_ABORT ((HRESULT)0x80004004L)
+#define E_FAIL ((HRESULT)0x80004005L)
+#define E_OUTOFMEMORY ((HRESULT)0x8007000EL)
+#define E_INVALIDARG ((HRESULT)0x80070057L)
+#endif
+
+#endif
+
+
 #ifdef _WIN32
 #define MY_STD_CALL __stdcall
 #else
@@ -166,6 +188,31 @@ struct IByteOut
 #define IByteOut_Write(p, b) (p)->Write(p, b)
 
 
+/* IByteIn / IByteOut with a buffer window [Cur, Lim) that byte coders can access directly.
+   The vt function is called only if the window is empty / full, so there is one
+   indirect call per block instead of one per byte:
+     CByteInBuf::vt.Read() must refill the window and return the next byte (0 at EOF).
+     CByteOutBuf::vt.Write() must drain the window and store the byte.
+   The vt functions must also work if the window is not empty / full, so both
+   structures can still be used as plain IByteIn / IByteOut streams. */
+
+typedef struct
+{
+  IByteIn vt;
+  const Byte *Cur;
+  const Byte *Lim;
+} CByteInBuf;
+#define ByteInBuf_Read(p) ((p)->Cur != (p)->Lim ? *(p)->Cur++ : IByteIn_Read(&(p)->vt))
+
+typedef struct
+{
+  IByteOut vt;
+  Byte *Cur;
+  Byte *Lim;
+} CByteOutBuf;
+#define ByteOutBuf_Write(p, b) ((p)->Cur != (p)->Lim ? (void)(*(p)->Cur++ = (b)) : IByteOut_Write(&(p)->vt, b))
+
+
 typedef struct ISeqInStream ISeqInStream;
 struct ISeqInStream
 {
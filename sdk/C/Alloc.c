@@ -1,6 +1,11 @@
 /* Alloc.c -- Memory allocation functions
 2018-04-27 : Igor Pavlov : Public domain */
 
+/* for MAP_ANONYMOUS, MAP_HUGETLB and MADV_HUGEPAGE in strict C modes */
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include "Precomp.h"
 
 #include <stdio.h>
@@ -12,6 +17,17 @@
 
 #include "Alloc.h"
 
+#ifdef _7ZIP_LINUX_LARGE_PAGES
+#include <string.h>
+#endif
+#if defined(_7ZIP_LINUX_LARGE_PAGES) || defined(_7ZIP_LINUX_RING_ALLOC)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#ifdef _7ZIP_LINUX_RING_ALLOC
+#include <sys/syscall.h>
+#endif
+
 /* #define _SZ_ALLOC_DEBUG */
 
 /* use _SZ_ALLOC_DEBUG to debug alloc/free operations */
@@ -236,6 +252,348 @@ void BigFree(void *address)
 
 #endif
 
+#ifdef _7ZIP_LINUX_LARGE_PAGES
+
+/*
+  The addresses and sizes of the mapped MidAlloc() / BigAlloc() blocks are
+  stored in a table, so the blocks start at a large page boundary and a
+  block of (n) large pages maps exactly (n) pages. Blocks that are not in
+  the table were allocated with MyAlloc().
+*/
+
+#define LP_DEFAULT_PAGE_SIZE ((size_t)1 << 21)
+#define LP_MAX_PAGE_SIZE ((size_t)1 << 30)
+
+static unsigned g_LargePageMode = LARGE_PAGES_MODE_THP;
+static size_t g_ThpPageSize = 0;
+#ifdef MAP_HUGETLB
+static size_t g_HugeTlbPageSize = 0;
+#endif
+static CLargePageStats g_LargePageStats;
+
+#define LP_STAT_ADD(name, v) __sync_fetch_and_add(&g_LargePageStats.name, (UInt64)(v))
+
+typedef struct
+{
+  void *address;
+  size_t size;
+} CLargePageBlock;
+
+static CLargePageBlock *g_LargePageBlocks;
+static size_t g_LargePageNumBlocks;
+static size_t g_LargePageNumBlocksAllocated;
+static int g_LargePageBlocksLock;
+
+#define LP_LOCK() while (__atomic_exchange_n(&g_LargePageBlocksLock, 1, __ATOMIC_ACQUIRE)) {}
+#define LP_UNLOCK() __atomic_store_n(&g_LargePageBlocksLock, 0, __ATOMIC_RELEASE)
+
+static BoolInt LargePages_AddBlock(void *address, size_t size)
+{
+  BoolInt res = True;
+  LP_LOCK();
+  if (g_LargePageNumBlocks == g_LargePageNumBlocksAllocated)
+  {
+    size_t num = g_LargePageNumBlocksAllocated ? g_LargePageNumBlocksAllocated * 2 : 16;
+    CLargePageBlock *blocks = (CLargePageBlock *)MyAlloc(num * sizeof(CLargePageBlock));
+    if (blocks)
+    {
+      if (g_LargePageNumBlocks != 0)
+        memcpy(blocks, g_LargePageBlocks, g_LargePageNumBlocks * sizeof(CLargePageBlock));
+      MyFree(g_LargePageBlocks);
+      g_LargePageBlocks = blocks;
+      g_LargePageNumBlocksAllocated = num;
+    }
+    else
+      res = False;
+  }
+  if (res)
+  {
+    g_LargePageBlocks[g_LargePageNumBlocks].address = address;
+    g_LargePageBlocks[g_LargePageNumBlocks].size = size;
+    g_LargePageNumBlocks++;
+  }
+  LP_UNLOCK();
+  return res;
+}
+
+/* returns the size of the mapping, or 0 if (address) is not a mapped block */
+static size_t LargePages_RemoveBlock(void *address)
+{
+  size_t size = 0;
+  size_t i;
+  LP_LOCK();
+  for (i = 0; i < g_LargePageNumBlocks; i++)
+    if (g_LargePageBlocks[i].address == address)
+    {
+      size = g_LargePageBlocks[i].size;
+      g_LargePageBlocks[i] = g_LargePageBlocks[--g_LargePageNumBlocks];
+      break;
+    }
+  LP_UNLOCK();
+  return size;
+}
+
+/* returns the number that follows (key) in the file, or 0 */
+static size_t ReadSizeValue(const char *fileName, const char *key)
+{
+  char buf[1 << 12];
+  size_t num;
+  const char *s;
+  FILE *f = fopen(fileName, "r");
+  if (!f)
+    return 0;
+  num = fread(buf, 1, sizeof(buf) - 1, f);
+  fclose(f);
+  buf[num] = 0;
+  s = strstr(buf, key);
+  if (!s)
+    return 0;
+  return (size_t)strtoul(s + strlen(key), NULL, 10);
+}
+
+static size_t GetPageSize(size_t *cache, const char *fileName, const char *key, unsigned shift)
+{
+  size_t size = __atomic_load_n(cache, __ATOMIC_RELAXED);
+  if (size == 0)
+  {
+    size = ReadSizeValue(fileName, key) << shift;
+    if (size == 0 || (size & (size - 1)) != 0 || size > LP_MAX_PAGE_SIZE)
+      size = LP_DEFAULT_PAGE_SIZE;
+    __atomic_store_n(cache, size, __ATOMIC_RELAXED);
+  }
+  return size;
+}
+
+#define GetThpPageSize() GetPageSize(&g_ThpPageSize, \
+    "/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "", 0)
+#ifdef MAP_HUGETLB
+#define GetHugeTlbPageSize() GetPageSize(&g_HugeTlbPageSize, \
+    "/proc/meminfo", "Hugepagesize:", 10)
+#endif
+
+void SetLargePageMode(unsigned mode)
+{
+  __atomic_store_n(&g_LargePageMode, mode, __ATOMIC_RELAXED);
+}
+
+void SetLargePageSize()
+{
+  SetLargePageMode(LARGE_PAGES_MODE_HUGETLB);
+}
+
+void LargePages_GetStats(CLargePageStats *p)
+{
+  p->numHugeTlb = __atomic_load_n(&g_LargePageStats.numHugeTlb, __ATOMIC_RELAXED);
+  p->numThp = __atomic_load_n(&g_LargePageStats.numThp, __ATOMIC_RELAXED);
+  p->numFallback = __atomic_load_n(&g_LargePageStats.numFallback, __ATOMIC_RELAXED);
+  p->numSmall = __atomic_load_n(&g_LargePageStats.numSmall, __ATOMIC_RELAXED);
+  p->hugeTlbBytes = __atomic_load_n(&g_LargePageStats.hugeTlbBytes, __ATOMIC_RELAXED);
+  p->thpBytes = __atomic_load_n(&g_LargePageStats.thpBytes, __ATOMIC_RELAXED);
+}
+
+/* maps (size) bytes rounded up to (ps), the mapping is aligned to (ps) */
+static void *LargePages_Map(size_t size, size_t ps, int flags, size_t *mapSize)
+{
+  size_t size2 = (size + ps - 1) & ~(ps - 1);
+  size_t slack;
+  Byte *base;
+  Byte *aligned;
+  if (size2 < size)
+    return NULL;
+
+  #ifdef MAP_HUGETLB
+  if (flags & MAP_HUGETLB)
+  {
+    /* the kernel aligns hugetlbfs mappings */
+    base = (Byte *)mmap(NULL, size2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+    if (base == (Byte *)MAP_FAILED)
+      return NULL;
+    *mapSize = size2;
+    return base;
+  }
+  #endif
+
+  slack = ps - (size_t)sysconf(_SC_PAGESIZE);
+  if (size2 + slack < size2)
+    return NULL;
+  base = (Byte *)mmap(NULL, size2 + slack, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+  if (base == (Byte *)MAP_FAILED)
+    return NULL;
+  aligned = base + ((ps - ((size_t)base & (ps - 1))) & (ps - 1));
+  if (aligned != base)
+    munmap(base, (size_t)(aligned - base));
+  if (aligned + size2 != base + size2 + slack)
+    munmap(aligned + size2, (size_t)(base + size2 + slack - (aligned + size2)));
+  *mapSize = size2;
+  return aligned;
+}
+
+static void *LargePages_Alloc(size_t size, BoolInt useHugeTlb)
+{
+  Byte *p = NULL;
+  size_t mapSize = 0;
+  unsigned mode = __atomic_load_n(&g_LargePageMode, __ATOMIC_RELAXED);
+  size_t ps = GetThpPageSize();
+
+  #ifdef MAP_HUGETLB
+  if (useHugeTlb && mode == LARGE_PAGES_MODE_HUGETLB)
+  {
+    /* the threshold depends on the hugetlbfs page size, that can be 1 GiB */
+    size_t hps = GetHugeTlbPageSize();
+    if (size >= hps / 2)
+    {
+      p = (Byte *)LargePages_Map(size, hps, MAP_HUGETLB, &mapSize);
+      if (p)
+      {
+        LP_STAT_ADD(numHugeTlb, 1);
+        LP_STAT_ADD(hugeTlbBytes, mapSize);
+      }
+    }
+  }
+  #else
+  UNUSED_VAR(useHugeTlb);
+  #endif
+
+  if (!p)
+  {
+    if (mode == LARGE_PAGES_MODE_NONE || size < ps / 2)
+      LP_STAT_ADD(numSmall, 1);
+    else
+    {
+      p = (Byte *)LargePages_Map(size, ps, 0, &mapSize);
+      #ifdef MADV_HUGEPAGE
+      if (p && madvise(p, mapSize, MADV_HUGEPAGE) == 0)
+      {
+        LP_STAT_ADD(numThp, 1);
+        LP_STAT_ADD(thpBytes, mapSize);
+      }
+      else
+      #endif
+        LP_STAT_ADD(numFallback, 1);
+    }
+  }
+
+  if (p && !LargePages_AddBlock(p, mapSize))
+  {
+    munmap(p, mapSize);
+    p = NULL;
+  }
+  if (!p)
+    p = (Byte *)MyAlloc(size);
+  return p;
+}
+
+static void LargePages_Free(void *address)
+{
+  size_t mapSize;
+  if (!address)
+    return;
+  mapSize = LargePages_RemoveBlock(address);
+  if (mapSize != 0)
+    munmap(address, mapSize);
+  else
+    MyFree(address);
+}
+
+void *MidAlloc(size_t size)
+{
+  if (size == 0)
+    return NULL;
+
+  PRINT_ALLOC("Alloc-Mid", g_allocCountMid, size, NULL);
+
+  return LargePages_Alloc(size, False);
+}
+
+void MidFree(void *address)
+{
+  PRINT_FREE("Free-Mid", g_allocCountMid, address);
+
+  LargePages_Free(address);
+}
+
+void *BigAlloc(size_t size)
+{
+  if (size == 0)
+    return NULL;
+
+  PRINT_ALLOC("Alloc-Big", g_allocCountBig, size, NULL);
+
+  return LargePages_Alloc(size, True);
+}
+
+void BigFree(void *address)
+{
+  PRINT_FREE("Free-Big", g_allocCountBig, address);
+
+  LargePages_Free(address);
+}
+
+#endif
+
+
+#if defined(_7ZIP_LINUX_RING_ALLOC) && defined(SYS_memfd_create)
+
+#ifndef MFD_CLOEXEC
+#define MFD_CLOEXEC 1U
+#endif
+
+void *RingAlloc(size_t *size)
+{
+  size_t ps = (size_t)sysconf(_SC_PAGESIZE);
+  size_t size2 = (*size + ps - 1) & ~(ps - 1);
+  Byte *base;
+  int fd;
+
+  if (size2 < *size || size2 == 0 || size2 * 2 < size2)
+    return NULL;
+  fd = (int)syscall(SYS_memfd_create, "7z-ring", MFD_CLOEXEC);
+  if (fd < 0)
+    return NULL;
+  base = NULL;
+  if (ftruncate(fd, (off_t)size2) == 0)
+  {
+    /* reserve the address range for both mappings, then replace it */
+    base = (Byte *)mmap(NULL, size2 * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == (Byte *)MAP_FAILED)
+      base = NULL;
+    else if (mmap(base, size2, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+        || mmap(base + size2, size2, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+    {
+      munmap(base, size2 * 2);
+      base = NULL;
+    }
+  }
+  /* the mappings keep the memory */
+  close(fd);
+  if (!base)
+    return NULL;
+  *size = size2;
+  return base + size2;
+}
+
+void RingFree(void *address, size_t size)
+{
+  if (address)
+    munmap((Byte *)address - size, size * 2);
+}
+
+#else
+
+void *RingAlloc(size_t *size)
+{
+  UNUSED_VAR(size);
+  return NULL;
+}
+
+void RingFree(void *address, size_t size)
+{
+  UNUSED_VAR(address);
+  UNUSED_VAR(size);
+}
+
+#endif
+
 
 static void *SzAlloc(ISzAllocPtr p, size_t size) { UNUSED_VAR(p); return MyAlloc(size); }
 static void SzFree(ISzAllocPtr p, void *address) { UNUSED_VAR(p); MyFree(address); }
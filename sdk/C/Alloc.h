@@ -11,7 +11,22 @@ EXTERN_C_BEGIN
 void *MyAlloc(size_t size);
 void MyFree(void *address);
 
-#ifdef _WIN32
+/* sanitizers can't check blocks that are mapped with mmap() */
+#if defined(__has_feature)
+  #if __has_feature(address_sanitizer) || __has_feature(memory_sanitizer) || \
+      __has_feature(thread_sanitizer)
+    #define _7ZIP_NO_LARGE_PAGES
+  #endif
+#endif
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+  #define _7ZIP_NO_LARGE_PAGES
+#endif
+
+#if !defined(_WIN32) && defined(__linux__) && !defined(_7ZIP_NO_LARGE_PAGES)
+  #define _7ZIP_LINUX_LARGE_PAGES
+#endif
+
+#if defined(_WIN32) || defined(_7ZIP_LINUX_LARGE_PAGES)
 
 void SetLargePageSize();
 
@@ -29,6 +44,50 @@ void BigFree(void *address);
 
 #endif
 
+#ifdef _7ZIP_LINUX_LARGE_PAGES
+
+/*
+  Large blocks of MidAlloc() and BigAlloc() are mapped with mmap() and aligned
+  to the transparent huge page (THP) size. BigAlloc() can also use explicit
+  hugetlbfs pages, SetLargePageSize() selects LARGE_PAGES_MODE_HUGETLB.
+  All other blocks and failed mappings fall back to MyAlloc().
+*/
+
+#define LARGE_PAGES_MODE_NONE    0
+#define LARGE_PAGES_MODE_THP     1  /* default */
+#define LARGE_PAGES_MODE_HUGETLB 2  /* hugetlbfs for BigAlloc(), THP as fallback */
+
+void SetLargePageMode(unsigned mode);
+
+typedef struct
+{
+  UInt64 numHugeTlb;    /* blocks backed by hugetlbfs pages */
+  UInt64 numThp;        /* blocks advised with MADV_HUGEPAGE */
+  UInt64 numFallback;   /* large blocks that could not use huge pages */
+  UInt64 numSmall;      /* blocks below the large page threshold */
+  UInt64 hugeTlbBytes;
+  UInt64 thpBytes;
+} CLargePageStats;
+
+void LargePages_GetStats(CLargePageStats *p);
+
+#endif
+
+#if !defined(_WIN32) && defined(__linux__) && !defined(_7ZIP_NO_RING_ALLOC)
+  #define _7ZIP_LINUX_RING_ALLOC
+#endif
+
+/*
+  RingAlloc() allocates a ring buffer whose pages are mapped twice, back to
+  back, from one memfd. It returns the address of the second mapping, so
+  (p[i - *size] == p[i]) for (0 <= i < *size), and rounds (*size) up to the
+  page size. It returns NULL, if the system doesn't support it.
+  RingFree() must get the (*size) that was returned by RingAlloc().
+*/
+
+void *RingAlloc(size_t *size);
+void RingFree(void *address, size_t size);
+
 extern const ISzAlloc g_Alloc;
 extern const ISzAlloc g_BigAlloc;
 extern const ISzAlloc g_MidAlloc;
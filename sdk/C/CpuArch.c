@@ -15,6 +15,10 @@
 #include <intrin.h>
 #endif
 
+#if defined(_MSC_VER) && _MSC_VER >= 1600
+#include <immintrin.h>
+#endif
+
 #if defined(USE_ASM) && !defined(MY_CPU_AMD64)
 static UInt32 CheckFlag(UInt32 flag)
 {
@@ -99,7 +103,7 @@ void MyCPUID(UInt32 function, UInt32 *a, UInt32 *b, UInt32 *c, UInt32 *d)
   #endif
       "=c" (*c) ,
       "=d" (*d)
-    : "0" (function)) ;
+    : "0" (function), "2" ((UInt32)0)) ;
 
   #endif
   
@@ -197,6 +201,59 @@ BoolInt CPU_Is_Aes_Supported()
   return (p.c >> 25) & 1;
 }
 
+BoolInt CPU_IsSupported_SSE41()
+{
+  Cx86cpuid p;
+  CHECK_SYS_SSE_SUPPORT
+  if (!x86cpuid_CheckAndRead(&p))
+    return False;
+  return (p.c >> 19) & 1;
+}
+
+BoolInt CPU_IsSupported_PCLMUL()
+{
+  Cx86cpuid p;
+  CHECK_SYS_SSE_SUPPORT
+  if (!x86cpuid_CheckAndRead(&p))
+    return False;
+  /* PCLMULQDQ and SSE2 */
+  return ((p.c >> 1) & 1) && ((p.d >> 26) & 1);
+}
+
+/* returns the low 32 bits of XCR0, the state components enabled by the OS */
+static UInt32 MyXGETBV0()
+{
+  #if defined(__GNUC__)
+  UInt32 a, d;
+  __asm__ __volatile__ (".byte 0x0f, 0x01, 0xd0" : "=a" (a), "=d" (d) : "c" (0));
+  return a;
+  #elif defined(_MSC_VER) && _MSC_VER >= 1600
+  return (UInt32)_xgetbv(0);
+  #else
+  return 0;
+  #endif
+}
+
+BoolInt CPU_IsSupported_AVX2()
+{
+  Cx86cpuid p;
+  CHECK_SYS_SSE_SUPPORT
+  if (!x86cpuid_CheckAndRead(&p))
+    return False;
+  /* AVX and OSXSAVE, the OS must save the XMM and YMM registers */
+  if (((p.c >> 27) & 1) == 0 || ((p.c >> 28) & 1) == 0)
+    return False;
+  if ((MyXGETBV0() & 6) != 6)
+    return False;
+  if (p.maxFunc < 7)
+    return False;
+  {
+    UInt32 d[4] = { 0 };
+    MyCPUID(7, &d[0], &d[1], &d[2], &d[3]);
+    return (d[1] >> 5) & 1;
+  }
+}
+
 BoolInt CPU_IsSupported_PageGB()
 {
   Cx86cpuid cpuid;
@@ -328,6 +328,9 @@ int x86cpuid_GetFirm(const Cx86cpuid *p);
 BoolInt CPU_Is_InOrder();
 BoolInt CPU_Is_Aes_Supported();
 BoolInt CPU_IsSupported_PageGB();
+BoolInt CPU_IsSupported_SSE41();
+BoolInt CPU_IsSupported_AVX2();
+BoolInt CPU_IsSupported_PCLMUL();
 
 #endif
 
@@ -5,9 +5,36 @@
 
 #include <string.h>
 
+#include "CpuArch.h"
 #include "LzFind.h"
 #include "LzHash.h"
 
+#if defined(MY_CPU_X86_OR_AMD64) && ( \
+    (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) || \
+    defined(__clang__) || (defined(_MSC_VER) && _MSC_VER >= 1800))
+  #define LZFIND_NORMALIZE_SIMD
+  #include <immintrin.h>
+  #if defined(__GNUC__) || defined(__clang__)
+    #define LZFIND_TARGET(t) __attribute__((target(t)))
+  #else
+    #define LZFIND_TARGET(t)
+  #endif
+#endif
+
+#if defined(MY_CPU_64BIT) && defined(MY_CPU_LE_UNALIGN) && \
+    (defined(__GNUC__) || defined(__clang__) || (defined(_MSC_VER) && _MSC_VER >= 1400))
+  #define LZFIND_WORD_COMPARE
+  #ifdef _MSC_VER
+    #include <intrin.h>
+    #pragma intrinsic(_BitScanForward64)
+  #endif
+#endif
+
+#if !defined(_7ZIP_ST) && !defined(_WIN32)
+  #define LZFIND_NORMALIZE_ONCE
+  #include <pthread.h>
+#endif
+
 #define kEmptyHashValue 0
 #define kMaxValForNormalize ((UInt32)0xFFFFFFFF)
 #define kNormalizeStepMin (1 << 10) /* it must be power of 2 */
@@ -136,9 +163,96 @@ static void MatchFinder_SetDefaultSettings(CMatchFinder *p)
 
 #define kCrcPoly 0xEDB88320
 
+typedef void (*Func_Normalize3)(UInt32 subValue, CLzRef *items, size_t numItems);
+
+static void MatchFinder_Normalize3_Scalar(UInt32 subValue, CLzRef *items, size_t numItems);
+
+/* selected once by the first MatchFinder_Construct */
+static Func_Normalize3 g_Normalize3;
+
+#ifdef LZFIND_NORMALIZE_SIMD
+
+/* value <= subValue ? kEmptyHashValue : value - subValue, as max(value, subValue) - subValue */
+
+LZFIND_TARGET("sse4.1")
+static void MatchFinder_Normalize3_SSE41(UInt32 subValue, CLzRef *items, size_t numItems)
+{
+  __m128i sub = _mm_set1_epi32((int)subValue);
+  size_t i = 0;
+  for (; i + 8 <= numItems; i += 8)
+  {
+    __m128i v0 = _mm_loadu_si128((const __m128i *)(const void *)(items + i));
+    __m128i v1 = _mm_loadu_si128((const __m128i *)(const void *)(items + i + 4));
+    v0 = _mm_sub_epi32(_mm_max_epu32(v0, sub), sub);
+    v1 = _mm_sub_epi32(_mm_max_epu32(v1, sub), sub);
+    _mm_storeu_si128((__m128i *)(void *)(items + i), v0);
+    _mm_storeu_si128((__m128i *)(void *)(items + i + 4), v1);
+  }
+  MatchFinder_Normalize3_Scalar(subValue, items + i, numItems - i);
+}
+
+LZFIND_TARGET("avx2")
+static void MatchFinder_Normalize3_AVX2(UInt32 subValue, CLzRef *items, size_t numItems)
+{
+  __m256i sub = _mm256_set1_epi32((int)subValue);
+  size_t i = 0;
+  for (; i + 16 <= numItems; i += 16)
+  {
+    __m256i v0 = _mm256_loadu_si256((const __m256i *)(const void *)(items + i));
+    __m256i v1 = _mm256_loadu_si256((const __m256i *)(const void *)(items + i + 8));
+    v0 = _mm256_sub_epi32(_mm256_max_epu32(v0, sub), sub);
+    v1 = _mm256_sub_epi32(_mm256_max_epu32(v1, sub), sub);
+    _mm256_storeu_si256((__m256i *)(void *)(items + i), v0);
+    _mm256_storeu_si256((__m256i *)(void *)(items + i + 8), v1);
+  }
+  MatchFinder_Normalize3_Scalar(subValue, items + i, numItems - i);
+}
+
+#endif
+
+static void MatchFinder_SelectNormalize3(void)
+{
+  Func_Normalize3 func = MatchFinder_Normalize3_Scalar;
+  #ifdef LZFIND_NORMALIZE_SIMD
+  if (CPU_IsSupported_AVX2())
+    func = MatchFinder_Normalize3_AVX2;
+  else if (CPU_IsSupported_SSE41())
+    func = MatchFinder_Normalize3_SSE41;
+  #endif
+  g_Normalize3 = func;
+}
+
+/*
+  CPUID can be slow (it traps in virtual machines), so it's checked only once.
+  Encoders can be constructed in worker threads (Lzma2Enc, MtCoder), so
+  multithreaded builds select the function with pthread_once().
+  On Windows all threads select the same function and aligned pointers
+  are written atomically.
+*/
+
+#ifdef LZFIND_NORMALIZE_ONCE
+
+static pthread_once_t g_Normalize3_Once = PTHREAD_ONCE_INIT;
+
+static void MatchFinder_InitNormalize3(void)
+{
+  pthread_once(&g_Normalize3_Once, MatchFinder_SelectNormalize3);
+}
+
+#else
+
+static void MatchFinder_InitNormalize3(void)
+{
+  if (!g_Normalize3)
+    MatchFinder_SelectNormalize3();
+}
+
+#endif
+
 void MatchFinder_Construct(CMatchFinder *p)
 {
   unsigned i;
+  MatchFinder_InitNormalize3();
   p->bufferBase = NULL;
   p->directInput = 0;
   p->hash = NULL;
@@ -318,12 +432,12 @@ void MatchFinder_Init_HighHash(CMatchFinder *p)
 }
 
 
-void MatchFinder_Init_3(CMatchFinder *p, int readData)
+static void MatchFinder_Init_Pos(CMatchFinder *p, UInt32 pos, int readData)
 {
   p->cyclicBufferPos = 0;
   p->buffer = p->bufferBase;
   p->pos =
-  p->streamPos = p->cyclicBufferSize;
+  p->streamPos = pos;
   p->result = SZ_OK;
   p->streamEndWasReached = 0;
   
@@ -334,6 +448,12 @@ void MatchFinder_Init_3(CMatchFinder *p, int readData)
 }
 
 
+void MatchFinder_Init_3(CMatchFinder *p, int readData)
+{
+  MatchFinder_Init_Pos(p, p->cyclicBufferSize, readData);
+}
+
+
 void MatchFinder_Init(CMatchFinder *p)
 {
   MatchFinder_Init_HighHash(p);
@@ -341,13 +461,134 @@ void MatchFinder_Init(CMatchFinder *p)
   MatchFinder_Init_3(p, True);
 }
 
+
+/*
+  MatchFinder_Init_Continue() starts a new stream without clearing the hash table.
+  All references in (hash) and (son) are smaller than (pos) of the previous stream.
+  The new stream starts at (pos + cyclicBufferSize), so these references are
+  outside of the history window and are ignored like kEmptyHashValue.
+*/
+
+void MatchFinder_Init_Continue(CMatchFinder *p)
+{
+  UInt32 pos = p->pos;
+  if (pos > kMaxValForNormalize - p->cyclicBufferSize)
+  {
+    MatchFinder_Init(p);
+    return;
+  }
+  MatchFinder_Init_Pos(p, pos + p->cyclicBufferSize, True);
+}
+
+
+void MatchFinder_Init_Prefix(CMatchFinder *p, UInt32 prefixSize)
+{
+  /* we read the stream as if the prefix was processed already,
+     so (keepSizeAfter) bytes are available after the prefix */
+  MatchFinder_Init_Pos(p, p->cyclicBufferSize + prefixSize, False);
+  p->buffer = p->bufferBase + prefixSize;
+  MatchFinder_ReadBlock(p);
+  p->buffer = p->bufferBase;
+  p->pos -= prefixSize;
+  MatchFinder_SetLimits(p);
+}
+
+
+size_t MatchFinder_GetPrefixNumRefs(const CMatchFinder *p, UInt32 numPos)
+{
+  return (size_t)p->hashSizeSum + ((size_t)numPos << (p->btMode ? 1 : 0));
+}
+
+
+void MatchFinder_SavePrefix(const CMatchFinder *p, CLzRef *refs, UInt32 numPos)
+{
+  memcpy(refs, p->hash, (size_t)MatchFinder_GetPrefixNumRefs(p, numPos) * sizeof(CLzRef));
+}
+
+
+void MatchFinder_LoadPrefix(CMatchFinder *p, const CLzRef *refs, UInt32 numPos, int undoResult)
+{
+  if (undoResult == 0)
+    memcpy(p->hash, refs, (size_t)p->hashSizeSum * sizeof(CLzRef));
+  if (undoResult < 2)
+    memcpy(p->son, refs + p->hashSizeSum,
+        ((size_t)MatchFinder_GetPrefixNumRefs(p, numPos) - p->hashSizeSum) * sizeof(CLzRef));
+  p->cyclicBufferPos = numPos;
+  p->buffer += numPos;
+  p->pos += numPos;
+  MatchFinder_SetLimits(p);
+}
+
+
+/*
+  The stream changed only the (son) items of the positions after the
+  prefix and the hash items of its positions, that we can calculate again
+  from the data in the window. (son) items of the saved positions can be
+  changed by Bt*_MatchFinder functions, MatchFinder_LoadPrefix() restores them.
+  Hc*_MatchFinder functions write only the (son) item of the current position,
+  so the saved positions are unchanged, if (cyclicBufferPos) didn't wrap.
+*/
+
+int MatchFinder_UndoPrefix(CMatchFinder *p, const CLzRef *refs, UInt32 numPos)
+{
+  UInt32 pos = p->cyclicBufferSize + numPos;
+  UInt32 lim = p->pos;
+  const Byte *cur = p->bufferBase + numPos;
+  CLzRef *hash = p->hash;
+
+  if (p->directInput || lim < pos
+      || p->buffer != p->bufferBase + (size_t)(lim - p->cyclicBufferSize))
+    return 0;
+
+  /* the positions that were inserted had (numHashBytes) available bytes */
+  if (lim > p->streamPos - p->numHashBytes + 1)
+    lim = p->streamPos - p->numHashBytes + 1;
+
+  if (p->numHashBytes == 2)
+  {
+    for (; pos < lim; pos++, cur++)
+    {
+      UInt32 hv;
+      HASH2_CALC;
+      hash[hv] = refs[hv];
+    }
+  }
+  else if (p->numHashBytes == 3)
+  {
+    for (; pos < lim; pos++, cur++)
+    {
+      UInt32 h2, hv;
+      HASH3_CALC;
+      hash[h2] = refs[h2];
+      hv += kFix3HashSize;
+      hash[hv] = refs[hv];
+    }
+  }
+  else
+  {
+    for (; pos < lim; pos++, cur++)
+    {
+      UInt32 h2, h3, hv;
+      HASH4_CALC;
+      hash[h2] = refs[h2];
+      h3 += kFix3HashSize;
+      hash[h3] = refs[h3];
+      hv += kFix4HashSize;
+      hash[hv] = refs[hv];
+    }
+  }
+  if (!p->btMode && p->pos - p->cyclicBufferSize <= p->cyclicBufferSize)
+    return 2;
+  return 1;
+}
+
   
 static UInt32 MatchFinder_GetSubValue(CMatchFinder *p)
 {
   return (p->pos - p->historySize - 1) & kNormalizeMask;
 }
 
-void MatchFinder_Normalize3(UInt32 subValue, CLzRef *items, size_t numItems)
+static void MatchFinder_Normalize3_Scalar(UInt32 subValue, CLzRef *items, size_t numItems)
 {
   size_t i;
   for (i = 0; i < numItems; i++)
@@ -361,6 +602,14 @@ void MatchFinder_Normalize3(UInt32 subValue, CLzRef *items, size_t numItems)
   }
 }
 
+void MatchFinder_Normalize3(UInt32 subValue, CLzRef *items, size_t numItems)
+{
+  if (g_Normalize3)
+    g_Normalize3(subValue, items, numItems);
+  else
+    MatchFinder_Normalize3_Scalar(subValue, items, numItems);
+}
+
 static void MatchFinder_Normalize(CMatchFinder *p)
 {
   UInt32 subValue = MatchFinder_GetSubValue(p);
@@ -382,6 +631,39 @@ static void MatchFinder_CheckLimits(CMatchFinder *p)
 }
 
 
+/*
+  returns the length of the common prefix of (cur) and (cur + diff),
+  the first (len) bytes must be equal already.
+  The word-wide version compares 8 bytes at a time and finds the first
+  mismatching byte from the lowest set bit of (a ^ b). It reads only bytes
+  before (cur + lenLimit), so the result is identical to the byte loop.
+*/
+MY_FORCE_INLINE
+static unsigned GetMatchLen(const Byte *cur, ptrdiff_t diff, unsigned len, unsigned lenLimit)
+{
+  #ifdef LZFIND_WORD_COMPARE
+  while (len + 8 <= lenLimit)
+  {
+    UInt64 x = GetUi64(cur + len) ^ GetUi64(cur + len + diff);
+    if (x != 0)
+    {
+      #ifdef _MSC_VER
+      unsigned long index;
+      _BitScanForward64(&index, x);
+      return len + ((unsigned)index >> 3);
+      #else
+      return len + ((unsigned)__builtin_ctzll(x) >> 3);
+      #endif
+    }
+    len += 8;
+  }
+  #endif
+  for (; len != lenLimit; len++)
+    if (cur[len] != cur[(ptrdiff_t)len + diff])
+      break;
+  return len;
+}
+
 /*
   (lenLimit > maxLen)
 */
@@ -419,7 +701,6 @@ static UInt32 * Hc_GetMatchesSpec(unsigned lenLimit, UInt32 curMatch, UInt32 pos
   }
   */
 
-  const Byte *lim = cur + lenLimit;
   son[_cyclicBufferPos] = curMatch;
   do
   {
@@ -432,25 +713,19 @@ static UInt32 * Hc_GetMatchesSpec(unsigned lenLimit, UInt32 curMatch, UInt32 pos
       diff = (ptrdiff_t)0 - delta;
       if (cur[maxLen] == cur[maxLen + diff])
       {
-        const Byte *c = cur;
-        while (*c == c[diff])
+        unsigned len = GetMatchLen(cur, diff, 0, lenLimit);
+        if (len == lenLimit)
         {
-          if (++c == lim)
-          {
-            distances[0] = (UInt32)(lim - cur);
-            distances[1] = delta - 1;
-            return distances + 2;
-          }
+          distances[0] = (UInt32)len;
+          distances[1] = delta - 1;
+          return distances + 2;
         }
+        if (maxLen < len)
         {
-          unsigned len = (unsigned)(c - cur);
-          if (maxLen < len)
-          {
-            maxLen = len;
-            distances[0] = (UInt32)len;
-            distances[1] = delta - 1;
-            distances += 2;
-          }
+          maxLen = len;
+          distances[0] = (UInt32)len;
+          distances[1] = delta - 1;
+          distances += 2;
         }
       }
     }
@@ -484,10 +759,7 @@ UInt32 * GetMatchesSpec1(UInt32 lenLimit, UInt32 curMatch, UInt32 pos, const Byt
       UInt32 pair0 = pair[0];
       if (pb[len] == cur[len])
       {
-        if (++len != lenLimit && pb[len] == cur[len])
-          while (++len != lenLimit)
-            if (pb[len] != cur[len])
-              break;
+        len = GetMatchLen(cur, (ptrdiff_t)0 - delta, len + 1, lenLimit);
         if (maxLen < len)
         {
           maxLen = (UInt32)len;
@@ -539,9 +811,7 @@ static void SkipMatchesSpec(UInt32 lenLimit, UInt32 curMatch, UInt32 pos, const
       unsigned len = (len0 < len1 ? len0 : len1);
       if (pb[len] == cur[len])
       {
-        while (++len != lenLimit)
-          if (pb[len] != cur[len])
-            break;
+        len = GetMatchLen(cur, (ptrdiff_t)0 - delta, len + 1, lenLimit);
         {
           if (len == lenLimit)
           {
@@ -596,11 +866,7 @@ static void MatchFinder_MovePos(CMatchFinder *p) { MOVE_POS; }
   SkipMatchesSpec((UInt32)lenLimit, curMatch, MF_PARAMS(p)); MOVE_POS;
 
 #define UPDATE_maxLen { \
-    ptrdiff_t diff = (ptrdiff_t)0 - d2; \
-    const Byte *c = cur + maxLen; \
-    const Byte *lim = cur + lenLimit; \
-    for (; c != lim; c++) if (*(c + diff) != *c) break; \
-    maxLen = (unsigned)(c - cur); }
+    maxLen = GetMatchLen(cur, (ptrdiff_t)0 - d2, maxLen, lenLimit); }
 
 static UInt32 Bt2_MatchFinder_GetMatches(CMatchFinder *p, UInt32 *distances)
 {
@@ -109,6 +109,37 @@ void MatchFinder_Init_LowHash(CMatchFinder *p);
 void MatchFinder_Init_HighHash(CMatchFinder *p);
 void MatchFinder_Init_3(CMatchFinder *p, int readData);
 void MatchFinder_Init(CMatchFinder *p);
+/* the hash table must be initialized by MatchFinder_Init() before */
+void MatchFinder_Init_Continue(CMatchFinder *p);
+
+/*
+Preset dictionary (prefix) for the stream mode (not directInput):
+  MatchFinder_Init_Prefix() starts a new stream after (prefixSize) bytes
+    that are already stored at the start of (bufferBase). It doesn't change
+    (hash) and (son), the caller must insert the prefix positions with Skip()
+    or MatchFinder_LoadPrefix() before the first GetMatches() call.
+  MatchFinder_GetPrefixNumRefs() returns the number of items that
+    MatchFinder_SavePrefix() writes: the hash table and the (son) items of
+    the first (numPos) positions.
+  MatchFinder_SavePrefix() must be called after (numPos) positions of
+    the prefix were inserted, MatchFinder_LoadPrefix() restores them in
+    the next stream and moves to the next position.
+  MatchFinder_UndoPrefix() can be called at the end of a stream instead of
+    loading the whole hash table: it restores the hash items of the positions
+    after the saved positions. It returns:
+      0 - the window was moved or the positions were normalized, the prefix
+          in (bufferBase) was overwritten in that case.
+      1 - the hash table is restored.
+      2 - the hash table and the (son) items of the saved positions are
+          restored (hash chain mode only).
+    MatchFinder_LoadPrefix() loads only the items that are not restored
+    for (undoResult).
+*/
+void MatchFinder_Init_Prefix(CMatchFinder *p, UInt32 prefixSize);
+size_t MatchFinder_GetPrefixNumRefs(const CMatchFinder *p, UInt32 numPos);
+void MatchFinder_SavePrefix(const CMatchFinder *p, CLzRef *refs, UInt32 numPos);
+void MatchFinder_LoadPrefix(CMatchFinder *p, const CLzRef *refs, UInt32 numPos, int undoResult);
+int MatchFinder_UndoPrefix(CMatchFinder *p, const CLzRef *refs, UInt32 numPos);
 
 UInt32 Bt3Zip_MatchFinder_GetMatches(CMatchFinder *p, UInt32 *distances);
 UInt32 Hc3Zip_MatchFinder_GetMatches(CMatchFinder *p, UInt32 *distances);
@@ -208,14 +208,119 @@ Out:
 */
 
 
+/*
+LzmaDec_CopyMatch() writes (len) bytes of a match to (dic + dicPos) with the
+same result as copying byte by byte from the distance (rep0) through the
+circular dictionary. The caller guarantees (dicPos + len <= dicBufSize), so
+no byte after the match is written: that part of the buffer still holds
+older history. A match that starts before the end of the buffer is split,
+unless the buffer is a ring (dicRing).
+
+Most bytes are copied in 32, 16 or 8 byte blocks. If the source is behind
+the destination by less than 8 bytes, the output repeats with that period,
+so after (period2 - period) single bytes it can be copied from the distance
+(period2), the smallest multiple of the period that is not less than 8.
+A period of 1 is written with memset().
+*/
+
+#define COPY_BLOCK_8(dest, src) { UInt64 _v_; memcpy(&_v_, (src), 8); memcpy((dest), &_v_, 8); }
+
+static void LzmaDec_CopyBytes(Byte *dest, ptrdiff_t src, SizeT len)
+{
+  if (len >= 8)
+  {
+    if (src < 0 && src > -8)
+    {
+      ptrdiff_t period2 = -src;
+      SizeT rem;
+      if (src == -1)
+      {
+        memset(dest, dest[-1], len);
+        return;
+      }
+      while (period2 < 8)
+        period2 -= src;
+      rem = (SizeT)(period2 + src);
+      len -= rem;
+      do
+      {
+        *dest = *(dest + src);
+        dest++;
+      }
+      while (--rem != 0);
+      src = -period2;
+    }
+
+    if (src <= -32 || src >= 32)
+      for (; len >= 32; len -= 32, dest += 32)
+        memcpy(dest, dest + src, 32);
+    if (src <= -16 || src >= 16)
+      for (; len >= 16; len -= 16, dest += 16)
+        memcpy(dest, dest + src, 16);
+    for (; len >= 8; len -= 8, dest += 8)
+      COPY_BLOCK_8(dest, dest + src);
+  }
+
+  for (; len != 0; len--, dest++)
+    *dest = *(dest + src);
+}
+
+static MY_FORCE_INLINE void LzmaDec_CopyMatch(Byte *dic, SizeT dicBufSize, SizeT dicPos, SizeT rep0, SizeT len, BoolInt dicRing)
+{
+  /* in a ring (dic - rep0) is mapped to the end of the buffer. The blocks of
+     LzmaDec_CopyBytes() must not overlap the aliased source, that is ahead
+     of (dic + dicPos) by (dicBufSize - rep0) */
+  if (dicPos < rep0 && !(dicRing && rep0 <= dicBufSize - 32))
+  {
+    /* the source starts in the end of the circular buffer */
+    SizeT pos = dicPos - rep0 + dicBufSize;
+    SizeT cur = dicBufSize - pos;
+    if (cur >= len)
+    {
+      LzmaDec_CopyBytes(dic + dicPos, (ptrdiff_t)(pos - dicPos), len);
+      return;
+    }
+    LzmaDec_CopyBytes(dic + dicPos, (ptrdiff_t)(pos - dicPos), cur);
+    dicPos += cur;
+    len -= cur;
+  }
+  LzmaDec_CopyBytes(dic + dicPos, -(ptrdiff_t)rep0, len);
+}
+
+
 #ifdef _LZMA_DEC_OPT
 
 int MY_FAST_CALL LZMA_DECODE_REAL(CLzmaDec *p, SizeT limit, const Byte *bufLimit);
 
+/* for LzmaDec_DecodeReal_3() of LzmaDecOpt.c */
+void MY_FAST_CALL LzmaDec_CopyMatch_3(Byte *dic, SizeT dicBufSize, SizeT dicPos, SizeT rep0, SizeT len, BoolInt dicRing);
+void MY_FAST_CALL LzmaDec_CopyMatch_3(Byte *dic, SizeT dicBufSize, SizeT dicPos, SizeT rep0, SizeT len, BoolInt dicRing)
+{
+  LzmaDec_CopyMatch(dic, dicBufSize, dicPos, rep0, len, dicRing);
+}
+
+/* the generic version is still used after LzmaDec_SetDecodeOpt(False) */
+#define LZMA_DECODE_GENERIC LzmaDec_DecodeReal_Generic
+
+static BoolInt g_LzmaDec_DecodeOpt = True;
+
+void LzmaDec_SetDecodeOpt(BoolInt useOpt)
+{
+  g_LzmaDec_DecodeOpt = useOpt;
+}
+
+#define LZMA_DECODE_SELECTED(p, limit, bufLimit) \
+  (g_LzmaDec_DecodeOpt ? LZMA_DECODE_REAL(p, limit, bufLimit) : LZMA_DECODE_GENERIC(p, limit, bufLimit))
+
 #else
 
+#define LZMA_DECODE_GENERIC LZMA_DECODE_REAL
+#define LZMA_DECODE_SELECTED LZMA_DECODE_REAL
+
+#endif
+
 static
-int MY_FAST_CALL LZMA_DECODE_REAL(CLzmaDec *p, SizeT limit, const Byte *bufLimit)
+int MY_FAST_CALL LZMA_DECODE_GENERIC(CLzmaDec *p, SizeT limit, const Byte *bufLimit)
 {
   CLzmaProb *probs = GET_PROBS;
   unsigned state = (unsigned)p->state;
@@ -528,7 +633,6 @@ int MY_FAST_CALL LZMA_DECODE_REAL(CLzmaDec *p, SizeT limit, const Byte *bufLimit
       {
         SizeT rem;
         unsigned curLen;
-        SizeT pos;
         
         if ((rem = limit - dicPos) == 0)
         {
@@ -537,31 +641,12 @@ int MY_FAST_CALL LZMA_DECODE_REAL(CLzmaDec *p, SizeT limit, const Byte *bufLimit
         }
         
         curLen = ((rem < len) ? (unsigned)rem : len);
-        pos = dicPos - rep0 + (dicPos < rep0 ? dicBufSize : 0);
 
         processedPos += (UInt32)curLen;
 
         len -= curLen;
-        if (curLen <= dicBufSize - pos)
-        {
-          Byte *dest = dic + dicPos;
-          ptrdiff_t src = (ptrdiff_t)pos - (ptrdiff_t)dicPos;
-          const Byte *lim = dest + curLen;
-          dicPos += (SizeT)curLen;
-          do
-            *(dest) = (Byte)*(dest + src);
-          while (++dest != lim);
-        }
-        else
-        {
-          do
-          {
-            dic[dicPos++] = dic[pos];
-            if (++pos == dicBufSize)
-              pos = 0;
-          }
-          while (--curLen != 0);
-        }
+        LzmaDec_CopyMatch(dic, dicBufSize, dicPos, rep0, curLen, p->dicRing);
+        dicPos += (SizeT)curLen;
       }
     }
   }
@@ -583,7 +668,6 @@ int MY_FAST_CALL LZMA_DECODE_REAL(CLzmaDec *p, SizeT limit, const Byte *bufLimit
 
   return SZ_OK;
 }
-#endif
 
 static void MY_FAST_CALL LzmaDec_WriteRem(CLzmaDec *p, SizeT limit)
 {
@@ -603,13 +687,8 @@ static void MY_FAST_CALL LzmaDec_WriteRem(CLzmaDec *p, SizeT limit)
 
     p->processedPos += (UInt32)len;
     p->remainLen -= (UInt32)len;
-    while (len != 0)
-    {
-      len--;
-      dic[dicPos] = dic[dicPos - rep0 + (dicPos < rep0 ? dicBufSize : 0)];
-      dicPos++;
-    }
-    p->dicPos = dicPos;
+    LzmaDec_CopyMatch(dic, dicBufSize, dicPos, rep0, len, p->dicRing);
+    p->dicPos = dicPos + len;
   }
 }
 
@@ -637,7 +716,7 @@ static int MY_FAST_CALL LzmaDec_DecodeReal2(CLzmaDec *p, SizeT limit, const Byte
           return SZ_ERROR_DATA;
     }
 
-    RINOK(LZMA_DECODE_REAL(p, limit2, bufLimit));
+    RINOK(LZMA_DECODE_SELECTED(p, limit2, bufLimit));
     
     if (p->checkDicSize == 0 && p->processedPos >= p->prop.dicSize)
       p->checkDicSize = p->prop.dicSize;
@@ -871,6 +950,47 @@ void LzmaDec_Init(CLzmaDec *p)
   LzmaDec_InitDicAndState(p, True, True);
 }
 
+SRes LzmaDec_InitPreset(CLzmaDec *p, const Byte *dict, SizeT dictSize, const UInt16 *probs)
+{
+  SizeT numProbs = LzmaProps_GetNumProbs(&p->prop);
+  CLzmaProb *dest = p->probs;
+  SizeT i;
+
+  if (dictSize > p->dicBufSize || dictSize > (UInt32)0xFFFFFFFF)
+    return SZ_ERROR_PARAM;
+
+  /* the state is initialized here, so LzmaDec_DecodeToDic() only initializes the range decoder */
+  if (probs)
+  {
+    UInt32 wrong = 0;
+    for (i = 0; i < numProbs; i++)
+    {
+      UInt32 v = probs[i];
+      dest[i] = (CLzmaProb)v;
+      /* (v == 0 || v >= kBitModelTotal) */
+      wrong |= (v - 1) >> kNumBitModelTotalBits;
+    }
+    if (wrong)
+      return SZ_ERROR_PARAM;
+  }
+  else
+    for (i = 0; i < numProbs; i++)
+      dest[i] = kBitModelTotal >> 1;
+
+  if (dict && dict != p->dic)
+    memcpy(p->dic, dict, dictSize);
+  p->dicPos = dictSize;
+  LzmaDec_InitDicAndState(p, True, True);
+  p->processedPos = (UInt32)dictSize;
+  if (dictSize >= p->prop.dicSize)
+    p->checkDicSize = p->prop.dicSize;
+
+  p->reps[0] = p->reps[1] = p->reps[2] = p->reps[3] = 1;
+  p->state = 0;
+  p->remainLen = kMatchSpecLenStart + 1;
+  return SZ_OK;
+}
+
 
 SRes LzmaDec_DecodeToDic(CLzmaDec *p, SizeT dicLimit, const Byte *src, SizeT *srcLen,
     ELzmaFinishMode finishMode, ELzmaStatus *status)
@@ -1153,6 +1273,7 @@ SRes LzmaDec_Allocate(CLzmaDec *p, const Byte *props, unsigned propsSize, ISzAll
       LzmaDec_FreeProbs(p, alloc);
       return SZ_ERROR_MEM;
     }
+    p->dicRing = False;
   }
   p->dicBufSize = dicBufSize;
   p->prop = propNew;
@@ -71,12 +71,32 @@ typedef struct
   UInt32 numProbs;
   unsigned tempBufSize;
   Byte tempBuf[LZMA_REQUIRED_INPUT_MAX];
+
+  BoolInt dicRing; /* (dic) is from RingAlloc(): (dic[i - dicBufSize] == dic[i]) */
 } CLzmaDec;
 
-#define LzmaDec_Construct(p) { (p)->dic = NULL; (p)->probs = NULL; }
+#define LzmaDec_Construct(p) { (p)->dic = NULL; (p)->probs = NULL; (p)->dicRing = False; }
 
 void LzmaDec_Init(CLzmaDec *p);
 
+/*
+LzmaDec_InitPreset() can be used instead of LzmaDec_Init() for a stream that
+  was encoded with a preset dictionary (LzmaEnc_SetPresetDict()). The stream
+  continues after the (dictSize) bytes of the dictionary that are stored at the
+  start of (p->dic), so decoding starts at (p->dicPos = dictSize).
+  If (dict) is NULL, (p->dic) must contain the dictionary already. So the
+  dictionary is copied only once, if the following streams don't overwrite it
+  (they fit into (p->dicBufSize) after the dictionary).
+  (probs) can be NULL or the initial probabilities of the encoder
+  (LzmaEnc_SetPresetProbs()): (p->numProbs) items in the layout of (p->probs).
+
+Returns:
+  SZ_OK
+  SZ_ERROR_PARAM - (dictSize > p->dicBufSize) or incorrect probabilities
+*/
+
+SRes LzmaDec_InitPreset(CLzmaDec *p, const Byte *dict, SizeT dictSize, const UInt16 *probs);
+
 /* There are two types of LZMA streams:
      - Stream with end mark. That end mark adds about 6 bytes to compressed size.
      - Stream without end mark. You must know exact uncompressed size to decompress such stream. */
@@ -130,6 +150,14 @@ typedef enum
    You can use variant 2, if you set dictionary buffer manually.
    For Buffer Interface you must always use variant 1.
 
+   With variant 2 the dictionary can be a buffer of RingAlloc() (Alloc.h) that
+   is mapped twice. Set (dic), (dicBufSize) to the size returned by RingAlloc()
+   and (dicRing = True). The decoder then copies matches across the end of the
+   buffer without splitting them, and the last (n <= dicBufSize) decoded bytes
+   are always contiguous at (dic + dicPos - n), also after (dicPos) was reset
+   to 0. So the caller can read records that cross the end of the buffer
+   without copying them.
+
 LzmaDec_Allocate* can return:
   SZ_OK
   SZ_ERROR_MEM         - Memory allocation error
@@ -142,6 +170,19 @@ void LzmaDec_FreeProbs(CLzmaDec *p, ISzAllocPtr alloc);
 SRes LzmaDec_Allocate(CLzmaDec *p, const Byte *props, unsigned propsSize, ISzAllocPtr alloc);
 void LzmaDec_Free(CLzmaDec *p, ISzAllocPtr alloc);
 
+#ifdef _LZMA_DEC_OPT
+
+/*
+LzmaDec_SetDecodeOpt() selects the main decoding loop of all decoders:
+  True  - LzmaDec_DecodeReal_3() of LzmaDecOpt.c or Asm/x86/LzmaDecOpt.asm (default)
+  False - the generic C loop of LzmaDec.c
+It's for tests and benchmarks, don't call it while another thread decodes.
+*/
+
+void LzmaDec_SetDecodeOpt(BoolInt useOpt);
+
+#endif
+
 /* ---------- Dictionary Interface ---------- */
 
 /* You can use it, if you want to eliminate the overhead for data copying from
@@ -0,0 +1,453 @@
+/* LzmaDecOpt.c -- C version of LzmaDec_DecodeReal_3() function
+2019-12-02 : Public domain */
+
+/*
+It's the portable counterpart of Asm/x86/LzmaDecOpt.asm for the compilers
+and ABIs that can't build that file (GCC / Clang). Link only one of them.
+It's used by LzmaDec.c, if _LZMA_DEC_OPT is defined.
+
+Like the ASM version, it decodes the bits of the literal, length, pos slot
+and align trees without branches: both results of a bit are computed and
+selected with a mask, and the probabilities of both child nodes are loaded
+before the bit is known. Only the IsMatch / IsRep / LenChoice decisions
+are branches. So it's faster for data with unpredictable literals.
+
+CLzmaDec structure, (probs) array layout, input and output of
+LzmaDec_DecodeReal_*() must be equal in both versions (LzmaDec.c / this file).
+*/
+
+#include "Precomp.h"
+
+#include "LzmaDec.h"
+
+#ifdef _LZMA_DEC_OPT
+
+#define kNumTopBits 24
+#define kTopValue ((UInt32)1 << kNumTopBits)
+
+#define kNumBitModelTotalBits 11
+#define kBitModelTotal (1 << kNumBitModelTotalBits)
+#define kNumMoveBits 5
+
+#define NORMALIZE if (range < kTopValue) { range <<= 8; code = (code << 8) | (*buf++); }
+
+#define IF_BIT_0(p) ttt = *(p); NORMALIZE; bound = (range >> kNumBitModelTotalBits) * (UInt32)ttt; if (code < bound)
+#define UPDATE_0(p) range = bound; *(p) = (CLzmaProb)(ttt + ((kBitModelTotal - ttt) >> kNumMoveBits));
+#define UPDATE_1(p) range -= bound; code -= bound; *(p) = (CLzmaProb)(ttt - (ttt >> kNumMoveBits));
+
+/*
+CMOV_BIT() decodes the bit of probability (ttt) at (p) without branches:
+  (mask == 0) for bit 0, (mask == 0xFFFFFFFF) for bit 1.
+*/
+
+#define CMOV_BIT(p) \
+  NORMALIZE; \
+  bound = (range >> kNumBitModelTotalBits) * (UInt32)ttt; \
+  mask = (UInt32)0 - (UInt32)(code >= bound); \
+  range = bound + ((range - bound - bound) & mask); \
+  code -= bound & mask; \
+  *(p) = (CLzmaProb)(ttt - ((ttt >> kNumMoveBits) & mask) \
+      + (((kBitModelTotal - ttt) >> kNumMoveBits) & ~mask));
+
+/* decodes the bit of node (i) and loads the probability of the next node to (ttt) */
+#define TREE_BIT_NEXT(probs, i) \
+  { unsigned t0 = (probs)[(size_t)(i) * 2]; \
+    unsigned t1 = (probs)[(size_t)(i) * 2 + 1]; \
+    CMOV_BIT((probs) + (i)) \
+    i = (i + i) - mask; \
+    ttt = (t0 & ~mask) | (t1 & mask); }
+
+#define TREE_BIT_LAST(probs, i) \
+  { CMOV_BIT((probs) + (i)) \
+    i = (i + i) - mask; }
+
+/* REV_BIT_VAR / REV_BIT_CONST / REV_BIT_LAST of LzmaDec.c */
+#define REV_BIT_VAR(probs, i, m) \
+  { ttt = (probs)[i]; CMOV_BIT((probs) + (i)) i += m + (m & mask); m += m; }
+#define REV_BIT_CONST(probs, i, m) \
+  { ttt = (probs)[i]; CMOV_BIT((probs) + (i)) i += m + (m & mask); }
+#define REV_BIT_LAST(probs, i, m) \
+  { ttt = (probs)[i]; CMOV_BIT((probs) + (i)) i -= m & ~mask; }
+
+#define MATCHED_LITER_DEC \
+  matchByte += matchByte; \
+  bit = offs; \
+  offs &= matchByte; \
+  probLit = prob + (offs + bit + symbol); \
+  ttt = *probLit; \
+  CMOV_BIT(probLit) \
+  symbol = (symbol + symbol) - mask; \
+  offs ^= bit & ~mask;
+
+
+#define kNumPosBitsMax 4
+#define kNumPosStatesMax (1 << kNumPosBitsMax)
+
+#define kLenNumLowBits 3
+#define kLenNumLowSymbols (1 << kLenNumLowBits)
+#define kLenNumHighBits 8
+#define kLenNumHighSymbols (1 << kLenNumHighBits)
+
+#define LenLow 0
+#define LenHigh (LenLow + 2 * (kNumPosStatesMax << kLenNumLowBits))
+#define kNumLenProbs (LenHigh + kLenNumHighSymbols)
+
+#define LenChoice LenLow
+#define LenChoice2 (LenLow + (1 << kLenNumLowBits))
+
+#define kNumStates 12
+#define kNumStates2 16
+#define kNumLitStates 7
+
+#define kStartPosModelIndex 4
+#define kEndPosModelIndex 14
+#define kNumFullDistances (1 << (kEndPosModelIndex >> 1))
+
+#define kNumPosSlotBits 6
+#define kNumLenToPosStates 4
+
+#define kNumAlignBits 4
+#define kAlignTableSize (1 << kNumAlignBits)
+
+#define kMatchMinLen 2
+#define kMatchSpecLenStart (kMatchMinLen + kLenNumLowSymbols * 2 + kLenNumHighSymbols)
+
+#define kStartOffset 1664
+#define GET_PROBS p->probs_1664
+
+#define SpecPos (-kStartOffset)
+#define IsRep0Long (SpecPos + kNumFullDistances)
+#define RepLenCoder (IsRep0Long + (kNumStates2 << kNumPosBitsMax))
+#define LenCoder (RepLenCoder + kNumLenProbs)
+#define IsMatch (LenCoder + kNumLenProbs)
+#define Align (IsMatch + (kNumStates2 << kNumPosBitsMax))
+#define IsRep (Align + kAlignTableSize)
+#define IsRepG0 (IsRep + kNumStates)
+#define IsRepG1 (IsRepG0 + kNumStates)
+#define IsRepG2 (IsRepG1 + kNumStates)
+#define PosSlot (IsRepG2 + kNumStates)
+#define Literal (PosSlot + (kNumLenToPosStates << kNumPosSlotBits))
+#define NUM_BASE_PROBS (Literal + kStartOffset)
+
+#if Align != 0 && kStartOffset != 0
+  #error Stop_Compiling_Bad_LZMA_kAlign
+#endif
+
+#if NUM_BASE_PROBS != 1984
+  #error Stop_Compiling_Bad_LZMA_PROBS
+#endif
+
+#define CALC_POS_STATE(processedPos, pbMask) (((processedPos) & (pbMask)) << 4)
+#define COMBINED_PS_STATE (posState + state)
+#define GET_LEN_STATE (posState)
+
+/* LzmaDec.c */
+void MY_FAST_CALL LzmaDec_CopyMatch_3(Byte *dic, SizeT dicBufSize, SizeT dicPos, SizeT rep0, SizeT len, BoolInt dicRing);
+
+int MY_FAST_CALL LzmaDec_DecodeReal_3(CLzmaDec *p, SizeT limit, const Byte *bufLimit);
+
+int MY_FAST_CALL LzmaDec_DecodeReal_3(CLzmaDec *p, SizeT limit, const Byte *bufLimit)
+{
+  CLzmaProb *probs = GET_PROBS;
+  unsigned state = (unsigned)p->state;
+  UInt32 rep0 = p->reps[0], rep1 = p->reps[1], rep2 = p->reps[2], rep3 = p->reps[3];
+  unsigned pbMask = ((unsigned)1 << (p->prop.pb)) - 1;
+  unsigned lc = p->prop.lc;
+  unsigned lpMask = ((unsigned)0x100 << p->prop.lp) - ((unsigned)0x100 >> lc);
+
+  Byte *dic = p->dic;
+  SizeT dicBufSize = p->dicBufSize;
+  SizeT dicPos = p->dicPos;
+
+  UInt32 processedPos = p->processedPos;
+  UInt32 checkDicSize = p->checkDicSize;
+  unsigned len = 0;
+
+  const Byte *buf = p->buf;
+  UInt32 range = p->range;
+  UInt32 code = p->code;
+
+  do
+  {
+    CLzmaProb *prob;
+    UInt32 bound;
+    UInt32 mask;
+    unsigned ttt;
+    unsigned posState = CALC_POS_STATE(processedPos, pbMask);
+
+    prob = probs + IsMatch + COMBINED_PS_STATE;
+    IF_BIT_0(prob)
+    {
+      unsigned symbol;
+      UPDATE_0(prob);
+      prob = probs + Literal;
+      if (processedPos != 0 || checkDicSize != 0)
+        prob += (UInt32)3 * ((((processedPos << 8) + dic[(dicPos == 0 ? dicBufSize : dicPos) - 1]) & lpMask) << lc);
+      processedPos++;
+
+      symbol = 1;
+      if (state < kNumLitStates)
+      {
+        state -= (state < 4) ? state : 3;
+        ttt = prob[1];
+        TREE_BIT_NEXT(prob, symbol);
+        TREE_BIT_NEXT(prob, symbol);
+        TREE_BIT_NEXT(prob, symbol);
+        TREE_BIT_NEXT(prob, symbol);
+        TREE_BIT_NEXT(prob, symbol);
+        TREE_BIT_NEXT(prob, symbol);
+        TREE_BIT_NEXT(prob, symbol);
+        TREE_BIT_LAST(prob, symbol);
+      }
+      else
+      {
+        unsigned matchByte = dic[dicPos - rep0 + (dicPos < rep0 ? dicBufSize : 0)];
+        unsigned offs = 0x100;
+        unsigned bit;
+        CLzmaProb *probLit;
+        state -= (state < 10) ? 3 : 6;
+        MATCHED_LITER_DEC
+        MATCHED_LITER_DEC
+        MATCHED_LITER_DEC
+        MATCHED_LITER_DEC
+        MATCHED_LITER_DEC
+        MATCHED_LITER_DEC
+        MATCHED_LITER_DEC
+        MATCHED_LITER_DEC
+      }
+
+      dic[dicPos++] = (Byte)symbol;
+      continue;
+    }
+
+    {
+      UPDATE_1(prob);
+      prob = probs + IsRep + state;
+      IF_BIT_0(prob)
+      {
+        UPDATE_0(prob);
+        state += kNumStates;
+        prob = probs + LenCoder;
+      }
+      else
+      {
+        UPDATE_1(prob);
+        /* the (checkDicSize == 0 && processedPos == 0) case was checked before with kBadRepCode */
+        prob = probs + IsRepG0 + state;
+        IF_BIT_0(prob)
+        {
+          UPDATE_0(prob);
+          prob = probs + IsRep0Long + COMBINED_PS_STATE;
+          IF_BIT_0(prob)
+          {
+            UPDATE_0(prob);
+            dic[dicPos] = dic[dicPos - rep0 + (dicPos < rep0 ? dicBufSize : 0)];
+            dicPos++;
+            processedPos++;
+            state = state < kNumLitStates ? 9 : 11;
+            continue;
+          }
+          UPDATE_1(prob);
+        }
+        else
+        {
+          UInt32 distance;
+          UPDATE_1(prob);
+          prob = probs + IsRepG1 + state;
+          IF_BIT_0(prob)
+          {
+            UPDATE_0(prob);
+            distance = rep1;
+          }
+          else
+          {
+            UPDATE_1(prob);
+            prob = probs + IsRepG2 + state;
+            IF_BIT_0(prob)
+            {
+              UPDATE_0(prob);
+              distance = rep2;
+            }
+            else
+            {
+              UPDATE_1(prob);
+              distance = rep3;
+              rep3 = rep2;
+            }
+            rep2 = rep1;
+          }
+          rep1 = rep0;
+          rep0 = distance;
+        }
+        state = state < kNumLitStates ? 8 : 11;
+        prob = probs + RepLenCoder;
+      }
+
+      {
+        CLzmaProb *probLen = prob + LenChoice;
+        IF_BIT_0(probLen)
+        {
+          UPDATE_0(probLen);
+          probLen = prob + LenLow + GET_LEN_STATE;
+          len = 1;
+          ttt = probLen[1];
+          TREE_BIT_NEXT(probLen, len);
+          TREE_BIT_NEXT(probLen, len);
+          TREE_BIT_LAST(probLen, len);
+          len -= 8;
+        }
+        else
+        {
+          UPDATE_1(probLen);
+          probLen = prob + LenChoice2;
+          IF_BIT_0(probLen)
+          {
+            UPDATE_0(probLen);
+            probLen = prob + LenLow + GET_LEN_STATE + (1 << kLenNumLowBits);
+            len = 1;
+            ttt = probLen[1];
+            TREE_BIT_NEXT(probLen, len);
+            TREE_BIT_NEXT(probLen, len);
+            TREE_BIT_LAST(probLen, len);
+          }
+          else
+          {
+            UPDATE_1(probLen);
+            probLen = prob + LenHigh;
+            len = 1;
+            ttt = probLen[1];
+            TREE_BIT_NEXT(probLen, len);
+            TREE_BIT_NEXT(probLen, len);
+            TREE_BIT_NEXT(probLen, len);
+            TREE_BIT_NEXT(probLen, len);
+            TREE_BIT_NEXT(probLen, len);
+            TREE_BIT_NEXT(probLen, len);
+            TREE_BIT_NEXT(probLen, len);
+            TREE_BIT_LAST(probLen, len);
+            len -= (1 << kLenNumHighBits) - kLenNumLowSymbols * 2;
+          }
+        }
+      }
+
+      if (state >= kNumStates)
+      {
+        UInt32 distance;
+        prob = probs + PosSlot +
+            ((len < kNumLenToPosStates ? len : kNumLenToPosStates - 1) << kNumPosSlotBits);
+        distance = 1;
+        ttt = prob[1];
+        TREE_BIT_NEXT(prob, distance);
+        TREE_BIT_NEXT(prob, distance);
+        TREE_BIT_NEXT(prob, distance);
+        TREE_BIT_NEXT(prob, distance);
+        TREE_BIT_NEXT(prob, distance);
+        TREE_BIT_LAST(prob, distance);
+        distance -= 0x40;
+        if (distance >= kStartPosModelIndex)
+        {
+          unsigned posSlot = (unsigned)distance;
+          unsigned numDirectBits = (unsigned)(((distance >> 1) - 1));
+          distance = (2 | (distance & 1));
+          if (posSlot < kEndPosModelIndex)
+          {
+            distance <<= numDirectBits;
+            prob = probs + SpecPos;
+            {
+              UInt32 m = 1;
+              distance++;
+              do
+              {
+                REV_BIT_VAR(prob, distance, m);
+              }
+              while (--numDirectBits);
+              distance -= m;
+            }
+          }
+          else
+          {
+            numDirectBits -= kNumAlignBits;
+            do
+            {
+              NORMALIZE
+              range >>= 1;
+
+              {
+                UInt32 t;
+                code -= range;
+                t = (0 - ((UInt32)code >> 31)); /* (UInt32)((Int32)code >> 31) */
+                distance = (distance << 1) + (t + 1);
+                code += range & t;
+              }
+            }
+            while (--numDirectBits);
+            prob = probs + Align;
+            distance <<= kNumAlignBits;
+            {
+              unsigned i = 1;
+              REV_BIT_CONST(prob, i, 1);
+              REV_BIT_CONST(prob, i, 2);
+              REV_BIT_CONST(prob, i, 4);
+              REV_BIT_LAST (prob, i, 8);
+              distance |= i;
+            }
+            if (distance == (UInt32)0xFFFFFFFF)
+            {
+              len = kMatchSpecLenStart;
+              state -= kNumStates;
+              break;
+            }
+          }
+        }
+
+        rep3 = rep2;
+        rep2 = rep1;
+        rep1 = rep0;
+        rep0 = distance + 1;
+        state = (state < kNumStates + kNumLitStates) ? kNumLitStates : kNumLitStates + 3;
+        if (distance >= (checkDicSize == 0 ? processedPos: checkDicSize))
+        {
+          p->dicPos = dicPos;
+          return SZ_ERROR_DATA;
+        }
+      }
+
+      len += kMatchMinLen;
+
+      {
+        SizeT rem;
+        unsigned curLen;
+
+        if ((rem = limit - dicPos) == 0)
+        {
+          p->dicPos = dicPos;
+          return SZ_ERROR_DATA;
+        }
+
+        curLen = ((rem < len) ? (unsigned)rem : len);
+        processedPos += (UInt32)curLen;
+        len -= curLen;
+        LzmaDec_CopyMatch_3(dic, dicBufSize, dicPos, rep0, curLen, p->dicRing);
+        dicPos += (SizeT)curLen;
+      }
+    }
+  }
+  while (dicPos < limit && buf < bufLimit);
+
+  NORMALIZE;
+
+  p->buf = buf;
+  p->range = range;
+  p->code = code;
+  p->remainLen = (UInt32)len;
+  p->dicPos = dicPos;
+  p->processedPos = processedPos;
+  p->reps[0] = rep0;
+  p->reps[1] = rep1;
+  p->reps[2] = rep2;
+  p->reps[3] = rep3;
+  p->state = (UInt32)state;
+
+  return SZ_OK;
+}
+
+#endif
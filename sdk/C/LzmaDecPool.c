@@ -0,0 +1,322 @@
+/* LzmaDecPool.c -- Decoder for batches of small LZMA streams
+2019-12-02 : Public domain */
+
+#include "Precomp.h"
+
+#include "LzmaDecPool.h"
+
+#ifndef _7ZIP_ST
+#include "Threads.h"
+#endif
+
+#define RC_INIT_SIZE 5
+
+/* (lc + lp) <= 8 + 4 for the properties that LzmaProps_Decode() accepts */
+#define LZMA_DEC_POOL_NUM_DECODERS (8 + 4 + 1)
+
+/* the number of jobs that a thread takes at once */
+#define LZMA_DEC_POOL_JOBS_STEP 8
+
+#ifdef _7ZIP_ST
+#define LZMA_DEC_POOL_NUM_THREADS 1
+#else
+#define LZMA_DEC_POOL_NUM_THREADS LZMA_DEC_POOL_THREADS_MAX
+#endif
+
+struct CLzmaDecPool_;
+
+typedef struct
+{
+  CLzmaDec decoders[LZMA_DEC_POOL_NUM_DECODERS];
+  CLzmaDecPoolStats stats;
+
+  #ifndef _7ZIP_ST
+  struct CLzmaDecPool_ *pool;
+  BoolInt stop;
+  CThread thread;
+  CAutoResetEvent startEvent;
+  CAutoResetEvent finishedEvent;
+  #endif
+} CLzmaDecPoolThread;
+
+typedef struct CLzmaDecPool_
+{
+  ISzAllocPtr alloc;
+  unsigned numThreadsMax;
+  CLzmaDecPoolThread threads[LZMA_DEC_POOL_NUM_THREADS];
+
+  CLzmaDecJob *jobs;
+  size_t numJobs;
+  size_t nextJob;
+  ELzmaFinishMode finishMode;
+
+  #ifndef _7ZIP_ST
+  unsigned numCreatedThreads;
+  unsigned numRunThreads;
+  CCriticalSection cs;
+  #endif
+} CLzmaDecPool;
+
+
+static void LzmaDecPool_DecodeJob(CLzmaDecPoolThread *t, ISzAllocPtr alloc,
+    CLzmaDecJob *job, ELzmaFinishMode finishMode)
+{
+  CLzmaProps props;
+  SizeT inSize = job->srcLen;
+  SRes res;
+
+  job->srcProcessed = 0;
+  job->destProcessed = 0;
+  job->status = LZMA_STATUS_NOT_SPECIFIED;
+
+  res = LzmaProps_Decode(&props, job->props, LZMA_PROPS_SIZE);
+  if (res == SZ_OK && inSize < RC_INIT_SIZE)
+    res = SZ_ERROR_INPUT_EOF;
+  if (res == SZ_OK)
+  {
+    CLzmaDec *dec = &t->decoders[(unsigned)props.lc + props.lp];
+    if (!dec->probs)
+      t->stats.numAllocs++;
+    res = LzmaDec_AllocateProbs(dec, job->props, LZMA_PROPS_SIZE, alloc);
+    if (res == SZ_OK)
+    {
+      dec->dic = job->dest;
+      dec->dicBufSize = job->destLen;
+      LzmaDec_Init(dec);
+      res = LzmaDec_DecodeToDic(dec, job->destLen, job->src, &inSize, finishMode, &job->status);
+      job->srcProcessed = inSize;
+      job->destProcessed = dec->dicPos;
+      if (res == SZ_OK && job->status == LZMA_STATUS_NEEDS_MORE_INPUT)
+        res = SZ_ERROR_INPUT_EOF;
+      /* (dic) belongs to the job */
+      dec->dic = NULL;
+    }
+  }
+
+  job->res = res;
+  t->stats.inSize += job->srcProcessed;
+  t->stats.outSize += job->destProcessed;
+  if (res != SZ_OK)
+    t->stats.numErrors++;
+}
+
+
+static void LzmaDecPool_Work(CLzmaDecPool *p, CLzmaDecPoolThread *t)
+{
+  for (;;)
+  {
+    size_t i, lim;
+
+    #ifndef _7ZIP_ST
+    if (p->numRunThreads > 1)
+    {
+      CriticalSection_Enter(&p->cs);
+      i = p->nextJob;
+      lim = p->numJobs;
+      if (lim - i > LZMA_DEC_POOL_JOBS_STEP)
+        lim = i + LZMA_DEC_POOL_JOBS_STEP;
+      p->nextJob = lim;
+      CriticalSection_Leave(&p->cs);
+    }
+    else
+    #endif
+    {
+      i = p->nextJob;
+      lim = p->numJobs;
+      p->nextJob = lim;
+    }
+
+    if (i == lim)
+      return;
+    for (; i < lim; i++)
+      LzmaDecPool_DecodeJob(t, p->alloc, &p->jobs[i], p->finishMode);
+  }
+}
+
+
+#ifndef _7ZIP_ST
+
+static THREAD_FUNC_RET_TYPE THREAD_FUNC_CALL_TYPE LzmaDecPool_ThreadFunc(void *pp)
+{
+  CLzmaDecPoolThread *t = (CLzmaDecPoolThread *)pp;
+  for (;;)
+  {
+    if (Event_Wait(&t->startEvent) != 0)
+      return SZ_ERROR_THREAD;
+    if (t->stop)
+      return 0;
+    LzmaDecPool_Work(t->pool, t);
+    if (Event_Set(&t->finishedEvent) != 0)
+      return SZ_ERROR_THREAD;
+  }
+}
+
+
+static WRes LzmaDecPoolThread_Create(CLzmaDecPoolThread *t)
+{
+  WRes wres = AutoResetEvent_CreateNotSignaled(&t->startEvent);
+  if (wres == 0)
+    wres = AutoResetEvent_CreateNotSignaled(&t->finishedEvent);
+  if (wres == 0)
+  {
+    t->stop = False;
+    wres = Thread_Create(&t->thread, LzmaDecPool_ThreadFunc, t);
+  }
+  return wres;
+}
+
+
+static void LzmaDecPoolThread_Destruct(CLzmaDecPoolThread *t)
+{
+  if (Thread_WasCreated(&t->thread))
+  {
+    t->stop = True;
+    Event_Set(&t->startEvent);
+    Thread_Wait(&t->thread);
+    Thread_Close(&t->thread);
+  }
+  Event_Close(&t->startEvent);
+  Event_Close(&t->finishedEvent);
+}
+
+#endif
+
+
+CLzmaDecPoolHandle LzmaDecPool_Create(ISzAllocPtr alloc, unsigned numThreads)
+{
+  CLzmaDecPool *p = (CLzmaDecPool *)ISzAlloc_Alloc(alloc, sizeof(CLzmaDecPool));
+  unsigned i;
+  if (!p)
+    return NULL;
+
+  p->alloc = alloc;
+  #ifdef _7ZIP_ST
+  UNUSED_VAR(numThreads);
+  p->numThreadsMax = 1;
+  #else
+  if (numThreads < 1)
+    numThreads = 1;
+  if (numThreads > LZMA_DEC_POOL_THREADS_MAX)
+    numThreads = LZMA_DEC_POOL_THREADS_MAX;
+  p->numThreadsMax = numThreads;
+  p->numCreatedThreads = 1;
+  p->numRunThreads = 1;
+  if (numThreads > 1 && CriticalSection_Init(&p->cs) != 0)
+    p->numThreadsMax = 1;
+  #endif
+
+  for (i = 0; i < LZMA_DEC_POOL_NUM_THREADS; i++)
+  {
+    CLzmaDecPoolThread *t = &p->threads[i];
+    unsigned k;
+    for (k = 0; k < LZMA_DEC_POOL_NUM_DECODERS; k++)
+      LzmaDec_Construct(&t->decoders[k]);
+    #ifndef _7ZIP_ST
+    t->pool = p;
+    t->stop = False;
+    Thread_Construct(&t->thread);
+    Event_Construct(&t->startEvent);
+    Event_Construct(&t->finishedEvent);
+    #endif
+  }
+  return p;
+}
+
+
+void LzmaDecPool_Destroy(CLzmaDecPoolHandle pp)
+{
+  CLzmaDecPool *p = (CLzmaDecPool *)pp;
+  unsigned i;
+
+  for (i = 0; i < LZMA_DEC_POOL_NUM_THREADS; i++)
+  {
+    CLzmaDecPoolThread *t = &p->threads[i];
+    unsigned k;
+    #ifndef _7ZIP_ST
+    LzmaDecPoolThread_Destruct(t);
+    #endif
+    for (k = 0; k < LZMA_DEC_POOL_NUM_DECODERS; k++)
+      LzmaDec_FreeProbs(&t->decoders[k], p->alloc);
+  }
+
+  #ifndef _7ZIP_ST
+  if (p->numThreadsMax > 1)
+    CriticalSection_Delete(&p->cs);
+  #endif
+
+  ISzAlloc_Free(p->alloc, p);
+}
+
+
+SRes LzmaDecPool_Decode(CLzmaDecPoolHandle pp, CLzmaDecJob *jobs, size_t numJobs,
+    ELzmaFinishMode finishMode, CLzmaDecPoolStats *stats)
+{
+  CLzmaDecPool *p = (CLzmaDecPool *)pp;
+  unsigned numThreads = 1;
+  unsigned i;
+
+  p->jobs = jobs;
+  p->numJobs = numJobs;
+  p->nextJob = 0;
+  p->finishMode = finishMode;
+
+  #ifndef _7ZIP_ST
+  {
+    /* other threads get at least two steps of jobs */
+    size_t numSteps = numJobs / (LZMA_DEC_POOL_JOBS_STEP * 2);
+    numThreads = p->numThreadsMax;
+    if (numThreads > numSteps)
+      numThreads = (numSteps == 0 ? 1 : (unsigned)numSteps);
+    for (; p->numCreatedThreads < numThreads; p->numCreatedThreads++)
+      if (LzmaDecPoolThread_Create(&p->threads[p->numCreatedThreads]) != 0)
+      {
+        LzmaDecPoolThread_Destruct(&p->threads[p->numCreatedThreads]);
+        return SZ_ERROR_THREAD;
+      }
+  }
+  p->numRunThreads = numThreads;
+  #endif
+
+  for (i = 0; i < numThreads; i++)
+  {
+    CLzmaDecPoolStats *s = &p->threads[i].stats;
+    s->inSize = 0;
+    s->outSize = 0;
+    s->numErrors = 0;
+    s->numAllocs = 0;
+  }
+
+  #ifndef _7ZIP_ST
+  {
+    /* if a thread could not be started, the other threads decode its jobs */
+    unsigned numStarted = 1;
+    for (i = 1; i < numThreads; i++, numStarted++)
+      if (Event_Set(&p->threads[i].startEvent) != 0)
+        break;
+    LzmaDecPool_Work(p, &p->threads[0]);
+    for (i = 1; i < numStarted; i++)
+      Event_Wait(&p->threads[i].finishedEvent);
+    numThreads = numStarted;
+  }
+  #else
+  LzmaDecPool_Work(p, &p->threads[0]);
+  #endif
+
+  if (stats)
+  {
+    stats->inSize = 0;
+    stats->outSize = 0;
+    stats->numErrors = 0;
+    stats->numAllocs = 0;
+    stats->numThreads = numThreads;
+    for (i = 0; i < numThreads; i++)
+    {
+      const CLzmaDecPoolStats *s = &p->threads[i].stats;
+      stats->inSize += s->inSize;
+      stats->outSize += s->outSize;
+      stats->numErrors += s->numErrors;
+      stats->numAllocs += s->numAllocs;
+    }
+  }
+  return SZ_OK;
+}
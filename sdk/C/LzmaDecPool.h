@@ -0,0 +1,77 @@
+/* LzmaDecPool.h -- Decoder for batches of small LZMA streams
+2019-12-02 : Public domain */
+
+#ifndef __LZMA_DEC_POOL_H
+#define __LZMA_DEC_POOL_H
+
+#include "LzmaDec.h"
+
+EXTERN_C_BEGIN
+
+#define LZMA_DEC_POOL_THREADS_MAX 64
+
+/* one LZMA stream of a batch, like the arguments of LzmaDecode() */
+
+typedef struct
+{
+  /* in: */
+  const Byte *props;      /* LZMA_PROPS_SIZE bytes */
+  const Byte *src;
+  SizeT srcLen;
+  Byte *dest;             /* it's also the dictionary of the decoder */
+  SizeT destLen;
+
+  /* out: */
+  SizeT srcProcessed;
+  SizeT destProcessed;
+  ELzmaStatus status;
+  SRes res;               /* the result of LzmaDecode() for this stream */
+} CLzmaDecJob;
+
+typedef struct
+{
+  UInt64 inSize;          /* (srcProcessed) of all jobs */
+  UInt64 outSize;         /* (destProcessed) of all jobs */
+  size_t numErrors;       /* jobs with (res != SZ_OK) */
+  UInt32 numAllocs;       /* probs arrays that were allocated for this batch */
+  unsigned numThreads;    /* threads that decoded this batch */
+} CLzmaDecPoolStats;
+
+
+/* ---------- CLzmaDecPoolHandle Interface ---------- */
+
+/*
+The pool keeps the (probs) arrays of the decoders between the jobs and the
+batches, one array per (lc + lp) value and thread. So allocations happen
+only for the first streams, the jobs decode directly into (dest) without a
+separate dictionary.
+
+numThreads:
+  the maximum number of threads (including the calling thread) for a batch.
+  The worker threads are created when a batch is large enough to use them,
+  and they wait for the next batch until LzmaDecPool_Destroy().
+  It's always 1, if the pool was compiled with _7ZIP_ST.
+*/
+
+typedef void * CLzmaDecPoolHandle;
+
+CLzmaDecPoolHandle LzmaDecPool_Create(ISzAllocPtr alloc, unsigned numThreads);
+void LzmaDecPool_Destroy(CLzmaDecPoolHandle p);
+
+/*
+LzmaDecPool_Decode() decodes all jobs and writes their results.
+  (finishMode) is used for all jobs, see LzmaDecode().
+  (stats) can be NULL.
+
+Returns:
+  SZ_OK           - all jobs were processed, (res) of every job has its result.
+  SZ_ERROR_THREAD - the worker threads could not be started,
+                    no job was processed.
+*/
+
+SRes LzmaDecPool_Decode(CLzmaDecPoolHandle p, CLzmaDecJob *jobs, size_t numJobs,
+    ELzmaFinishMode finishMode, CLzmaDecPoolStats *stats);
+
+EXTERN_C_END
+
+#endif
@@ -326,9 +326,24 @@ typedef struct
   BoolInt finished;
   BoolInt multiThread;
   BoolInt needInit;
+  BoolInt reuseMf;    /* set by LzmaEnc_Reset() for the next call */
+  BoolInt mfReady;    /* hash table was initialized by single-threaded match finder */
+  BoolInt mfContinue; /* next Init() can keep the hash table */
+  BoolInt presetMode;   /* the current stream follows the preset dictionary */
+  BoolInt presetProbsMode; /* the current stream starts with (presetProbs) */
+  BoolInt presetPrimed; /* (presetRefs) contains the match finder tables of the dictionary */
+  BoolInt presetUndo;   /* the match finder contains the last stream that followed the dictionary */
   // BoolInt _maxMode;
 
   UInt64 nowPos64;
+
+  const Byte *presetDict;
+  UInt32 presetSize;
+  UInt32 presetNumPos;  /* number of dictionary positions in (presetRefs) */
+  const UInt16 *presetProbs;
+  const Byte *presetWindow; /* (bufferBase) that the dictionary was copied to */
+  CLzRef *presetRefs;
+  size_t presetNumRefs;
   
   unsigned matchPriceCount;
   // unsigned alignPriceCount;
@@ -491,6 +506,9 @@ SRes LzmaEnc_SetProps(CLzmaEncHandle pp, const CLzmaEncProps *props2)
 
   p->writeEndMark = props.writeEndMark;
 
+  p->presetProbs = NULL;
+  p->presetPrimed = False;
+
   #ifndef _7ZIP_ST
   /*
   if (newMultiThread != _multiThread)
@@ -2222,6 +2240,21 @@ void LzmaEnc_Construct(CLzmaEnc *p)
   p->litProbs = NULL;
   p->saveState.litProbs = NULL;
 
+  p->reuseMf = False;
+  p->mfReady = False;
+  p->mfContinue = False;
+
+  p->presetMode = False;
+  p->presetProbsMode = False;
+  p->presetPrimed = False;
+  p->presetUndo = False;
+  p->presetDict = NULL;
+  p->presetSize = 0;
+  p->presetNumPos = 0;
+  p->presetProbs = NULL;
+  p->presetWindow = NULL;
+  p->presetRefs = NULL;
+  p->presetNumRefs = 0;
 }
 
 CLzmaEncHandle LzmaEnc_Create(ISzAllocPtr alloc)
@@ -2248,6 +2281,8 @@ void LzmaEnc_Destruct(CLzmaEnc *p, ISzAllocPtr alloc, ISzAllocPtr allocBig)
   #endif
   
   MatchFinder_Free(&p->matchFinderBase, allocBig);
+  ISzAlloc_Free(allocBig, p->presetRefs);
+  p->presetRefs = NULL;
   LzmaEnc_FreeLits(p, alloc);
   RangeEnc_Free(&p->rc, alloc);
 }
@@ -2258,13 +2293,216 @@ void LzmaEnc_Destroy(CLzmaEncHandle p, ISzAllocPtr alloc, ISzAllocPtr allocBig)
   ISzAlloc_Free(alloc, p);
 }
 
+void LzmaEnc_Reset(CLzmaEncHandle pp)
+{
+  CLzmaEnc *p = (CLzmaEnc *)pp;
+  p->reuseMf = True;
+}
+
+
+SRes LzmaEnc_SetPresetDict(CLzmaEncHandle pp, const Byte *dict, SizeT dictSize)
+{
+  CLzmaEnc *p = (CLzmaEnc *)pp;
+  if (dictSize > kLzmaMaxHistorySize)
+    return SZ_ERROR_PARAM;
+  p->presetDict = (dictSize != 0 ? dict : NULL);
+  p->presetSize = (UInt32)dictSize;
+  p->presetPrimed = False;
+  p->presetUndo = False;
+  p->presetWindow = NULL;
+  return SZ_OK;
+}
+
+
+/* layout of the probabilities in CLzmaDec::probs (LzmaDec.c) */
+
+#define kNumStates2 16
+#define kLenLowSize (LZMA_NUM_PB_STATES_MAX << (kLenNumLowBits + 1))
+#define kNumLenProbs (kLenLowSize + kLenNumHighSymbols)
+
+#define kProbsSpecPos 0
+#define kProbsIsRep0Long (kProbsSpecPos + kNumFullDistances)
+#define kProbsRepLenCoder (kProbsIsRep0Long + (kNumStates2 << LZMA_PB_MAX))
+#define kProbsLenCoder (kProbsRepLenCoder + kNumLenProbs)
+#define kProbsIsMatch (kProbsLenCoder + kNumLenProbs)
+#define kProbsAlign (kProbsIsMatch + (kNumStates2 << LZMA_PB_MAX))
+#define kProbsIsRep (kProbsAlign + kAlignTableSize)
+#define kProbsIsRepG0 (kProbsIsRep + kNumStates)
+#define kProbsIsRepG1 (kProbsIsRepG0 + kNumStates)
+#define kProbsIsRepG2 (kProbsIsRepG1 + kNumStates)
+#define kProbsPosSlot (kProbsIsRepG2 + kNumStates)
+#define kProbsLiteral (kProbsPosSlot + (kNumLenToPosStates << kNumPosSlotBits))
+
+#if kProbsLiteral != 1984
+  #error Stop_Compiling_Bad_LZMA_PROBS
+#endif
+
+#define PROBS_COPY(a, index) { if (load) a = (CLzmaProb)probs[index]; else probs[index] = (UInt16)a; }
+
+/* RcTree_ReverseEncode() numbers the nodes of every level in the order of
+   the coded bits, LzmaDec.c uses the order of the value bits */
+
+static void CopyProbsReverse(CLzmaProb *items, UInt16 *probs, unsigned numBits, BoolInt load)
+{
+  unsigned m;
+  for (m = 1; m < ((unsigned)1 << numBits); m++)
+  {
+    unsigned k = m;
+    unsigned level = 1;
+    unsigned rev = 0;
+    while (k != 1)
+    {
+      rev = (rev << 1) | (k & 1);
+      k >>= 1;
+      level <<= 1;
+    }
+    PROBS_COPY(items[m], level + rev);
+  }
+}
+
+static void LzmaEnc_CopyProbs(CLzmaEnc *p, UInt16 *probs, BoolInt load)
+{
+  UInt32 num = (UInt32)0x300 << p->lclp;
+  UInt32 k;
+  unsigned i;
+
+  for (i = kStartPosModelIndex; i < kEndPosModelIndex; i++)
+  {
+    unsigned footerBits = (i >> 1) - 1;
+    unsigned base = (2 | (i & 1)) << footerBits;
+    CopyProbsReverse(p->posEncoders + base, probs + kProbsSpecPos + base, footerBits, load);
+  }
+  /* CLenEnc has the same layout as the length probabilities of the decoder */
+  for (i = 0; i < kLenLowSize; i++)
+  {
+    PROBS_COPY(p->repLenProbs.low[i], kProbsRepLenCoder + i);
+    PROBS_COPY(p->lenProbs.low[i], kProbsLenCoder + i);
+  }
+  for (i = 0; i < kLenNumHighSymbols; i++)
+  {
+    PROBS_COPY(p->repLenProbs.high[i], kProbsRepLenCoder + kLenLowSize + i);
+    PROBS_COPY(p->lenProbs.high[i], kProbsLenCoder + kLenLowSize + i);
+  }
+  for (i = 0; i < kNumStates; i++)
+  {
+    unsigned j;
+    for (j = 0; j < LZMA_NUM_PB_STATES_MAX; j++)
+    {
+      PROBS_COPY(p->isRep0Long[i][j], kProbsIsRep0Long + (j << 4) + i);
+      PROBS_COPY(p->isMatch[i][j], kProbsIsMatch + (j << 4) + i);
+    }
+    PROBS_COPY(p->isRep[i], kProbsIsRep + i);
+    PROBS_COPY(p->isRepG0[i], kProbsIsRepG0 + i);
+    PROBS_COPY(p->isRepG1[i], kProbsIsRepG1 + i);
+    PROBS_COPY(p->isRepG2[i], kProbsIsRepG2 + i);
+  }
+  CopyProbsReverse(p->posAlignEncoder, probs + kProbsAlign, kNumAlignBits, load);
+  for (i = 0; i < kNumLenToPosStates; i++)
+  {
+    unsigned j;
+    for (j = 0; j < (1 << kNumPosSlotBits); j++)
+      PROBS_COPY(p->posSlotEncoder[i][j], kProbsPosSlot + (i << kNumPosSlotBits) + j);
+  }
+  /* the literals are most of the items */
+  if (load)
+    for (k = 0; k < num; k++)
+      p->litProbs[k] = (CLzmaProb)probs[kProbsLiteral + k];
+  else
+    for (k = 0; k < num; k++)
+      probs[kProbsLiteral + k] = (UInt16)p->litProbs[k];
+}
+
+
+UInt32 LzmaEnc_GetNumProbs(CLzmaEncHandle pp)
+{
+  const CLzmaEnc *p = (const CLzmaEnc *)pp;
+  return kProbsLiteral + ((UInt32)0x300 << (p->lc + p->lp));
+}
+
+
+SRes LzmaEnc_SetPresetProbs(CLzmaEncHandle pp, const UInt16 *probs)
+{
+  CLzmaEnc *p = (CLzmaEnc *)pp;
+  if (probs)
+  {
+    UInt32 num = LzmaEnc_GetNumProbs(pp);
+    UInt32 i;
+    for (i = 0; i < num; i++)
+      if (probs[i] == 0 || probs[i] >= kBitModelTotal)
+        return SZ_ERROR_PARAM;
+  }
+  p->presetProbs = probs;
+  return SZ_OK;
+}
+
+
+void LzmaEnc_GetProbs(CLzmaEncHandle pp, UInt16 *probs)
+{
+  CLzmaEnc *p = (CLzmaEnc *)pp;
+  UInt32 num = LzmaEnc_GetNumProbs(pp);
+  UInt32 i;
+  /* the decoder has unused items for (kNumStates2) states */
+  for (i = 0; i < num; i++)
+    probs[i] = kProbInitValue;
+  if (p->litProbs && p->lclp == p->lc + p->lp)
+    LzmaEnc_CopyProbs(p, probs, False);
+}
+
+
+static void LzmaEnc_InitPreset(CLzmaEnc *p)
+{
+  CMatchFinder *mf = &p->matchFinderBase;
+  UInt32 numPos = p->presetNumPos;
+  int undoResult = 0;
+
+  /* the dictionary is still in the window, if the last stream didn't move it */
+  if (p->presetPrimed && p->presetUndo && p->presetWindow == mf->bufferBase)
+    undoResult = MatchFinder_UndoPrefix(mf, p->presetRefs, numPos);
+  if (undoResult == 0)
+  {
+    memcpy(mf->bufferBase, p->presetDict, p->presetSize);
+    p->presetWindow = mf->bufferBase;
+  }
+
+  MatchFinder_Init_Prefix(mf, p->presetSize);
+  if (p->presetPrimed)
+    MatchFinder_LoadPrefix(mf, p->presetRefs, numPos, undoResult);
+  else
+  {
+    MatchFinder_Init_HighHash(mf);
+    MatchFinder_Init_LowHash(mf);
+    if (numPos != 0)
+      p->matchFinder.Skip(p->matchFinderObj, numPos);
+    MatchFinder_SavePrefix(mf, p->presetRefs, numPos);
+    p->presetPrimed = True;
+  }
+
+  /* the last positions of the dictionary depend on the following data */
+  if (numPos != p->presetSize)
+    p->matchFinder.Skip(p->matchFinderObj, p->presetSize - numPos);
+  p->presetUndo = True;
+}
+
 
 static SRes LzmaEnc_CodeOneBlock(CLzmaEnc *p, UInt32 maxPackSize, UInt32 maxUnpackSize)
 {
   UInt32 nowPos32, startPos32;
   if (p->needInit)
   {
-    p->matchFinder.Init(p->matchFinderObj);
+    if (p->presetMode)
+      LzmaEnc_InitPreset(p);
+    else
+    {
+      if (p->mfContinue)
+        MatchFinder_Init_Continue(&p->matchFinderBase);
+      else
+        p->matchFinder.Init(p->matchFinderObj);
+      p->presetUndo = False;
+    }
+    #ifndef _7ZIP_ST
+    if (!p->mtMode)
+    #endif
+      p->mfReady = True;
     p->needInit = 0;
   }
 
@@ -2563,7 +2801,7 @@ static SRes LzmaEnc_Alloc(CLzmaEnc *p, UInt32 keepWindowSize, ISzAllocPtr alloc,
     return SZ_ERROR_MEM;
 
   #ifndef _7ZIP_ST
-  p->mtMode = (p->multiThread && !p->fastMode && (p->matchFinderBase.btMode != 0));
+  p->mtMode = (p->multiThread && !p->fastMode && (p->matchFinderBase.btMode != 0) && !p->presetMode);
   #endif
 
   {
@@ -2668,11 +2906,17 @@ void LzmaEnc_Init(CLzmaEnc *p)
   p->optEnd = 0;
   p->optCur = 0;
 
+  /* GetOptimum() restores (kInfinityPrice) in the items that it uses,
+     so a reused handle is in the same state as in the middle of a stream */
+  if (!p->mfContinue)
   {
     for (i = 0; i < kNumOpts; i++)
       p->opt[i].price = kInfinityPrice;
   }
 
+  if (p->presetProbsMode)
+    LzmaEnc_CopyProbs(p, (UInt16 *)p->presetProbs, True);
+
   p->additionalOffset = 0;
 
   p->pbMask = (1 << p->pb) - 1;
@@ -2698,6 +2942,29 @@ void LzmaEnc_InitPrices(CLzmaEnc *p)
   LenPriceEnc_UpdateTables(&p->repLenEnc, 1 << p->pb, &p->repLenProbs, p->ProbPrices);
 }
 
+static SRes LzmaEnc_AllocPreset(CLzmaEnc *p, ISzAllocPtr allocBig)
+{
+  const CMatchFinder *mf = &p->matchFinderBase;
+  /* (matchMaxLen) bytes after a position are compared in the binary tree,
+     so the tables of the last positions depend on the data after the dictionary */
+  UInt32 numPos = (p->presetSize > mf->matchMaxLen ? p->presetSize - mf->matchMaxLen : 0);
+  size_t numRefs = MatchFinder_GetPrefixNumRefs(mf, numPos);
+  if (numPos != p->presetNumPos)
+    p->presetPrimed = False;
+  p->presetNumPos = numPos;
+  if (!p->presetRefs || numRefs != p->presetNumRefs)
+  {
+    ISzAlloc_Free(allocBig, p->presetRefs);
+    p->presetPrimed = False;
+    p->presetNumRefs = 0;
+    p->presetRefs = (CLzRef *)ISzAlloc_Alloc(allocBig, numRefs * sizeof(CLzRef));
+    if (!p->presetRefs)
+      return SZ_ERROR_MEM;
+    p->presetNumRefs = numRefs;
+  }
+  return SZ_OK;
+}
+
 static SRes LzmaEnc_AllocAndInit(CLzmaEnc *p, UInt32 keepWindowSize, ISzAllocPtr alloc, ISzAllocPtr allocBig)
 {
   unsigned i;
@@ -2708,10 +2975,30 @@ static SRes LzmaEnc_AllocAndInit(CLzmaEnc *p, UInt32 keepWindowSize, ISzAllocPtr
 
   p->finished = False;
   p->result = SZ_OK;
-  RINOK(LzmaEnc_Alloc(p, keepWindowSize, alloc, allocBig));
+  {
+    /* the hash table can be kept, if LzmaEnc_Alloc() didn't reallocate it */
+    const CLzRef *hash = p->matchFinderBase.hash;
+    size_t numRefs = p->matchFinderBase.numRefs;
+    BoolInt reuse = p->reuseMf && p->mfReady;
+    p->reuseMf = False;
+    p->mfReady = False;
+    p->mfContinue = False;
+    RINOK(LzmaEnc_Alloc(p, keepWindowSize, alloc, allocBig));
+    p->mfContinue = (reuse && hash && hash == p->matchFinderBase.hash && numRefs == p->matchFinderBase.numRefs);
+    #ifndef _7ZIP_ST
+    if (p->mtMode)
+      p->mfContinue = False;
+    #endif
+    if (hash != p->matchFinderBase.hash || numRefs != p->matchFinderBase.numRefs)
+      p->presetPrimed = False;
+  }
+  if (p->presetMode)
+  {
+    RINOK(LzmaEnc_AllocPreset(p, allocBig));
+  }
   LzmaEnc_Init(p);
   LzmaEnc_InitPrices(p);
-  p->nowPos64 = 0;
+  p->nowPos64 = (p->presetMode ? p->presetSize : 0);
   return SZ_OK;
 }
 
@@ -2719,8 +3006,18 @@ static SRes LzmaEnc_Prepare(CLzmaEncHandle pp, ISeqOutStream *outStream, ISeqInS
     ISzAllocPtr alloc, ISzAllocPtr allocBig)
 {
   CLzmaEnc *p = (CLzmaEnc *)pp;
+  if (p->presetSize > p->dictSize)
+    return SZ_ERROR_PARAM;
+  if (p->matchFinderBase.directInput)
+  {
+    /* (bufferBase) is the input buffer of the last LzmaEnc_MemEncode() call */
+    p->matchFinderBase.directInput = 0;
+    p->matchFinderBase.bufferBase = NULL;
+  }
   p->matchFinderBase.stream = inStream;
   p->needInit = 1;
+  p->presetMode = (p->presetSize != 0);
+  p->presetProbsMode = (p->presetProbs != NULL);
   p->rc.outStream = outStream;
   return LzmaEnc_AllocAndInit(p, 0, alloc, allocBig);
 }
@@ -2732,27 +3029,44 @@ SRes LzmaEnc_PrepareForLzma2(CLzmaEncHandle pp,
   CLzmaEnc *p = (CLzmaEnc *)pp;
   p->matchFinderBase.stream = inStream;
   p->needInit = 1;
+  p->presetMode = False;
+  p->presetProbsMode = False;
   return LzmaEnc_AllocAndInit(p, keepWindowSize, alloc, allocBig);
 }
 
-static void LzmaEnc_SetInputBuf(CLzmaEnc *p, const Byte *src, SizeT srcLen)
+static void LzmaEnc_SetInputBuf(CLzmaEnc *p, const Byte *src, SizeT srcLen, ISzAllocPtr allocBig)
 {
+  if (!p->matchFinderBase.directInput)
+  {
+    /* the window of the last LzmaEnc_Encode() call */
+    ISzAlloc_Free(allocBig, p->matchFinderBase.bufferBase);
+  }
   p->matchFinderBase.directInput = 1;
   p->matchFinderBase.bufferBase = (Byte *)src;
   p->matchFinderBase.directInputRem = srcLen;
 }
 
-SRes LzmaEnc_MemPrepare(CLzmaEncHandle pp, const Byte *src, SizeT srcLen,
-    UInt32 keepWindowSize, ISzAllocPtr alloc, ISzAllocPtr allocBig)
+static SRes LzmaEnc_MemPrepare2(CLzmaEncHandle pp, const Byte *src, SizeT srcLen,
+    UInt32 keepWindowSize, BoolInt presetProbsMode, ISzAllocPtr alloc, ISzAllocPtr allocBig)
 {
   CLzmaEnc *p = (CLzmaEnc *)pp;
-  LzmaEnc_SetInputBuf(p, src, srcLen);
+  LzmaEnc_SetInputBuf(p, src, srcLen, allocBig);
   p->needInit = 1;
+  p->presetMode = False;
+  p->presetProbsMode = presetProbsMode;
 
-  LzmaEnc_SetDataSize(pp, srcLen);
+  /* after LzmaEnc_Reset() the hash table only grows, so it's not reallocated for smaller blocks */
+  if (!p->reuseMf || srcLen > p->matchFinderBase.expectedDataSize)
+    LzmaEnc_SetDataSize(pp, srcLen);
   return LzmaEnc_AllocAndInit(p, keepWindowSize, alloc, allocBig);
 }
 
+SRes LzmaEnc_MemPrepare(CLzmaEncHandle pp, const Byte *src, SizeT srcLen,
+    UInt32 keepWindowSize, ISzAllocPtr alloc, ISzAllocPtr allocBig)
+{
+  return LzmaEnc_MemPrepare2(pp, src, srcLen, keepWindowSize, False, alloc, allocBig);
+}
+
 void LzmaEnc_Finish(CLzmaEncHandle pp)
 {
   #ifndef _7ZIP_ST
@@ -2788,6 +3102,27 @@ static size_t SeqOutStreamBuf_Write(const ISeqOutStream *pp, const void *data, s
 }
 
 
+typedef struct
+{
+  ISeqInStream vt;
+  const Byte *data;
+  SizeT rem;
+} CLzmaEnc_SeqInStreamBuf;
+
+static SRes SeqInStreamBuf_Read(const ISeqInStream *pp, void *data, size_t *size)
+{
+  CLzmaEnc_SeqInStreamBuf *p = CONTAINER_FROM_VTBL(pp, CLzmaEnc_SeqInStreamBuf, vt);
+  if (*size > p->rem)
+    *size = p->rem;
+  if (*size == 0)
+    return SZ_OK;
+  memcpy(data, p->data, *size);
+  p->rem -= *size;
+  p->data += *size;
+  return SZ_OK;
+}
+
+
 UInt32 LzmaEnc_GetNumAvailableBytes(CLzmaEncHandle pp)
 {
   const CLzmaEnc *p = (CLzmaEnc *)pp;
@@ -2858,7 +3193,8 @@ static SRes LzmaEnc_Encode2(CLzmaEnc *p, ICompressProgress *progress)
       break;
     if (progress)
     {
-      res = ICompressProgress_Progress(progress, p->nowPos64, RangeEnc_GetProcessed(&p->rc));
+      res = ICompressProgress_Progress(progress, p->nowPos64 - (p->presetMode ? p->presetSize : 0),
+          RangeEnc_GetProcessed(&p->rc));
       if (res != SZ_OK)
       {
         res = SZ_ERROR_PROGRESS;
@@ -2928,6 +3264,7 @@ SRes LzmaEnc_MemEncode(CLzmaEncHandle pp, Byte *dest, SizeT *destLen, const Byte
   CLzmaEnc *p = (CLzmaEnc *)pp;
 
   CLzmaEnc_SeqOutStreamBuf outStream;
+  CLzmaEnc_SeqInStreamBuf inStream;
 
   outStream.vt.Write = SeqOutStreamBuf_Write;
   outStream.data = dest;
@@ -2937,12 +3274,24 @@ SRes LzmaEnc_MemEncode(CLzmaEncHandle pp, Byte *dest, SizeT *destLen, const Byte
   p->writeEndMark = writeEndMark;
   p->rc.outStream = &outStream.vt;
 
-  res = LzmaEnc_MemPrepare(pp, src, srcLen, 0, alloc, allocBig);
+  if (p->presetSize == 0)
+    res = LzmaEnc_MemPrepare2(pp, src, srcLen, 0, p->presetProbs != NULL, alloc, allocBig);
+  else
+  {
+    /* the data must follow the dictionary in the window, so it's read as a stream */
+    UInt64 size = (UInt64)p->presetSize + srcLen;
+    inStream.vt.Read = SeqInStreamBuf_Read;
+    inStream.data = src;
+    inStream.rem = srcLen;
+    if (!(p->reuseMf || p->presetPrimed) || size > p->matchFinderBase.expectedDataSize)
+      LzmaEnc_SetDataSize(pp, size);
+    res = LzmaEnc_Prepare(pp, &outStream.vt, &inStream.vt, alloc, allocBig);
+  }
   
   if (res == SZ_OK)
   {
     res = LzmaEnc_Encode2(p, progress);
-    if (res == SZ_OK && p->nowPos64 != srcLen)
+    if (res == SZ_OK && p->nowPos64 != (UInt64)p->presetSize + srcLen)
       res = SZ_ERROR_FAIL;
   }
 
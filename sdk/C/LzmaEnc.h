@@ -64,6 +64,47 @@ SRes LzmaEnc_Encode(CLzmaEncHandle p, ISeqOutStream *outStream, ISeqInStream *in
 SRes LzmaEnc_MemEncode(CLzmaEncHandle p, Byte *dest, SizeT *destLen, const Byte *src, SizeT srcLen,
     int writeEndMark, ICompressProgress *progress, ISzAllocPtr alloc, ISzAllocPtr allocBig);
 
+/*
+LzmaEnc_Reset() prepares the handle for encoding the next independent stream
+  with LzmaEnc_Encode() or LzmaEnc_MemEncode(). Allocated buffers and the static
+  price tables are always kept between calls. After LzmaEnc_Reset() the next call
+  also keeps the match finder hash table without clearing it, and the
+  LzmaEnc_MemEncode() call doesn't shrink it for smaller (srcLen).
+  So encoding many small records costs less than LzmaEnc_Create() / LzmaEnc_Destroy()
+  for each record. The output is valid, but it can differ from the output of
+  a new handle. It must be called before each call that reuses the hash table.
+*/
+
+void LzmaEnc_Reset(CLzmaEncHandle p);
+
+/*
+Preset dictionary:
+LzmaEnc_SetPresetDict() sets a dictionary for the following LzmaEnc_Encode() and
+  LzmaEnc_MemEncode() calls. The streams continue after the (dictSize) bytes of
+  (dict), so they must be decoded with LzmaDec_InitPreset() and the same dictionary.
+  (dict) is not copied by this function, it must be available until the dictionary
+  is changed or the handle is destroyed. The encoder copies it into the window of
+  the match finder once and keeps the match finder tables after the dictionary, so
+  each stream needs only a few positions of the dictionary again.
+  The dictionary size in the properties must not be smaller than (dictSize),
+  the multithreaded match finder is not used with a preset dictionary.
+  (dictSize == 0) removes the dictionary.
+
+LzmaEnc_SetPresetProbs() sets the initial probabilities of the following streams
+  of LzmaEnc_Encode() and LzmaEnc_MemEncode(), also without a preset dictionary
+  (like LzmaDec_InitPreset() with (dictSize == 0)): LzmaEnc_GetNumProbs() items
+  in the layout of CLzmaDec::probs.
+  (probs) is not copied, (probs == NULL) restores the default probabilities.
+  LzmaEnc_SetProps() removes the probabilities, they depend on (lc) and (lp).
+LzmaEnc_GetProbs() writes the current probabilities of the encoder
+  (after a stream was encoded), for example to train the initial probabilities.
+*/
+
+SRes LzmaEnc_SetPresetDict(CLzmaEncHandle p, const Byte *dict, SizeT dictSize);
+SRes LzmaEnc_SetPresetProbs(CLzmaEncHandle p, const UInt16 *probs);
+UInt32 LzmaEnc_GetNumProbs(CLzmaEncHandle p);
+void LzmaEnc_GetProbs(CLzmaEncHandle p, UInt16 *probs);
+
 
 /* ---------- One Call Interface ---------- */
 
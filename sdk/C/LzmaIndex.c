@@ -0,0 +1,495 @@
+/* LzmaIndex.c -- Random access to .lzma files with decoder checkpoints
+2019-12-02 : Public domain */
+
+#include "Precomp.h"
+
+#include <string.h>
+
+#include "7zCrc.h"
+#include "CpuArch.h"
+#include "LzmaIndex.h"
+
+#define LZMA_INDEX_HEADER_SIZE (LZMA_PROPS_SIZE + 8)
+#define LZMA_INDEX_IN_BUF_SIZE (1 << 16)
+#define LZMA_INDEX_BUF_SIZE (1 << 12)
+
+/*
+checkpoint:
+  range, code, processedPos, checkDicSize, reps[4], state, remainLen,
+  tempBufSize, window size (UInt32 each), tempBuf[LZMA_REQUIRED_INPUT_MAX]
+  numProbs * UInt16 : probs
+  window size bytes : the last bytes of the dictionary
+entry of the table:
+  outPos, inPos, offset (UInt64 each), crc (UInt32), reserved (UInt32)
+footer:
+  props[LZMA_PROPS_SIZE], reserved[3], outSize, numEntries (UInt64 each),
+  crc of the table and the footer (UInt32), signature
+*/
+
+#define LZMA_INDEX_CHECKPOINT_SIZE (4 * 12 + LZMA_REQUIRED_INPUT_MAX)
+#define LZMA_INDEX_ENTRY_SIZE 32
+#define LZMA_INDEX_FOOTER_SIZE 32
+
+static const Byte kLzmaIndexSig[4] = { 'L', 'Z', 'I', 'X' };
+
+/* the limits of CLzmaDec values, see LzmaDec.c */
+#define kNumStates 12
+#define kMatchSpecLenStart (2 + 8 * 2 + 256)
+#define kBitModelTotal (1 << 11)
+
+
+void LzmaIndex_Construct(CLzmaIndex *p)
+{
+  p->outSize = 0;
+  p->numEntries = 0;
+  p->numAllocated = 0;
+  p->entries = NULL;
+}
+
+void LzmaIndex_Free(CLzmaIndex *p, ISzAllocPtr alloc)
+{
+  ISzAlloc_Free(alloc, p->entries);
+  LzmaIndex_Construct(p);
+}
+
+static SRes LzmaIndex_Reserve(CLzmaIndex *p, size_t num, ISzAllocPtr alloc)
+{
+  CLzmaIndexEntry *entries;
+  if (num <= p->numAllocated)
+    return SZ_OK;
+  if (num < p->numAllocated * 2)
+    num = p->numAllocated * 2;
+  if (num < 16)
+    num = 16;
+  if (num > ((size_t)0 - 1) / sizeof(CLzmaIndexEntry))
+    return SZ_ERROR_MEM;
+  entries = (CLzmaIndexEntry *)ISzAlloc_Alloc(alloc, num * sizeof(CLzmaIndexEntry));
+  if (!entries)
+    return SZ_ERROR_MEM;
+  if (p->numEntries != 0)
+    memcpy(entries, p->entries, p->numEntries * sizeof(CLzmaIndexEntry));
+  ISzAlloc_Free(alloc, p->entries);
+  p->entries = entries;
+  p->numAllocated = num;
+  return SZ_OK;
+}
+
+
+/* ---------- Build ---------- */
+
+typedef struct
+{
+  ISeqOutStream *stream;
+  UInt64 pos;
+  UInt32 crc;
+} CLzmaIndexWriter;
+
+static SRes LzmaIndexWriter_Write(CLzmaIndexWriter *w, const void *buf, size_t size)
+{
+  if (size == 0)
+    return SZ_OK;
+  if (ISeqOutStream_Write(w->stream, buf, size) != size)
+    return SZ_ERROR_WRITE;
+  w->pos += size;
+  w->crc = CrcUpdate(w->crc, buf, size);
+  return SZ_OK;
+}
+
+static SRes LzmaIndex_WriteCheckpoint(CLzmaIndex *p, const CLzmaDec *dec,
+    UInt64 outPos, UInt64 inPos, CLzmaIndexWriter *w, ISzAllocPtr alloc)
+{
+  Byte buf[LZMA_INDEX_BUF_SIZE];
+  CLzmaIndexEntry *e;
+  /* the decoder can only access the last (dicSize) bytes */
+  UInt32 winSize = (dec->checkDicSize != 0 ? dec->checkDicSize : dec->processedPos);
+  UInt32 i;
+
+  if (winSize > dec->dicBufSize)
+    winSize = (UInt32)dec->dicBufSize;
+
+  RINOK(LzmaIndex_Reserve(p, p->numEntries + 1, alloc));
+  e = &p->entries[p->numEntries];
+  e->outPos = outPos;
+  e->inPos = inPos;
+  e->offset = w->pos;
+  w->crc = CRC_INIT_VAL;
+
+  SetUi32(buf, dec->range);
+  SetUi32(buf + 4, dec->code);
+  SetUi32(buf + 8, dec->processedPos);
+  SetUi32(buf + 12, dec->checkDicSize);
+  for (i = 0; i < 4; i++)
+    SetUi32(buf + 16 + i * 4, dec->reps[i]);
+  SetUi32(buf + 32, dec->state);
+  SetUi32(buf + 36, dec->remainLen);
+  SetUi32(buf + 40, (UInt32)dec->tempBufSize);
+  SetUi32(buf + 44, winSize);
+  memcpy(buf + 48, dec->tempBuf, LZMA_REQUIRED_INPUT_MAX);
+  RINOK(LzmaIndexWriter_Write(w, buf, LZMA_INDEX_CHECKPOINT_SIZE));
+
+  for (i = 0; i < dec->numProbs;)
+  {
+    size_t size = 0;
+    for (; i < dec->numProbs && size < LZMA_INDEX_BUF_SIZE; i++, size += 2)
+      SetUi16(buf + size, (UInt16)dec->probs[i]);
+    RINOK(LzmaIndexWriter_Write(w, buf, size));
+  }
+
+  if (winSize > dec->dicPos)
+  {
+    SizeT rem = winSize - dec->dicPos;
+    RINOK(LzmaIndexWriter_Write(w, dec->dic + dec->dicBufSize - rem, rem));
+    RINOK(LzmaIndexWriter_Write(w, dec->dic, dec->dicPos));
+  }
+  else
+  {
+    RINOK(LzmaIndexWriter_Write(w, dec->dic + dec->dicPos - winSize, winSize));
+  }
+
+  e->crc = CRC_GET_DIGEST(w->crc);
+  p->numEntries++;
+  return SZ_OK;
+}
+
+static SRes LzmaIndex_WriteTable(const CLzmaIndex *p, CLzmaIndexWriter *w)
+{
+  Byte buf[LZMA_INDEX_FOOTER_SIZE];
+  size_t i;
+  w->crc = CRC_INIT_VAL;
+  for (i = 0; i < p->numEntries; i++)
+  {
+    const CLzmaIndexEntry *e = &p->entries[i];
+    SetUi64(buf, e->outPos);
+    SetUi64(buf + 8, e->inPos);
+    SetUi64(buf + 16, e->offset);
+    SetUi32(buf + 24, e->crc);
+    SetUi32(buf + 28, 0);
+    RINOK(LzmaIndexWriter_Write(w, buf, LZMA_INDEX_ENTRY_SIZE));
+  }
+  memcpy(buf, p->props, LZMA_PROPS_SIZE);
+  memset(buf + LZMA_PROPS_SIZE, 0, 3);
+  SetUi64(buf + 8, p->outSize);
+  SetUi64(buf + 16, p->numEntries);
+  RINOK(LzmaIndexWriter_Write(w, buf, 24));
+  SetUi32(buf + 24, CRC_GET_DIGEST(w->crc));
+  memcpy(buf + 28, kLzmaIndexSig, 4);
+  return LzmaIndexWriter_Write(w, buf + 24, 8);
+}
+
+static SRes LzmaIndex_Build2(CLzmaIndex *p, CLzmaDec *dec, Byte *inBuf, ISeqInStream *inStream,
+    ISeqOutStream *outStream, CLzmaIndexWriter *w, UInt64 step, UInt64 unpackSize, ISzAllocPtr alloc)
+{
+  BoolInt thereIsSize = (unpackSize != (UInt64)(Int64)-1);
+  UInt64 outPos = 0;
+  UInt64 inFilePos = LZMA_INDEX_HEADER_SIZE;
+  UInt64 nextPos = step;
+  size_t inPos = 0, inSize = 0;
+
+  LzmaDec_Init(dec);
+  for (;;)
+  {
+    SizeT dicPos, dicLimit, inProcessed, outProcessed;
+    ELzmaFinishMode finishMode = LZMA_FINISH_ANY;
+    ELzmaStatus status;
+    SRes res;
+
+    if (inPos == inSize)
+    {
+      inSize = LZMA_INDEX_IN_BUF_SIZE;
+      RINOK(ISeqInStream_Read(inStream, inBuf, &inSize));
+      inPos = 0;
+    }
+
+    if (dec->dicPos == dec->dicBufSize)
+      dec->dicPos = 0;
+    dicPos = dec->dicPos;
+    dicLimit = dec->dicBufSize;
+    /* the decoder stops at the position of the next checkpoint */
+    if (nextPos - outPos < dicLimit - dicPos)
+      dicLimit = dicPos + (SizeT)(nextPos - outPos);
+    if (thereIsSize && unpackSize - outPos <= dicLimit - dicPos)
+    {
+      dicLimit = dicPos + (SizeT)(unpackSize - outPos);
+      finishMode = LZMA_FINISH_END;
+    }
+
+    inProcessed = inSize - inPos;
+    res = LzmaDec_DecodeToDic(dec, dicLimit, inBuf + inPos, &inProcessed, finishMode, &status);
+    inPos += inProcessed;
+    inFilePos += inProcessed;
+    outProcessed = dec->dicPos - dicPos;
+    outPos += outProcessed;
+
+    if (outStream && outProcessed != 0)
+      if (ISeqOutStream_Write(outStream, dec->dic + dicPos, outProcessed) != outProcessed)
+        return SZ_ERROR_WRITE;
+
+    RINOK(res);
+    if (status == LZMA_STATUS_FINISHED_WITH_MARK || (thereIsSize && outPos == unpackSize))
+      break;
+
+    if (outPos == nextPos)
+    {
+      RINOK(LzmaIndex_WriteCheckpoint(p, dec, outPos, inFilePos, w, alloc));
+      nextPos += step;
+    }
+    else if (inProcessed == 0 && outProcessed == 0)
+      return (status == LZMA_STATUS_NEEDS_MORE_INPUT ? SZ_ERROR_INPUT_EOF : SZ_ERROR_DATA);
+  }
+
+  p->outSize = outPos;
+  return LzmaIndex_WriteTable(p, w);
+}
+
+SRes LzmaIndex_Build(CLzmaIndex *p, ISeqInStream *inStream, ISeqOutStream *outStream,
+    ISeqOutStream *indexStream, UInt64 step, ISzAllocPtr alloc)
+{
+  Byte header[LZMA_INDEX_HEADER_SIZE];
+  CLzmaIndexWriter w;
+  CLzmaDec dec;
+  Byte *inBuf;
+  SRes res;
+
+  LzmaIndex_Free(p, alloc);
+  if (step == 0)
+    return SZ_ERROR_PARAM;
+  RINOK(SeqInStream_Read(inStream, header, sizeof(header)));
+  memcpy(p->props, header, LZMA_PROPS_SIZE);
+
+  LzmaDec_Construct(&dec);
+  RINOK(LzmaDec_Allocate(&dec, header, LZMA_PROPS_SIZE, alloc));
+  inBuf = (Byte *)ISzAlloc_Alloc(alloc, LZMA_INDEX_IN_BUF_SIZE);
+  if (!inBuf)
+  {
+    LzmaDec_Free(&dec, alloc);
+    return SZ_ERROR_MEM;
+  }
+
+  w.stream = indexStream;
+  w.pos = 0;
+  w.crc = CRC_INIT_VAL;
+  res = LzmaIndex_Build2(p, &dec, inBuf, inStream, outStream, &w, step,
+      GetUi64(header + LZMA_PROPS_SIZE), alloc);
+
+  ISzAlloc_Free(alloc, inBuf);
+  LzmaDec_Free(&dec, alloc);
+  return res;
+}
+
+
+/* ---------- Read ---------- */
+
+SRes LzmaIndex_ReadIndex(CLzmaIndex *p, ILookInStream *indexStream, ISzAllocPtr alloc)
+{
+  Byte buf[LZMA_INDEX_BUF_SIZE];
+  CLzmaProps props;
+  UInt64 fileSize, tableOffset, numEntries, prevOutPos = 0, prevInPos = LZMA_INDEX_HEADER_SIZE;
+  UInt32 crc = CRC_INIT_VAL;
+  size_t i;
+
+  LzmaIndex_Free(p, alloc);
+  {
+    Int64 pos = 0;
+    RINOK(ILookInStream_Seek(indexStream, &pos, SZ_SEEK_END));
+    fileSize = (UInt64)pos;
+  }
+  if (fileSize < LZMA_INDEX_FOOTER_SIZE)
+    return SZ_ERROR_NO_ARCHIVE;
+  RINOK(LookInStream_SeekTo(indexStream, fileSize - LZMA_INDEX_FOOTER_SIZE));
+  RINOK(LookInStream_Read(indexStream, buf, LZMA_INDEX_FOOTER_SIZE));
+  if (memcmp(buf + 28, kLzmaIndexSig, 4) != 0)
+    return SZ_ERROR_NO_ARCHIVE;
+
+  numEntries = GetUi64(buf + 16);
+  if (numEntries > (fileSize - LZMA_INDEX_FOOTER_SIZE) / LZMA_INDEX_ENTRY_SIZE)
+    return SZ_ERROR_ARCHIVE;
+  if (LzmaProps_Decode(&props, buf, LZMA_PROPS_SIZE) != SZ_OK)
+    return SZ_ERROR_UNSUPPORTED;
+  memcpy(p->props, buf, LZMA_PROPS_SIZE);
+  p->outSize = GetUi64(buf + 8);
+  tableOffset = fileSize - LZMA_INDEX_FOOTER_SIZE - numEntries * LZMA_INDEX_ENTRY_SIZE;
+
+  if ((size_t)numEntries != numEntries)
+    return SZ_ERROR_MEM;
+  RINOK(LzmaIndex_Reserve(p, (size_t)numEntries, alloc));
+  RINOK(LookInStream_SeekTo(indexStream, tableOffset));
+  for (i = 0; i < (size_t)numEntries; i++)
+  {
+    CLzmaIndexEntry *e = &p->entries[i];
+    RINOK(LookInStream_Read(indexStream, buf, LZMA_INDEX_ENTRY_SIZE));
+    crc = CrcUpdate(crc, buf, LZMA_INDEX_ENTRY_SIZE);
+    e->outPos = GetUi64(buf);
+    e->inPos = GetUi64(buf + 8);
+    e->offset = GetUi64(buf + 16);
+    e->crc = GetUi32(buf + 24);
+    if (e->outPos <= prevOutPos || e->inPos < prevInPos || e->offset >= tableOffset)
+      return SZ_ERROR_ARCHIVE;
+    prevOutPos = e->outPos;
+    prevInPos = e->inPos;
+  }
+
+  RINOK(LookInStream_Read(indexStream, buf, LZMA_INDEX_FOOTER_SIZE));
+  crc = CrcUpdate(crc, buf, 24);
+  if (CRC_GET_DIGEST(crc) != GetUi32(buf + 24))
+    return SZ_ERROR_CRC;
+  if (p->outSize < prevOutPos)
+    return SZ_ERROR_ARCHIVE;
+  p->numEntries = (size_t)numEntries;
+  return SZ_OK;
+}
+
+static SRes LzmaIndex_ReadCheckpoint(const CLzmaIndexEntry *e, ILookInStream *indexStream, CLzmaDec *dec)
+{
+  Byte buf[LZMA_INDEX_BUF_SIZE];
+  UInt32 crc = CRC_INIT_VAL;
+  UInt32 limit, winSize, i;
+
+  RINOK(LookInStream_SeekTo(indexStream, e->offset));
+  RINOK(LookInStream_Read(indexStream, buf, LZMA_INDEX_CHECKPOINT_SIZE));
+  crc = CrcUpdate(crc, buf, LZMA_INDEX_CHECKPOINT_SIZE);
+
+  dec->range = GetUi32(buf);
+  dec->code = GetUi32(buf + 4);
+  dec->processedPos = GetUi32(buf + 8);
+  dec->checkDicSize = GetUi32(buf + 12);
+  for (i = 0; i < 4; i++)
+    dec->reps[i] = GetUi32(buf + 16 + i * 4);
+  dec->state = GetUi32(buf + 32);
+  dec->remainLen = GetUi32(buf + 36);
+  dec->tempBufSize = GetUi32(buf + 40);
+  winSize = GetUi32(buf + 44);
+  memcpy(dec->tempBuf, buf + 48, LZMA_REQUIRED_INPUT_MAX);
+
+  /* the decoder doesn't check these values, so they must be valid to avoid
+     reading outside of the dictionary */
+  limit = (dec->checkDicSize != 0 ? dec->checkDicSize : dec->processedPos);
+  if ((dec->checkDicSize != 0 && dec->checkDicSize != dec->prop.dicSize)
+      || (dec->checkDicSize == 0 && dec->processedPos >= dec->prop.dicSize)
+      || dec->state >= kNumStates
+      || dec->remainLen >= kMatchSpecLenStart
+      || dec->tempBufSize > LZMA_REQUIRED_INPUT_MAX
+      || winSize == 0
+      || winSize != (limit < dec->dicBufSize ? limit : (UInt32)dec->dicBufSize))
+    return SZ_ERROR_ARCHIVE;
+  for (i = 0; i < 4; i++)
+    if (dec->reps[i] == 0 || dec->reps[i] > winSize)
+      return SZ_ERROR_ARCHIVE;
+
+  for (i = 0; i < dec->numProbs;)
+  {
+    size_t size = (size_t)(dec->numProbs - i) * 2;
+    size_t k;
+    if (size > LZMA_INDEX_BUF_SIZE)
+      size = LZMA_INDEX_BUF_SIZE;
+    RINOK(LookInStream_Read(indexStream, buf, size));
+    crc = CrcUpdate(crc, buf, size);
+    for (k = 0; k < size; k += 2, i++)
+    {
+      UInt32 prob = GetUi16(buf + k);
+      if (prob == 0 || prob >= kBitModelTotal)
+        return SZ_ERROR_ARCHIVE;
+      dec->probs[i] = (CLzmaProb)prob;
+    }
+  }
+
+  RINOK(LookInStream_Read(indexStream, dec->dic, winSize));
+  crc = CrcUpdate(crc, dec->dic, winSize);
+  if (CRC_GET_DIGEST(crc) != e->crc)
+    return SZ_ERROR_CRC;
+  dec->dicPos = winSize;
+  return SZ_OK;
+}
+
+SRes LzmaIndex_Seek(const CLzmaIndex *p, ILookInStream *indexStream, UInt64 outPos,
+    CLzmaDec *dec, UInt64 *inPos, UInt64 *checkpointPos, ISzAllocPtr alloc)
+{
+  size_t left = 0, right = p->numEntries;
+  SRes res;
+
+  RINOK(LzmaDec_Allocate(dec, p->props, LZMA_PROPS_SIZE, alloc));
+  while (left != right)
+  {
+    size_t mid = (left + right) / 2;
+    if (p->entries[mid].outPos <= outPos)
+      left = mid + 1;
+    else
+      right = mid;
+  }
+
+  if (left == 0)
+  {
+    LzmaDec_Init(dec);
+    *inPos = LZMA_INDEX_HEADER_SIZE;
+    *checkpointPos = 0;
+    return SZ_OK;
+  }
+
+  res = LzmaIndex_ReadCheckpoint(&p->entries[left - 1], indexStream, dec);
+  if (res != SZ_OK)
+  {
+    /* (dec) must not be used with a partially restored state */
+    LzmaDec_Init(dec);
+    return res;
+  }
+  *inPos = p->entries[left - 1].inPos;
+  *checkpointPos = p->entries[left - 1].outPos;
+  return SZ_OK;
+}
+
+SRes LzmaIndex_Read(const CLzmaIndex *p, ILookInStream *indexStream, ILookInStream *inStream,
+    CLzmaDec *dec, UInt64 outPos, Byte *dest, size_t *size, ISzAllocPtr alloc)
+{
+  size_t rem = *size;
+  UInt64 inPos, pos;
+
+  *size = 0;
+  if (outPos >= p->outSize)
+    return SZ_OK;
+  if (rem > p->outSize - outPos)
+    rem = (size_t)(p->outSize - outPos);
+  if (rem == 0)
+    return SZ_OK;
+
+  RINOK(LzmaIndex_Seek(p, indexStream, outPos, dec, &inPos, &pos, alloc));
+  RINOK(LookInStream_SeekTo(inStream, inPos));
+
+  for (;;)
+  {
+    const void *inBuf;
+    size_t inSize = LZMA_INDEX_IN_BUF_SIZE;
+    SizeT dicPos, dicLimit, inProcessed, outProcessed;
+    ELzmaStatus status;
+    SRes res;
+
+    RINOK(ILookInStream_Look(inStream, &inBuf, &inSize));
+
+    if (dec->dicPos == dec->dicBufSize)
+      dec->dicPos = 0;
+    dicPos = dec->dicPos;
+    dicLimit = dec->dicBufSize;
+    if (outPos + rem - pos < dicLimit - dicPos)
+      dicLimit = dicPos + (SizeT)(outPos + rem - pos);
+
+    inProcessed = inSize;
+    res = LzmaDec_DecodeToDic(dec, dicLimit, (const Byte *)inBuf, &inProcessed, LZMA_FINISH_ANY, &status);
+    RINOK(ILookInStream_Skip(inStream, inProcessed));
+    outProcessed = dec->dicPos - dicPos;
+
+    /* the data before (outPos) is decoded only to fill the dictionary */
+    if (pos + outProcessed > outPos)
+    {
+      SizeT skip = (pos < outPos ? (SizeT)(outPos - pos) : 0);
+      memcpy(dest + *size, dec->dic + dicPos + skip, outProcessed - skip);
+      *size += outProcessed - skip;
+    }
+    pos += outProcessed;
+
+    RINOK(res);
+    if (*size == rem)
+      return SZ_OK;
+    if (status == LZMA_STATUS_FINISHED_WITH_MARK)
+      return SZ_ERROR_DATA;
+    if (inProcessed == 0 && outProcessed == 0)
+      return (status == LZMA_STATUS_NEEDS_MORE_INPUT ? SZ_ERROR_INPUT_EOF : SZ_ERROR_DATA);
+  }
+}
@@ -0,0 +1,120 @@
+/* LzmaIndex.h -- Random access to .lzma files with decoder checkpoints
+2019-12-02 : Public domain */
+
+#ifndef __LZMA_INDEX_H
+#define __LZMA_INDEX_H
+
+#include "LzmaDec.h"
+
+EXTERN_C_BEGIN
+
+/*
+A .lzma file (5 bytes of properties, 8 bytes of unpack size, one LZMA stream)
+can only be decoded from the start. The index stores checkpoints of the
+decoder state (range coder, reps, state, probs and the last (dicSize) bytes
+of the dictionary) every (step) bytes of the decoded data, so reading at any
+position restores the last checkpoint before it and decodes at most (step)
+bytes that are not needed.
+
+The index file contains the checkpoints, then a table of their positions and
+a footer. Only the table is held in memory (CLzmaIndex), a checkpoint is read
+from the index file when it's restored. So the size of the index file is
+about ((dicSize + 2 * numProbs) * (unpackSize / step)).
+
+CrcGenerateTable() must be called before these functions.
+*/
+
+typedef struct
+{
+  UInt64 outPos;     /* position in the decoded data, it's never 0 */
+  UInt64 inPos;      /* position in the .lzma file where decoding continues */
+  UInt64 offset;     /* position of the checkpoint in the index file */
+  UInt32 crc;        /* CRC32 of the checkpoint */
+} CLzmaIndexEntry;
+
+typedef struct
+{
+  Byte props[LZMA_PROPS_SIZE];
+  UInt64 outSize;    /* size of the decoded data */
+  size_t numEntries;
+  size_t numAllocated;
+  CLzmaIndexEntry *entries;  /* sorted by (outPos) */
+} CLzmaIndex;
+
+void LzmaIndex_Construct(CLzmaIndex *p);
+void LzmaIndex_Free(CLzmaIndex *p, ISzAllocPtr alloc);
+
+/*
+LzmaIndex_Build() decodes the .lzma file from (inStream) and writes the
+  index file to (indexStream).
+  (outStream) can be NULL, otherwise the decoded data is written to it.
+  (step) is the distance of the checkpoints in the decoded data.
+
+Returns:
+  SZ_OK
+  SZ_ERROR_PARAM       - (step == 0)
+  SZ_ERROR_MEM         - memory allocation error
+  SZ_ERROR_UNSUPPORTED - unsupported properties
+  SZ_ERROR_DATA        - data error
+  SZ_ERROR_INPUT_EOF   - the stream ends before the end of the data
+  SZ_ERROR_WRITE       - (outStream) or (indexStream) write error
+  the error of (inStream)
+*/
+
+SRes LzmaIndex_Build(CLzmaIndex *p, ISeqInStream *inStream, ISeqOutStream *outStream,
+    ISeqOutStream *indexStream, UInt64 step, ISzAllocPtr alloc);
+
+/*
+LzmaIndex_ReadIndex() reads the table of an index file that was written by
+  LzmaIndex_Build().
+
+Returns:
+  SZ_OK
+  SZ_ERROR_NO_ARCHIVE  - it's not an index file
+  SZ_ERROR_ARCHIVE     - incorrect table
+  SZ_ERROR_CRC         - CRC error of the table
+  SZ_ERROR_MEM         - memory allocation error
+  SZ_ERROR_UNSUPPORTED - unsupported properties
+  the error of (indexStream)
+*/
+
+SRes LzmaIndex_ReadIndex(CLzmaIndex *p, ILookInStream *indexStream, ISzAllocPtr alloc);
+
+/*
+LzmaIndex_Seek() restores the last checkpoint at or before (outPos) into
+  (dec), it allocates (dec) for the properties of the file if required.
+  The caller continues with LzmaDec_DecodeToDic() or LzmaDec_DecodeToBuf()
+  at the position (*inPos) of the .lzma file, the next decoded byte is at
+  the position (*checkpointPos) of the decoded data.
+
+Returns:
+  SZ_OK
+  SZ_ERROR_ARCHIVE     - incorrect checkpoint
+  SZ_ERROR_CRC         - CRC error of the checkpoint
+  SZ_ERROR_MEM         - memory allocation error
+  SZ_ERROR_UNSUPPORTED - unsupported properties
+  the error of (indexStream)
+*/
+
+SRes LzmaIndex_Seek(const CLzmaIndex *p, ILookInStream *indexStream, UInt64 outPos,
+    CLzmaDec *dec, UInt64 *inPos, UInt64 *checkpointPos, ISzAllocPtr alloc);
+
+/*
+LzmaIndex_Read() reads up to (*size) bytes of the decoded data at (outPos)
+  from the .lzma file (inStream), it uses LzmaIndex_Seek() for (dec).
+  (*size) returns the number of bytes read, it's smaller only at the end of
+  the data.
+
+Returns:
+  SZ_OK
+  SZ_ERROR_DATA        - data error
+  SZ_ERROR_INPUT_EOF   - the stream ends before the end of the data
+  the errors of LzmaIndex_Seek() and (inStream)
+*/
+
+SRes LzmaIndex_Read(const CLzmaIndex *p, ILookInStream *indexStream, ILookInStream *inStream,
+    CLzmaDec *dec, UInt64 outPos, Byte *dest, size_t *size, ISzAllocPtr alloc);
+
+EXTERN_C_END
+
+#endif
@@ -3,6 +3,8 @@
 
 #include "Precomp.h"
 
+#include <string.h>
+
 // #define SHOW_DEBUG_INFO
 
 // #include <stdio.h>
@@ -863,10 +865,9 @@ static THREAD_FUNC_RET_TYPE THREAD_FUNC_CALL_TYPE ThreadFunc1(void *pp)
 
 static MY_NO_INLINE THREAD_FUNC_RET_TYPE THREAD_FUNC_CALL_TYPE ThreadFunc(void *pp)
 {
+  #ifdef USE_ALLOCA
   CMtDecThread *t = (CMtDecThread *)pp;
-
   // fprintf(stderr, "\n%d = %p - before", t->index, &t);
-  #ifdef USE_ALLOCA
   t->allocaPtr = alloca(t->index * 128);
   #endif
   return ThreadFunc1(pp);
@@ -112,9 +112,12 @@ typedef struct
   UInt32 Range;
   UInt32 Code;
   IByteIn *Stream;
+  CByteInBuf *Buf;
 } CPpmd7z_RangeDec;
 
 void Ppmd7z_RangeDec_CreateVTable(CPpmd7z_RangeDec *p);
+/* Read from the window of (buf) directly. Call after Ppmd7z_RangeDec_CreateVTable(). */
+void Ppmd7z_RangeDec_SetBuf(CPpmd7z_RangeDec *p, CByteInBuf *buf);
 BoolInt Ppmd7z_RangeDec_Init(CPpmd7z_RangeDec *p);
 #define Ppmd7z_RangeDec_IsFinishedOK(p) ((p)->Code == 0)
 
@@ -130,9 +133,13 @@ typedef struct
   Byte Cache;
   UInt64 CacheSize;
   IByteOut *Stream;
+  CByteOutBuf *Buf;
 } CPpmd7z_RangeEnc;
 
 void Ppmd7z_RangeEnc_Init(CPpmd7z_RangeEnc *p);
+/* Write to the window of (buf) directly. Call after Ppmd7z_RangeEnc_Init().
+   The caller must drain the remaining window after Ppmd7z_RangeEnc_FlushData(). */
+void Ppmd7z_RangeEnc_SetBuf(CPpmd7z_RangeEnc *p, CByteOutBuf *buf);
 void Ppmd7z_RangeEnc_FlushData(CPpmd7z_RangeEnc *p);
 
 void Ppmd7_EncodeSymbol(CPpmd7 *p, CPpmd7z_RangeEnc *rc, int symbol);
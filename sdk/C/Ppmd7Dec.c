@@ -8,15 +8,17 @@ This code is based on PPMd var.H (2001): Dmitry Shkarin : Public domain */
 
 #define kTopValue (1 << 24)
 
+#define RC_READ_BYTE(p) ((p)->Buf ? ByteInBuf_Read((p)->Buf) : IByteIn_Read((p)->Stream))
+
 BoolInt Ppmd7z_RangeDec_Init(CPpmd7z_RangeDec *p)
 {
   unsigned i;
   p->Code = 0;
   p->Range = 0xFFFFFFFF;
-  if (IByteIn_Read(p->Stream) != 0)
+  if (RC_READ_BYTE(p) != 0)
     return False;
   for (i = 0; i < 4; i++)
-    p->Code = (p->Code << 8) | IByteIn_Read(p->Stream);
+    p->Code = (p->Code << 8) | RC_READ_BYTE(p);
   return (p->Code < 0xFFFFFFFF);
 }
 
@@ -32,11 +34,11 @@ static void Range_Normalize(CPpmd7z_RangeDec *p)
 {
   if (p->Range < kTopValue)
   {
-    p->Code = (p->Code << 8) | IByteIn_Read(p->Stream);
+    p->Code = (p->Code << 8) | RC_READ_BYTE(p);
     p->Range <<= 8;
     if (p->Range < kTopValue)
     {
-      p->Code = (p->Code << 8) | IByteIn_Read(p->Stream);
+      p->Code = (p->Code << 8) | RC_READ_BYTE(p);
       p->Range <<= 8;
     }
   }
@@ -75,6 +77,13 @@ void Ppmd7z_RangeDec_CreateVTable(CPpmd7z_RangeDec *p)
   p->vt.GetThreshold = Range_GetThreshold;
   p->vt.Decode = Range_Decode;
   p->vt.DecodeBit = Range_DecodeBit;
+  p->Buf = NULL;
+}
+
+void Ppmd7z_RangeDec_SetBuf(CPpmd7z_RangeDec *p, CByteInBuf *buf)
+{
+  p->Stream = &buf->vt;
+  p->Buf = buf;
 }
 
 
@@ -14,6 +14,13 @@ void Ppmd7z_RangeEnc_Init(CPpmd7z_RangeEnc *p)
   p->Range = 0xFFFFFFFF;
   p->Cache = 0;
   p->CacheSize = 1;
+  p->Buf = NULL;
+}
+
+void Ppmd7z_RangeEnc_SetBuf(CPpmd7z_RangeEnc *p, CByteOutBuf *buf)
+{
+  p->Stream = &buf->vt;
+  p->Buf = buf;
 }
 
 static void RangeEnc_ShiftLow(CPpmd7z_RangeEnc *p)
@@ -23,7 +30,11 @@ static void RangeEnc_ShiftLow(CPpmd7z_RangeEnc *p)
     Byte temp = p->Cache;
     do
     {
-      IByteOut_Write(p->Stream, (Byte)(temp + (Byte)(p->Low >> 32)));
+      Byte b = (Byte)(temp + (Byte)(p->Low >> 32));
+      if (p->Buf)
+        ByteOutBuf_Write(p->Buf, b);
+      else
+        IByteOut_Write(p->Stream, b);
       temp = 0xFF;
     }
     while (--p->CacheSize != 0);
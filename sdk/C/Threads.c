@@ -3,6 +3,8 @@
 
 #include "Precomp.h"
 
+#ifdef _WIN32
+
 #ifndef UNDER_CE
 #include <process.h>
 #endif
@@ -93,3 +95,193 @@ WRes CriticalSection_Init(CCriticalSection *p)
   #endif
   return 0;
 }
+
+#else /* _WIN32 */
+
+#include <errno.h>
+
+#include "Threads.h"
+
+static void *Thread_Start(void *param)
+{
+  CThread *p = (CThread *)param;
+  return (void *)(size_t)p->_func(p->_param);
+}
+
+WRes Thread_Create(CThread *p, THREAD_FUNC_TYPE func, void *param)
+{
+  int ret;
+  p->_created = 0;
+  p->_func = func;
+  p->_param = param;
+  ret = pthread_create(&p->_tid, NULL, Thread_Start, p);
+  if (ret != 0)
+    return ret;
+  p->_created = 1;
+  return 0;
+}
+
+WRes Thread_Wait(CThread *p)
+{
+  void *thread_return;
+  int ret;
+  if (!p->_created)
+    return EINVAL;
+  ret = pthread_join(p->_tid, &thread_return);
+  /* pthread_join() can be called only once, so Thread_Close() has nothing to do */
+  p->_created = 0;
+  return ret;
+}
+
+WRes Thread_Close(CThread *p)
+{
+  if (p->_created)
+  {
+    int ret = pthread_detach(p->_tid);
+    p->_created = 0;
+    return ret;
+  }
+  return 0;
+}
+
+
+static WRes Event_Create(CEvent *p, int manualReset, int signaled)
+{
+  int ret = pthread_mutex_init(&p->_mutex, NULL);
+  if (ret != 0)
+    return ret;
+  ret = pthread_cond_init(&p->_cond, NULL);
+  if (ret != 0)
+  {
+    pthread_mutex_destroy(&p->_mutex);
+    return ret;
+  }
+  p->_manual_reset = manualReset;
+  p->_state = (signaled ? True : False);
+  p->_created = 1;
+  return 0;
+}
+
+WRes ManualResetEvent_Create(CManualResetEvent *p, int signaled) { return Event_Create(p, True, signaled); }
+WRes AutoResetEvent_Create(CAutoResetEvent *p, int signaled) { return Event_Create(p, False, signaled); }
+WRes ManualResetEvent_CreateNotSignaled(CManualResetEvent *p) { return ManualResetEvent_Create(p, 0); }
+WRes AutoResetEvent_CreateNotSignaled(CAutoResetEvent *p) { return AutoResetEvent_Create(p, 0); }
+
+WRes Event_Set(CEvent *p)
+{
+  pthread_mutex_lock(&p->_mutex);
+  p->_state = True;
+  /* a manual-reset event releases all waiters, an auto-reset event only one */
+  if (p->_manual_reset)
+    pthread_cond_broadcast(&p->_cond);
+  else
+    pthread_cond_signal(&p->_cond);
+  pthread_mutex_unlock(&p->_mutex);
+  return 0;
+}
+
+WRes Event_Reset(CEvent *p)
+{
+  pthread_mutex_lock(&p->_mutex);
+  p->_state = False;
+  pthread_mutex_unlock(&p->_mutex);
+  return 0;
+}
+
+WRes Event_Wait(CEvent *p)
+{
+  pthread_mutex_lock(&p->_mutex);
+  while (p->_state == False)
+    pthread_cond_wait(&p->_cond, &p->_mutex);
+  if (p->_manual_reset == False)
+    p->_state = False;
+  pthread_mutex_unlock(&p->_mutex);
+  return 0;
+}
+
+WRes Event_Close(CEvent *p)
+{
+  if (p->_created)
+  {
+    int ret;
+    p->_created = 0;
+    ret = pthread_mutex_destroy(&p->_mutex);
+    if (ret == 0)
+      ret = pthread_cond_destroy(&p->_cond);
+    return ret;
+  }
+  return 0;
+}
+
+
+WRes Semaphore_Create(CSemaphore *p, UInt32 initCount, UInt32 maxCount)
+{
+  int ret;
+  if (initCount > maxCount || maxCount < 1)
+    return EINVAL;
+  ret = pthread_mutex_init(&p->_mutex, NULL);
+  if (ret != 0)
+    return ret;
+  ret = pthread_cond_init(&p->_cond, NULL);
+  if (ret != 0)
+  {
+    pthread_mutex_destroy(&p->_mutex);
+    return ret;
+  }
+  p->_count = initCount;
+  p->_maxCount = maxCount;
+  p->_created = 1;
+  return 0;
+}
+
+WRes Semaphore_ReleaseN(CSemaphore *p, UInt32 releaseCount)
+{
+  UInt32 newCount;
+  if (releaseCount < 1)
+    return EINVAL;
+  pthread_mutex_lock(&p->_mutex);
+  newCount = p->_count + releaseCount;
+  if (newCount > p->_maxCount || newCount < releaseCount)
+  {
+    pthread_mutex_unlock(&p->_mutex);
+    return EINVAL;
+  }
+  p->_count = newCount;
+  pthread_cond_broadcast(&p->_cond);
+  pthread_mutex_unlock(&p->_mutex);
+  return 0;
+}
+
+WRes Semaphore_Release1(CSemaphore *p) { return Semaphore_ReleaseN(p, 1); }
+
+WRes Semaphore_Wait(CSemaphore *p)
+{
+  pthread_mutex_lock(&p->_mutex);
+  while (p->_count < 1)
+    pthread_cond_wait(&p->_cond, &p->_mutex);
+  p->_count--;
+  pthread_mutex_unlock(&p->_mutex);
+  return 0;
+}
+
+WRes Semaphore_Close(CSemaphore *p)
+{
+  if (p->_created)
+  {
+    int ret;
+    p->_created = 0;
+    ret = pthread_mutex_destroy(&p->_mutex);
+    if (ret == 0)
+      ret = pthread_cond_destroy(&p->_cond);
+    return ret;
+  }
+  return 0;
+}
+
+
+WRes CriticalSection_Init(CCriticalSection *p)
+{
+  return pthread_mutex_init(p, NULL);
+}
+
+#endif /* _WIN32 */
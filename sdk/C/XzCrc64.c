@@ -6,6 +6,11 @@
 #include "XzCrc64.h"
 #include "CpuArch.h"
 
+#if !defined(_7ZIP_ST) && !defined(_WIN32)
+  #define CRC64_GENERATE_ONCE
+  #include <pthread.h>
+#endif
+
 #define kCrc64Poly UINT64_CONST(0xC96C5795D7870F42)
 
 #ifdef MY_CPU_LE
@@ -29,9 +34,22 @@
   UInt64 MY_FAST_CALL XzCrc64UpdateT4(UInt64 v, const void *data, size_t size, const UInt64 *table);
 #endif
 
+#if defined(MY_CPU_X86_OR_AMD64) && ( \
+    (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) || \
+    defined(__clang__) || (defined(_MSC_VER) && _MSC_VER >= 1800))
+  #define CRC64_CLMUL
+  #include <wmmintrin.h>
+  #if defined(__GNUC__) || defined(__clang__)
+    #define CRC64_TARGET_CLMUL __attribute__((target("sse2,pclmul")))
+  #else
+    #define CRC64_TARGET_CLMUL
+  #endif
+#endif
+
 typedef UInt64 (MY_FAST_CALL *CRC64_FUNC)(UInt64 v, const void *data, size_t size, const UInt64 *table);
 
 static CRC64_FUNC g_Crc64Update;
+static CRC64_FUNC g_Crc64UpdateT4;
 UInt64 g_Crc64Table[256 * CRC64_NUM_TABLES];
 
 UInt64 MY_FAST_CALL Crc64Update(UInt64 v, const void *data, size_t size)
@@ -39,12 +57,105 @@ UInt64 MY_FAST_CALL Crc64Update(UInt64 v, const void *data, size_t size)
   return g_Crc64Update(v, data, size, g_Crc64Table);
 }
 
+UInt64 MY_FAST_CALL Crc64UpdateTable(UInt64 v, const void *data, size_t size)
+{
+  return g_Crc64UpdateT4(v, data, size, g_Crc64Table);
+}
+
 UInt64 MY_FAST_CALL Crc64Calc(const void *data, size_t size)
 {
   return g_Crc64Update(CRC64_INIT_VAL, data, size, g_Crc64Table) ^ CRC64_INIT_VAL;
 }
 
-void MY_FAST_CALL Crc64GenerateTable()
+#ifdef CRC64_CLMUL
+
+/*
+The data is folded 16 bytes at a time: a block (H * x^64 + L) that is
+(n) bits before the end of the processed data is replaced by the 128-bit
+value (H * x^(n + 64) + L * x^n) mod P, computed with two carry-less
+multiplications of (H) and (L) by constants.
+
+The constants are (x^k mod P) in the reflected bit order of the CRC. In that
+order the 128-bit product of two 64-bit values is shifted by one bit, so
+(k) is one less than the distance:
+  g_Crc64Fold[0, 1] : (x^575, x^511) to fold by 64 bytes
+  g_Crc64Fold[2, 3] : (x^447, x^383) to fold by 48 bytes
+  g_Crc64Fold[4, 5] : (x^319, x^255) to fold by 32 bytes
+  g_Crc64Fold[6, 7] : (x^191, x^127) to fold by 16 bytes
+*/
+
+static UInt64 g_Crc64Fold[8];
+
+/* returns (x^n mod P) for (n >= 63) */
+
+static UInt64 Crc64_GetPow(unsigned n)
+{
+  UInt64 r = 1; /* x^63 */
+  for (; n != 63; n--)
+    r = (r >> 1) ^ (kCrc64Poly & ((UInt64)0 - (r & 1)));
+  return r;
+}
+
+static void Crc64_InitFold()
+{
+  unsigned i;
+  for (i = 0; i < 4; i++)
+  {
+    unsigned dist = (4 - i) * 128;
+    g_Crc64Fold[i * 2] = Crc64_GetPow(dist + 64 - 1);
+    g_Crc64Fold[i * 2 + 1] = Crc64_GetPow(dist - 1);
+  }
+}
+
+#define CRC64_LOAD(p) _mm_loadu_si128((const __m128i *)(const void *)(p))
+
+#define CRC64_FOLD(x, k) _mm_xor_si128( \
+    _mm_clmulepi64_si128(x, k, 0x00), \
+    _mm_clmulepi64_si128(x, k, 0x11))
+
+CRC64_TARGET_CLMUL
+static UInt64 MY_FAST_CALL XzCrc64UpdateClmul(UInt64 v, const void *data, size_t size, const UInt64 *table)
+{
+  const Byte *p = (const Byte *)data;
+  __m128i x0, x1, x2, x3, k;
+  Byte buf[16];
+
+  if (size < 64)
+    return XzCrc64UpdateT4(v, data, size, table);
+
+  /* (v) is the remainder of the data before, that is XORed to the first 8 bytes */
+  x0 = _mm_xor_si128(CRC64_LOAD(p), _mm_set_epi64x(0, (Int64)v));
+  x1 = CRC64_LOAD(p + 16);
+  x2 = CRC64_LOAD(p + 32);
+  x3 = CRC64_LOAD(p + 48);
+  p += 64;
+  size -= 64;
+
+  k = CRC64_LOAD(g_Crc64Fold);
+  for (; size >= 64; size -= 64, p += 64)
+  {
+    x0 = _mm_xor_si128(CRC64_FOLD(x0, k), CRC64_LOAD(p));
+    x1 = _mm_xor_si128(CRC64_FOLD(x1, k), CRC64_LOAD(p + 16));
+    x2 = _mm_xor_si128(CRC64_FOLD(x2, k), CRC64_LOAD(p + 32));
+    x3 = _mm_xor_si128(CRC64_FOLD(x3, k), CRC64_LOAD(p + 48));
+  }
+
+  x3 = _mm_xor_si128(x3, CRC64_FOLD(x0, CRC64_LOAD(g_Crc64Fold + 2)));
+  x3 = _mm_xor_si128(x3, CRC64_FOLD(x1, CRC64_LOAD(g_Crc64Fold + 4)));
+  k = CRC64_LOAD(g_Crc64Fold + 6);
+  x3 = _mm_xor_si128(x3, CRC64_FOLD(x2, k));
+  for (; size >= 16; size -= 16, p += 16)
+    x3 = _mm_xor_si128(CRC64_FOLD(x3, k), CRC64_LOAD(p));
+
+  /* the remainder of the folded 16 bytes is the CRC of the data up to (p) */
+  _mm_storeu_si128((__m128i *)(void *)buf, x3);
+  v = XzCrc64UpdateT4(0, buf, 16, table);
+  return XzCrc64UpdateT4(v, p, size, table);
+}
+
+#endif
+
+static void Crc64_GenerateTable(void)
 {
   UInt32 i;
   for (i = 0; i < 256; i++)
@@ -63,14 +174,26 @@ void MY_FAST_CALL Crc64GenerateTable()
   
   #ifdef MY_CPU_LE
 
+  g_Crc64UpdateT4 = XzCrc64UpdateT4;
   g_Crc64Update = XzCrc64UpdateT4;
 
+  #ifdef CRC64_CLMUL
+  if (CPU_IsSupported_PCLMUL())
+  {
+    Crc64_InitFold();
+    g_Crc64Update = XzCrc64UpdateClmul;
+  }
+  #endif
+
   #else
   {
     #ifndef MY_CPU_BE
     UInt32 k = 1;
     if (*(const Byte *)&k == 1)
+    {
+      g_Crc64UpdateT4 = XzCrc64UpdateT4;
       g_Crc64Update = XzCrc64UpdateT4;
+    }
     else
     #endif
     {
@@ -79,8 +202,35 @@ void MY_FAST_CALL Crc64GenerateTable()
         UInt64 x = g_Crc64Table[(size_t)i - 256];
         g_Crc64Table[i] = CRC_UINT64_SWAP(x);
       }
+      g_Crc64UpdateT4 = XzCrc64UpdateT1_BeT4;
       g_Crc64Update = XzCrc64UpdateT1_BeT4;
     }
   }
   #endif
 }
+
+/*
+  CPUID can be slow (it traps in virtual machines), so the tables, the fold
+  constants and the function are computed only by the first call.
+  Multithreaded builds use pthread_once(), so no thread can use tables that
+  are still written by another thread.
+*/
+
+#ifdef CRC64_GENERATE_ONCE
+
+static pthread_once_t g_Crc64_Once = PTHREAD_ONCE_INIT;
+
+void MY_FAST_CALL Crc64GenerateTable()
+{
+  pthread_once(&g_Crc64_Once, Crc64_GenerateTable);
+}
+
+#else
+
+void MY_FAST_CALL Crc64GenerateTable()
+{
+  if (!g_Crc64Update)
+    Crc64_GenerateTable();
+}
+
+#endif
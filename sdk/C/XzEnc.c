@@ -959,12 +959,12 @@ static void XzEnc_Construct(CXzEnc *p)
 
   #ifndef _7ZIP_ST
   p->mtCoder_WasConstructed = False;
-  {
-    for (i = 0; i < MTCODER__BLOCKS_MAX; i++)
-      p->outBufs[i] = NULL;
-    p->outBufSize = 0;
-  }
   #endif
+
+  /* outBufs[0] is also used by the single-thread encoder for forceWriteSizesInHeader */
+  for (i = 0; i < MTCODER__BLOCKS_MAX; i++)
+    p->outBufs[i] = NULL;
+  p->outBufSize = 0;
 }
 
 
@@ -996,8 +996,8 @@ static void XzEnc_Free(CXzEnc *p, ISzAllocPtr alloc)
     MtCoder_Destruct(&p->mtCoder);
     p->mtCoder_WasConstructed = False;
   }
-  XzEnc_FreeOutBufs(p);
   #endif
+  XzEnc_FreeOutBufs(p);
 }
 
 
@@ -0,0 +1,251 @@
+/* XzEncTune.c -- Block size selection for XzEnc
+2019-12-02 : Public domain */
+
+#include "Precomp.h"
+
+#include <string.h>
+
+#include "XzEncTune.h"
+
+void XzEncTuneProps_Init(CXzEncTuneProps *p)
+{
+  p->numThreads = 4;
+  p->maxLoss = 10;
+  p->minBlockSize = (UInt64)1 << 18;
+  p->maxBlockSize = (UInt64)1 << 26;
+  p->sampleSize = (UInt64)1 << 22;
+  p->numSlices = 2;
+}
+
+
+typedef struct
+{
+  ISeqInStream vt;
+  const Byte *data;
+  size_t rem;
+} CXzEncTuneInStream;
+
+static SRes XzEncTuneInStream_Read(const ISeqInStream *pp, void *buf, size_t *size)
+{
+  CXzEncTuneInStream *p = CONTAINER_FROM_VTBL(pp, CXzEncTuneInStream, vt);
+  size_t cur = *size;
+  if (cur > p->rem)
+    cur = p->rem;
+  if (cur != 0)
+    memcpy(buf, p->data, cur);
+  p->data += cur;
+  p->rem -= cur;
+  *size = cur;
+  return SZ_OK;
+}
+
+/* counts the written bytes */
+
+typedef struct
+{
+  ISeqOutStream vt;
+  UInt64 processed;
+} CXzEncTuneSizeStream;
+
+static size_t XzEncTuneSizeStream_Write(const ISeqOutStream *pp, const void *data, size_t size)
+{
+  CXzEncTuneSizeStream *p = CONTAINER_FROM_VTBL(pp, CXzEncTuneSizeStream, vt);
+  UNUSED_VAR(data);
+  p->processed += size;
+  return size;
+}
+
+
+/* returns the size of the xz file of (data) with (blockSize) */
+
+static SRes XzEncTune_GetPackSize(const CXzProps *props, UInt64 blockSize,
+    const Byte *data, size_t size, UInt64 *packSize,
+    ISzAllocPtr alloc, ISzAllocPtr allocBig)
+{
+  CXzProps props2 = *props;
+  CXzEncTuneInStream inStream;
+  CXzEncTuneSizeStream outStream;
+  CXzEncHandle enc;
+  SRes res;
+
+  props2.blockSize = blockSize;
+  props2.forceWriteSizesInHeader = 1;
+  props2.reduceSize = size;
+
+  inStream.vt.Read = XzEncTuneInStream_Read;
+  inStream.data = data;
+  inStream.rem = size;
+  outStream.vt.Write = XzEncTuneSizeStream_Write;
+  outStream.processed = 0;
+
+  enc = XzEnc_Create(alloc, allocBig);
+  if (!enc)
+    return SZ_ERROR_MEM;
+  res = XzEnc_SetProps(enc, &props2);
+  if (res == SZ_OK)
+  {
+    XzEnc_SetDataSize(enc, size);
+    res = XzEnc_Encode(enc, &outStream.vt, &inStream.vt, NULL);
+  }
+  XzEnc_Destroy(enc);
+  *packSize = outStream.processed;
+  return res;
+}
+
+
+static UInt64 XzEncTune_GetNumBlocks(UInt64 size, UInt64 blockSize)
+{
+  return size / blockSize + (size % blockSize != 0 ? 1 : 0);
+}
+
+
+static BoolInt XzEncTune_IsInLoss(const CXzEncTuneCandidate *c, UInt64 solidPackSize, UInt32 maxLoss)
+{
+  if (c->packSize <= solidPackSize)
+    return True;
+  return (c->packSize - solidPackSize) * 1000 <= (UInt64)maxLoss * solidPackSize;
+}
+
+
+SRes XzEnc_TuneBlockSize(CXzProps *props, const CXzEncTuneProps *tuneProps,
+    const Byte *data, size_t size, UInt64 dataSize, CXzEncTuneResult *result,
+    ISzAllocPtr alloc, ISzAllocPtr allocBig)
+{
+  CXzEncTuneCandidate *cands = result->candidates;
+  UInt64 bound = 0;  /* the largest block size for (numThreads) blocks of (dataSize) */
+  size_t sliceSize;
+  unsigned numSlices, s, i, num = 0, sel;
+
+  if (tuneProps->numThreads == 0
+      || tuneProps->minBlockSize == 0
+      || tuneProps->minBlockSize > tuneProps->maxBlockSize
+      || tuneProps->maxBlockSize >= ((UInt64)1 << 62)
+      || tuneProps->sampleSize == 0
+      || tuneProps->numSlices == 0)
+    return SZ_ERROR_PARAM;
+
+  if (dataSize != (UInt64)(Int64)-1)
+    bound = XzEncTune_GetNumBlocks(dataSize, tuneProps->numThreads);
+
+  {
+    UInt64 c;
+    for (c = tuneProps->minBlockSize; num < XZ_ENC_TUNE_CANDIDATES_MAX; c <<= 1)
+    {
+      if (bound > (c >> 1) && bound < c && bound >= tuneProps->minBlockSize && num < XZ_ENC_TUNE_CANDIDATES_MAX - 1)
+        cands[num++].blockSize = bound;
+      cands[num++].blockSize = c;
+      if (c > (tuneProps->maxBlockSize >> 1))
+        break;
+    }
+    if (bound > cands[num - 1].blockSize && bound <= tuneProps->maxBlockSize && num < XZ_ENC_TUNE_CANDIDATES_MAX)
+      cands[num++].blockSize = bound;
+  }
+  for (i = 0; i < num; i++)
+  {
+    cands[i].packSize = 0;
+    cands[i].measured = True;
+  }
+
+  if (size <= tuneProps->sampleSize)
+  {
+    numSlices = 1;
+    sliceSize = size;
+  }
+  else
+  {
+    numSlices = tuneProps->numSlices;
+    sliceSize = (size_t)(tuneProps->sampleSize / numSlices);
+    if (sliceSize == 0)
+    {
+      numSlices = 1;
+      sliceSize = (size_t)tuneProps->sampleSize;
+    }
+  }
+
+  result->sampleSize = 0;
+  result->solidPackSize = 0;
+
+  for (s = 0; s < numSlices; s++)
+  {
+    const Byte *slice = data;
+    UInt64 solidPackSize;
+    UInt64 boundaryCost = 0;  /* of the largest measured candidate */
+
+    if (sliceSize == 0)
+      break;
+    if (numSlices > 1)
+      slice += (size_t)((UInt64)(size - sliceSize) * s / (numSlices - 1));
+
+    RINOK(XzEncTune_GetPackSize(props, XZ_PROPS__BLOCK_SIZE__SOLID, slice, sliceSize, &solidPackSize, alloc, allocBig));
+    result->sampleSize += sliceSize;
+    result->solidPackSize += solidPackSize;
+
+    for (i = 0; i < num; i++)
+    {
+      CXzEncTuneCandidate *c = &cands[i];
+      UInt64 packSize;
+      if (c->blockSize < sliceSize)
+      {
+        UInt64 numBoundaries = XzEncTune_GetNumBlocks(sliceSize, c->blockSize) - 1;
+        RINOK(XzEncTune_GetPackSize(props, c->blockSize, slice, sliceSize, &packSize, alloc, allocBig));
+        boundaryCost = (packSize > solidPackSize ? (packSize - solidPackSize) / numBoundaries : 0);
+      }
+      else if (sliceSize == dataSize)
+      {
+        /* the sample is the whole input, that is one block */
+        packSize = solidPackSize;
+      }
+      else
+      {
+        /* (sliceSize / blockSize) block boundaries are in such slice on average */
+        packSize = solidPackSize + boundaryCost * sliceSize / c->blockSize;
+        c->measured = False;
+      }
+      c->packSize += packSize;
+    }
+  }
+
+  for (i = 0; i < num; i++)
+  {
+    CXzEncTuneCandidate *c = &cands[i];
+    c->loss = 0;
+    if (c->packSize > result->solidPackSize)
+      c->loss = (UInt32)((c->packSize - result->solidPackSize) * 1000 / result->solidPackSize);
+  }
+  result->numCandidates = num;
+
+  sel = num;
+  if (bound != 0)
+  {
+    for (i = num; i != 0;)
+    {
+      i--;
+      if (cands[i].blockSize <= bound && XzEncTune_IsInLoss(&cands[i], result->solidPackSize, tuneProps->maxLoss))
+      {
+        sel = i;
+        break;
+      }
+    }
+  }
+  if (sel == num)
+    for (i = 0; i < num; i++)
+      if (XzEncTune_IsInLoss(&cands[i], result->solidPackSize, tuneProps->maxLoss))
+      {
+        sel = i;
+        break;
+      }
+  if (sel == num)
+    sel = num - 1;
+
+  result->blockSize = cands[sel].blockSize;
+  result->loss = cands[sel].loss;
+  result->numBlocks = 0;
+  if (dataSize != (UInt64)(Int64)-1)
+    result->numBlocks = XzEncTune_GetNumBlocks(dataSize, result->blockSize);
+  result->targetReached = XzEncTune_IsInLoss(&cands[sel], result->solidPackSize, tuneProps->maxLoss)
+      && (dataSize == (UInt64)(Int64)-1 || result->numBlocks >= tuneProps->numThreads);
+
+  props->blockSize = result->blockSize;
+  props->forceWriteSizesInHeader = 1;
+  return SZ_OK;
+}
@@ -0,0 +1,93 @@
+/* XzEncTune.h -- Block size selection for XzEnc
+2019-12-02 : Public domain */
+
+#ifndef __XZ_ENC_TUNE_H
+#define __XZ_ENC_TUNE_H
+
+#include "XzEnc.h"
+
+EXTERN_C_BEGIN
+
+/*
+XzProps_Init() selects one solid block (or blocks for the encoder threads
+only), so XzDecMt can't decode the file in parallel. XzEnc_TuneBlockSize()
+selects the block size from a target: the file should have at least
+(numThreads) blocks and lose at most (maxLoss) of the compression ratio.
+
+The loss is measured on a sample of the input: (numSlices) slices at the
+same distance, (sampleSize) bytes in total. Every slice is encoded as one
+block and with each candidate block size that is smaller than the slice.
+For larger block sizes the loss is estimated from the cost of one block
+boundary with the largest measured candidate (unless the sample is the whole
+input, then a larger block is the same as one block). So tuning costs about as
+much as encoding (sampleSize) bytes (1 + numMeasured) times.
+*/
+
+#define XZ_ENC_TUNE_CANDIDATES_MAX 32
+
+typedef struct
+{
+  unsigned numThreads;    /* decoder threads the file should be split for */
+  UInt32 maxLoss;         /* max loss of the compression ratio in 1/1000 */
+  UInt64 minBlockSize;    /* the candidates are (minBlockSize << i) */
+  UInt64 maxBlockSize;
+  UInt64 sampleSize;
+  unsigned numSlices;
+} CXzEncTuneProps;
+
+void XzEncTuneProps_Init(CXzEncTuneProps *p);
+
+typedef struct
+{
+  UInt64 blockSize;
+  UInt64 packSize;        /* packed size of the sample */
+  UInt32 loss;            /* in 1/1000 */
+  BoolInt measured;       /* False, if (packSize) is estimated */
+} CXzEncTuneCandidate;
+
+typedef struct
+{
+  UInt64 blockSize;       /* the selected block size */
+  UInt64 numBlocks;       /* blocks of (dataSize), 0 if (dataSize) is unknown */
+  UInt32 loss;            /* estimated loss of (blockSize) in 1/1000 */
+  BoolInt targetReached;  /* (loss <= maxLoss) and (numBlocks >= numThreads), if known */
+
+  UInt64 sampleSize;
+  UInt64 solidPackSize;   /* packed size of the slices as one block each */
+  unsigned numCandidates;
+  CXzEncTuneCandidate candidates[XZ_ENC_TUNE_CANDIDATES_MAX];  /* by block size */
+} CXzEncTuneResult;
+
+/*
+XzEnc_TuneBlockSize() selects the block size for (props) with the sample
+  (data, size), that is the input or a part of it. (props) must contain the
+  other properties of the encoder (level, filter, check, threads).
+  (dataSize) is the size of the input, or (UInt64)(Int64)-1 if unknown.
+
+  The block size is:
+  - the largest candidate with (loss <= maxLoss) that gives at least
+    (numThreads) blocks of (dataSize) (or the smallest candidate with
+    (loss <= maxLoss) if (dataSize) is unknown), else
+  - the smallest candidate with (loss <= maxLoss), it gives fewer blocks, else
+  - the largest candidate.
+  A candidate of exactly (dataSize / numThreads) (rounded up) is added if
+  it's between (minBlockSize) and (maxBlockSize).
+
+  On success (props->blockSize) is set to the selected block size and
+  (props->forceWriteSizesInHeader) is set, so XzDecMt can decode the blocks
+  in parallel also if the file was encoded with one thread.
+
+Returns:
+  SZ_OK
+  SZ_ERROR_PARAM       - incorrect (tuneProps)
+  SZ_ERROR_MEM         - memory allocation error
+  the errors of XzEnc_Encode()
+*/
+
+SRes XzEnc_TuneBlockSize(CXzProps *props, const CXzEncTuneProps *tuneProps,
+    const Byte *data, size_t size, UInt64 dataSize, CXzEncTuneResult *result,
+    ISzAllocPtr alloc, ISzAllocPtr allocBig);
+
+EXTERN_C_END
+
+#endif
@@ -0,0 +1,704 @@
+/* XzSeek.c -- Random access reader for xz files
+2019-12-02 : Public domain */
+
+#include "Precomp.h"
+
+#include <string.h>
+
+#include "XzSeek.h"
+
+#ifndef _7ZIP_ST
+#include "Threads.h"
+#endif
+
+#define XZ_SEEK_LOOK_SIZE (1 << 16)
+#define XZ_SEEK_SKIP_BUF_SIZE (1 << 16)
+
+static void XzSeekDecoder_Construct(CXzSeekDecoder *d)
+{
+  d->created = False;
+  d->skipBuf = NULL;
+}
+
+static void XzSeekDecoder_Free(CXzSeekDecoder *d, ISzAllocPtr alloc)
+{
+  ISzAlloc_Free(alloc, d->skipBuf);
+  d->skipBuf = NULL;
+  if (d->created)
+  {
+    XzUnpacker_Free(&d->dec);
+    d->created = False;
+  }
+}
+
+#ifndef _7ZIP_ST
+static void XzSeek_FreeMt(CXzSeek *p);
+#endif
+
+void XzSeek_Construct(CXzSeek *p, ISzAllocPtr alloc, ISzAllocPtr allocBig)
+{
+  unsigned i;
+  p->alloc = alloc;
+  p->allocBig = allocBig;
+  p->inStream = NULL;
+  p->numBlocks = 0;
+  p->blocks = NULL;
+  p->unpackSize = 0;
+  p->numCacheBlocks = 0;
+  p->cacheBlockSizeMax = 0;
+  p->useCounter = 0;
+  for (i = 0; i < XZ_SEEK_CACHE_BLOCKS_MAX; i++)
+  {
+    p->cache[i].blockIndex = 0;
+    p->cache[i].lastUse = 0;
+    p->cache[i].data = NULL;
+    p->cache[i].allocSize = 0;
+  }
+  XzSeekDecoder_Construct(&p->decoder);
+  p->mt = NULL;
+  p->numDecodedBlocks = 0;
+  p->numCacheHits = 0;
+}
+
+void XzSeek_Free(CXzSeek *p)
+{
+  unsigned i;
+  for (i = 0; i < XZ_SEEK_CACHE_BLOCKS_MAX; i++)
+  {
+    CXzSeekCacheItem *item = &p->cache[i];
+    ISzAlloc_Free(p->allocBig, item->data);
+    item->data = NULL;
+    item->allocSize = 0;
+  }
+  p->numCacheBlocks = 0;
+  ISzAlloc_Free(p->alloc, p->blocks);
+  p->blocks = NULL;
+  p->numBlocks = 0;
+  p->unpackSize = 0;
+  XzSeekDecoder_Free(&p->decoder, p->alloc);
+  #ifndef _7ZIP_ST
+  XzSeek_FreeMt(p);
+  #endif
+  p->inStream = NULL;
+}
+
+
+static SRes XzSeek_SetBlocks(CXzSeek *p, const CXzs *xzs)
+{
+  UInt64 numBlocks = Xzs_GetNumBlocks(xzs);
+  UInt64 unpackPos = 0;
+  size_t i, k = 0;
+
+  if (Xzs_GetUnpackSize(xzs) == XZ_SIZE_OVERFLOW)
+    return SZ_ERROR_UNSUPPORTED;
+  if (numBlocks > ((size_t)0 - 1) / sizeof(CXzSeekBlock))
+    return SZ_ERROR_MEM;
+  if (numBlocks != 0)
+  {
+    p->blocks = (CXzSeekBlock *)ISzAlloc_Alloc(p->alloc, (size_t)numBlocks * sizeof(CXzSeekBlock));
+    if (!p->blocks)
+      return SZ_ERROR_MEM;
+  }
+
+  /* Xzs_ReadBackward() returns the streams from the last to the first */
+  for (i = xzs->num; i != 0;)
+  {
+    const CXzStream *s = &xzs->streams[--i];
+    UInt64 packPos = (UInt64)s->startOffset + XZ_STREAM_HEADER_SIZE;
+    size_t j;
+    for (j = 0; j < s->numBlocks; j++)
+    {
+      CXzSeekBlock *b = &p->blocks[k++];
+      b->unpackPos = unpackPos;
+      b->unpackSize = s->blocks[j].unpackSize;
+      b->packPos = packPos;
+      b->totalSize = s->blocks[j].totalSize;
+      b->flags = s->flags;
+      unpackPos += b->unpackSize;
+      packPos += (b->totalSize + 3) & ~(UInt64)3;
+    }
+  }
+
+  p->numBlocks = k;
+  p->unpackSize = unpackPos;
+  return SZ_OK;
+}
+
+
+SRes XzSeek_Open(CXzSeek *p, ILookInStream *inStream, unsigned numCacheBlocks, size_t cacheBlockSizeMax)
+{
+  CXzs xzs;
+  Int64 startOffset = 0;
+  SRes res;
+  unsigned i;
+
+  XzSeek_Free(p);
+
+  Xzs_Construct(&xzs);
+  res = Xzs_ReadBackward(&xzs, inStream, &startOffset, NULL, p->alloc);
+  if (res == SZ_OK)
+    res = XzSeek_SetBlocks(p, &xzs);
+  Xzs_Free(&xzs, p->alloc);
+  if (res != SZ_OK)
+  {
+    XzSeek_Free(p);
+    return res;
+  }
+
+  if (numCacheBlocks > XZ_SEEK_CACHE_BLOCKS_MAX)
+    numCacheBlocks = XZ_SEEK_CACHE_BLOCKS_MAX;
+  p->numCacheBlocks = numCacheBlocks;
+  p->cacheBlockSizeMax = cacheBlockSizeMax;
+  p->useCounter = 0;
+  for (i = 0; i < XZ_SEEK_CACHE_BLOCKS_MAX; i++)
+  {
+    p->cache[i].blockIndex = p->numBlocks;
+    p->cache[i].lastUse = 0;
+  }
+  p->inStream = inStream;
+  return SZ_OK;
+}
+
+
+/* returns the index of the last block with (unpackPos <= offset) */
+
+static size_t XzSeek_FindBlock(const CXzSeek *p, UInt64 offset)
+{
+  size_t left = 0, right = p->numBlocks;
+  while (left != right)
+  {
+    size_t mid = left + (right - left) / 2;
+    if (p->blocks[mid].unpackPos <= offset)
+      left = mid + 1;
+    else
+      right = mid;
+  }
+  return left - 1;
+}
+
+
+/*
+XzSeekDecoder_Decode() decodes the bytes [skip, skip + size) of the block at
+  (packPos) of (inStream) to (dest).
+  If the range ends at the end of the block, the block is decoded until its
+  end and the check and the sizes of the block are verified.
+  The skipped bytes are decoded to (skipBuf) with CODER_FINISH_ANY, since
+  CODER_FINISH_END requires the end of the block at the end of the output.
+  If the range is the whole block, the LZMA2 decoder uses (dest) as its
+  dictionary (XzUnpacker_SetOutBuf()), so no data is copied.
+*/
+
+static SRes XzSeekDecoder_Decode(CXzSeekDecoder *d, ISzAllocPtr alloc, ILookInStream *inStream, UInt64 packPos,
+    const CXzSeekBlock *b, UInt64 skip, Byte *dest, size_t size)
+{
+  CXzUnpacker *dec = &d->dec;
+  BoolInt toEnd = (skip + size == b->unpackSize);
+  BoolInt outBufMode = (toEnd && skip == 0);
+  UInt64 packRem = (b->totalSize + 3) & ~(UInt64)3;
+  size_t written = 0;
+
+  if (!d->created)
+  {
+    XzUnpacker_Construct(dec, alloc);
+    d->created = True;
+  }
+  if (skip != 0 && !d->skipBuf)
+  {
+    d->skipBuf = (Byte *)ISzAlloc_Alloc(alloc, XZ_SEEK_SKIP_BUF_SIZE);
+    if (!d->skipBuf)
+      return SZ_ERROR_MEM;
+  }
+
+  XzUnpacker_Init(dec);
+  dec->streamFlags = b->flags;
+  XzUnpacker_PrepareToRandomBlockDecoding(dec);
+  XzUnpacker_SetOutBuf(dec, outBufMode ? dest : NULL, outBufMode ? size : 0);
+
+  RINOK(LookInStream_SeekTo(inStream, packPos));
+
+  for (;;)
+  {
+    const void *inBuf;
+    size_t inSize = XZ_SEEK_LOOK_SIZE;
+    SizeT inProcessed, outProcessed;
+    Byte *outBuf;
+    BoolInt skipping = (skip != 0);
+    ECoderStatus status;
+    SRes res;
+
+    if (inSize > packRem)
+      inSize = (size_t)packRem;
+    RINOK(ILookInStream_Look(inStream, &inBuf, &inSize));
+
+    if (skipping)
+    {
+      outBuf = d->skipBuf;
+      outProcessed = (skip < XZ_SEEK_SKIP_BUF_SIZE ? (SizeT)skip : XZ_SEEK_SKIP_BUF_SIZE);
+    }
+    else
+    {
+      outBuf = (outBufMode ? NULL : dest + written);
+      outProcessed = size - written;
+    }
+    inProcessed = inSize;
+
+    res = XzUnpacker_Code(dec, outBuf, &outProcessed, (const Byte *)inBuf, &inProcessed,
+        inSize == packRem, (toEnd && !skipping) ? CODER_FINISH_END : CODER_FINISH_ANY, &status);
+
+    RINOK(ILookInStream_Skip(inStream, inProcessed));
+    packRem -= inProcessed;
+    if (skipping)
+      skip -= outProcessed;
+    else
+      written += outProcessed;
+    RINOK(res);
+
+    if (status == CODER_STATUS_FINISHED_WITH_MARK)
+    {
+      if (skip != 0
+          || written != size
+          || dec->unpackSize != b->unpackSize
+          || XzUnpacker_GetPackSizeForIndex(dec) != b->totalSize)
+        return SZ_ERROR_DATA;
+      return SZ_OK;
+    }
+    if (!toEnd && skip == 0 && written == size)
+      return SZ_OK;
+    if (inProcessed == 0 && outProcessed == 0)
+      return (packRem != 0 && inSize == 0) ? SZ_ERROR_INPUT_EOF : SZ_ERROR_DATA;
+  }
+}
+
+
+/* returns the decoded data of the block from the cache, or decodes it into the least recently used item */
+
+static SRes XzSeek_GetCachedBlock(CXzSeek *p, size_t blockIndex, const Byte **data)
+{
+  const CXzSeekBlock *b = &p->blocks[blockIndex];
+  CXzSeekCacheItem *item = &p->cache[0];
+  unsigned i;
+  SRes res;
+
+  for (i = 0; i < p->numCacheBlocks; i++)
+  {
+    CXzSeekCacheItem *cur = &p->cache[i];
+    if (cur->blockIndex == blockIndex)
+    {
+      cur->lastUse = ++p->useCounter;
+      p->numCacheHits++;
+      *data = cur->data;
+      return SZ_OK;
+    }
+    if (cur->lastUse < item->lastUse)
+      item = cur;
+  }
+
+  item->blockIndex = p->numBlocks;
+  if (item->allocSize < b->unpackSize)
+  {
+    ISzAlloc_Free(p->allocBig, item->data);
+    item->allocSize = 0;
+    item->data = (Byte *)ISzAlloc_Alloc(p->allocBig, (size_t)b->unpackSize);
+    if (!item->data)
+      return SZ_ERROR_MEM;
+    item->allocSize = (size_t)b->unpackSize;
+  }
+
+  p->numDecodedBlocks++;
+  res = XzSeekDecoder_Decode(&p->decoder, p->alloc, p->inStream, b->packPos, b, 0, item->data, (size_t)b->unpackSize);
+  if (res != SZ_OK)
+    return res;
+  item->blockIndex = blockIndex;
+  item->lastUse = ++p->useCounter;
+  *data = item->data;
+  return SZ_OK;
+}
+
+
+SRes XzSeek_Read(CXzSeek *p, UInt64 offset, Byte *dest, size_t *size)
+{
+  size_t rem = *size;
+  size_t blockIndex;
+
+  *size = 0;
+  if (offset >= p->unpackSize || rem == 0)
+    return SZ_OK;
+
+  blockIndex = XzSeek_FindBlock(p, offset);
+
+  while (rem != 0 && blockIndex < p->numBlocks)
+  {
+    const CXzSeekBlock *b = &p->blocks[blockIndex++];
+    UInt64 skip = offset - b->unpackPos;
+    size_t cur = rem;
+
+    /* empty blocks are skipped */
+    if (skip >= b->unpackSize)
+      continue;
+    if (cur > b->unpackSize - skip)
+      cur = (size_t)(b->unpackSize - skip);
+
+    if (p->numCacheBlocks != 0 && b->unpackSize <= p->cacheBlockSizeMax)
+    {
+      const Byte *data;
+      RINOK(XzSeek_GetCachedBlock(p, blockIndex - 1, &data));
+      memcpy(dest, data + (size_t)skip, cur);
+    }
+    else
+    {
+      p->numDecodedBlocks++;
+      RINOK(XzSeekDecoder_Decode(&p->decoder, p->alloc, p->inStream, b->packPos, b, skip, dest, cur));
+    }
+
+    dest += cur;
+    offset += cur;
+    rem -= cur;
+    *size += cur;
+  }
+
+  return SZ_OK;
+}
+
+
+#ifndef _7ZIP_ST
+
+/* ILookInStream for the packed data of the blocks in memory, every thread has its own position */
+
+typedef struct
+{
+  ILookInStream vt;
+  const Byte *data;
+  size_t size;
+  size_t pos;
+} CXzSeekBufStream;
+
+static SRes XzSeekBufStream_Look(const ILookInStream *pp, const void **buf, size_t *size)
+{
+  CXzSeekBufStream *p = CONTAINER_FROM_VTBL(pp, CXzSeekBufStream, vt);
+  size_t rem = p->size - p->pos;
+  if (*size > rem)
+    *size = rem;
+  *buf = p->data + p->pos;
+  return SZ_OK;
+}
+
+static SRes XzSeekBufStream_Skip(const ILookInStream *pp, size_t offset)
+{
+  CXzSeekBufStream *p = CONTAINER_FROM_VTBL(pp, CXzSeekBufStream, vt);
+  if (offset > p->size - p->pos)
+    return SZ_ERROR_READ;
+  p->pos += offset;
+  return SZ_OK;
+}
+
+static SRes XzSeekBufStream_Read(const ILookInStream *pp, void *buf, size_t *size)
+{
+  const void *lookBuf;
+  RINOK(XzSeekBufStream_Look(pp, &lookBuf, size));
+  if (*size != 0)
+    memcpy(buf, lookBuf, *size);
+  return XzSeekBufStream_Skip(pp, *size);
+}
+
+static SRes XzSeekBufStream_Seek(const ILookInStream *pp, Int64 *pos, ESzSeek origin)
+{
+  CXzSeekBufStream *p = CONTAINER_FROM_VTBL(pp, CXzSeekBufStream, vt);
+  Int64 base;
+  switch (origin)
+  {
+    case SZ_SEEK_SET: base = 0; break;
+    case SZ_SEEK_CUR: base = (Int64)p->pos; break;
+    case SZ_SEEK_END: base = (Int64)p->size; break;
+    default: return SZ_ERROR_PARAM;
+  }
+  if (*pos < -base || *pos > (Int64)p->size - base)
+    return SZ_ERROR_PARAM;
+  *pos += base;
+  p->pos = (size_t)*pos;
+  return SZ_OK;
+}
+
+
+typedef struct
+{
+  struct CXzSeekMt_ *mt;
+  CXzSeekDecoder decoder;
+  CXzSeekBufStream inStream;
+  UInt64 numDecodedBlocks;
+
+  BoolInt stop;
+  CThread thread;
+  CAutoResetEvent startEvent;
+  CAutoResetEvent finishedEvent;
+} CXzSeekThread;
+
+typedef struct CXzSeekMt_
+{
+  CXzSeek *seek;
+  unsigned numCreatedThreads;
+  CCriticalSection cs;
+
+  Byte *inBuf;            /* packed data of the blocks of the range */
+  size_t inBufAllocSize;
+  UInt64 inBufPos;        /* position of (inBuf) in the file */
+
+  UInt64 offset;
+  Byte *dest;
+  size_t size;
+  size_t nextBlock;
+  size_t limBlock;
+  SRes res;
+
+  CXzSeekThread threads[XZ_SEEK_THREADS_MAX];
+} CXzSeekMt;
+
+
+static void XzSeekMt_Work(CXzSeekMt *mt, CXzSeekThread *t)
+{
+  const CXzSeek *p = mt->seek;
+
+  for (;;)
+  {
+    const CXzSeekBlock *b;
+    UInt64 skip = 0, end;
+    size_t i;
+    SRes res;
+
+    CriticalSection_Enter(&mt->cs);
+    i = mt->nextBlock;
+    if (i < mt->limBlock)
+      mt->nextBlock = i + 1;
+    CriticalSection_Leave(&mt->cs);
+
+    if (i >= mt->limBlock)
+      return;
+
+    b = &p->blocks[i];
+    if (mt->offset > b->unpackPos)
+      skip = mt->offset - b->unpackPos;
+    end = mt->offset + mt->size - b->unpackPos;
+    if (end > b->unpackSize)
+      end = b->unpackSize;
+    /* empty blocks are skipped */
+    if (skip >= end)
+      continue;
+
+    t->numDecodedBlocks++;
+    res = XzSeekDecoder_Decode(&t->decoder, p->alloc, &t->inStream.vt, b->packPos - mt->inBufPos,
+        b, skip, mt->dest + (size_t)(b->unpackPos + skip - mt->offset), (size_t)(end - skip));
+
+    if (res != SZ_OK)
+    {
+      /* the other threads stop after their current block */
+      CriticalSection_Enter(&mt->cs);
+      if (mt->res == SZ_OK)
+        mt->res = res;
+      mt->nextBlock = mt->limBlock;
+      CriticalSection_Leave(&mt->cs);
+      return;
+    }
+  }
+}
+
+
+static THREAD_FUNC_RET_TYPE THREAD_FUNC_CALL_TYPE XzSeekMt_ThreadFunc(void *pp)
+{
+  CXzSeekThread *t = (CXzSeekThread *)pp;
+  for (;;)
+  {
+    if (Event_Wait(&t->startEvent) != 0)
+      return SZ_ERROR_THREAD;
+    if (t->stop)
+      return 0;
+    XzSeekMt_Work(t->mt, t);
+    if (Event_Set(&t->finishedEvent) != 0)
+      return SZ_ERROR_THREAD;
+  }
+}
+
+
+static WRes XzSeekThread_Create(CXzSeekThread *t)
+{
+  WRes wres = AutoResetEvent_CreateNotSignaled(&t->startEvent);
+  if (wres == 0)
+    wres = AutoResetEvent_CreateNotSignaled(&t->finishedEvent);
+  if (wres == 0)
+  {
+    t->stop = False;
+    wres = Thread_Create(&t->thread, XzSeekMt_ThreadFunc, t);
+  }
+  return wres;
+}
+
+
+static void XzSeekThread_Destruct(CXzSeekThread *t)
+{
+  if (Thread_WasCreated(&t->thread))
+  {
+    t->stop = True;
+    Event_Set(&t->startEvent);
+    Thread_Wait(&t->thread);
+    Thread_Close(&t->thread);
+  }
+  Event_Close(&t->startEvent);
+  Event_Close(&t->finishedEvent);
+}
+
+
+static SRes XzSeek_CreateMt(CXzSeek *p)
+{
+  CXzSeekMt *mt = (CXzSeekMt *)ISzAlloc_Alloc(p->alloc, sizeof(CXzSeekMt));
+  unsigned i;
+  if (!mt)
+    return SZ_ERROR_MEM;
+  if (CriticalSection_Init(&mt->cs) != 0)
+  {
+    ISzAlloc_Free(p->alloc, mt);
+    return SZ_ERROR_THREAD;
+  }
+
+  mt->seek = p;
+  /* threads[0] is the calling thread */
+  mt->numCreatedThreads = 1;
+  mt->inBuf = NULL;
+  mt->inBufAllocSize = 0;
+
+  for (i = 0; i < XZ_SEEK_THREADS_MAX; i++)
+  {
+    CXzSeekThread *t = &mt->threads[i];
+    t->mt = mt;
+    XzSeekDecoder_Construct(&t->decoder);
+    t->inStream.vt.Look = XzSeekBufStream_Look;
+    t->inStream.vt.Skip = XzSeekBufStream_Skip;
+    t->inStream.vt.Read = XzSeekBufStream_Read;
+    t->inStream.vt.Seek = XzSeekBufStream_Seek;
+    t->stop = False;
+    Thread_Construct(&t->thread);
+    Event_Construct(&t->startEvent);
+    Event_Construct(&t->finishedEvent);
+  }
+
+  p->mt = mt;
+  return SZ_OK;
+}
+
+
+static void XzSeek_FreeMt(CXzSeek *p)
+{
+  CXzSeekMt *mt = p->mt;
+  unsigned i;
+  if (!mt)
+    return;
+
+  for (i = 0; i < XZ_SEEK_THREADS_MAX; i++)
+  {
+    CXzSeekThread *t = &mt->threads[i];
+    XzSeekThread_Destruct(t);
+    XzSeekDecoder_Free(&t->decoder, p->alloc);
+  }
+  CriticalSection_Delete(&mt->cs);
+  ISzAlloc_Free(p->allocBig, mt->inBuf);
+  ISzAlloc_Free(p->alloc, mt);
+  p->mt = NULL;
+}
+
+#endif
+
+
+SRes XzSeek_ReadMt(CXzSeek *p, UInt64 offset, Byte *dest, size_t *size, unsigned numThreads)
+{
+  #ifdef _7ZIP_ST
+
+  UNUSED_VAR(numThreads);
+  return XzSeek_Read(p, offset, dest, size);
+
+  #else
+
+  CXzSeekMt *mt;
+  size_t rem = *size;
+  size_t first, lim;
+  UInt64 packSize;
+  unsigned i, numStarted;
+
+  if (offset >= p->unpackSize || rem == 0 || numThreads <= 1)
+    return XzSeek_Read(p, offset, dest, size);
+  if (rem > p->unpackSize - offset)
+    rem = (size_t)(p->unpackSize - offset);
+
+  first = XzSeek_FindBlock(p, offset);
+  lim = XzSeek_FindBlock(p, offset + rem - 1) + 1;
+  if (lim - first <= 1)
+    return XzSeek_Read(p, offset, dest, size);
+
+  if (numThreads > XZ_SEEK_THREADS_MAX)
+    numThreads = XZ_SEEK_THREADS_MAX;
+  if (numThreads > lim - first)
+    numThreads = (unsigned)(lim - first);
+
+  *size = 0;
+  if (!p->mt)
+  {
+    RINOK(XzSeek_CreateMt(p));
+  }
+  mt = p->mt;
+
+  for (; mt->numCreatedThreads < numThreads; mt->numCreatedThreads++)
+    if (XzSeekThread_Create(&mt->threads[mt->numCreatedThreads]) != 0)
+    {
+      XzSeekThread_Destruct(&mt->threads[mt->numCreatedThreads]);
+      return SZ_ERROR_THREAD;
+    }
+
+  /* the range of the file includes the indexes and headers of streams between the blocks */
+  {
+    const CXzSeekBlock *b = &p->blocks[lim - 1];
+    mt->inBufPos = p->blocks[first].packPos;
+    packSize = b->packPos + ((b->totalSize + 3) & ~(UInt64)3) - mt->inBufPos;
+  }
+  if (packSize != (size_t)packSize)
+    return SZ_ERROR_MEM;
+  if (mt->inBufAllocSize < packSize)
+  {
+    ISzAlloc_Free(p->allocBig, mt->inBuf);
+    mt->inBufAllocSize = 0;
+    mt->inBuf = (Byte *)ISzAlloc_Alloc(p->allocBig, (size_t)packSize);
+    if (!mt->inBuf)
+      return SZ_ERROR_MEM;
+    mt->inBufAllocSize = (size_t)packSize;
+  }
+  RINOK(LookInStream_SeekTo(p->inStream, mt->inBufPos));
+  RINOK(LookInStream_Read(p->inStream, mt->inBuf, (size_t)packSize));
+
+  mt->offset = offset;
+  mt->dest = dest;
+  mt->size = rem;
+  mt->nextBlock = first;
+  mt->limBlock = lim;
+  mt->res = SZ_OK;
+
+  for (i = 0; i < numThreads; i++)
+  {
+    CXzSeekThread *t = &mt->threads[i];
+    t->inStream.data = mt->inBuf;
+    t->inStream.size = (size_t)packSize;
+    t->inStream.pos = 0;
+    t->numDecodedBlocks = 0;
+  }
+
+  /* if a thread could not be started, the other threads decode its blocks */
+  numStarted = 1;
+  for (i = 1; i < numThreads; i++, numStarted++)
+    if (Event_Set(&mt->threads[i].startEvent) != 0)
+      break;
+  XzSeekMt_Work(mt, &mt->threads[0]);
+  for (i = 1; i < numStarted; i++)
+    Event_Wait(&mt->threads[i].finishedEvent);
+
+  for (i = 0; i < numStarted; i++)
+    p->numDecodedBlocks += mt->threads[i].numDecodedBlocks;
+  RINOK(mt->res);
+  *size = rem;
+  return SZ_OK;
+
+  #endif
+}
@@ -0,0 +1,136 @@
+/* XzSeek.h -- Random access reader for xz files
+2019-12-02 : Public domain */
+
+#ifndef __XZ_SEEK_H
+#define __XZ_SEEK_H
+
+#include "Xz.h"
+
+EXTERN_C_BEGIN
+
+#define XZ_SEEK_CACHE_BLOCKS_MAX 64
+#define XZ_SEEK_THREADS_MAX 64
+
+/*
+CXzSeek reads ranges of the decoded data of xz files with multiple blocks
+(for example, written by XzEnc with CXzProps::blockSize, or by "xz -T").
+XzSeek_Open() reads the indexes of all streams with Xzs_ReadBackward(),
+XzSeek_Read() decodes only the blocks that cover the requested range.
+
+Blocks up to (cacheBlockSizeMax) bytes are decoded completely (the check of
+the block is verified) and kept in a LRU cache of (numCacheBlocks) blocks.
+Larger blocks are decoded from their start until the end of the range,
+without caching, and their check is verified only if the range includes the
+end of the block.
+
+XzSeek_ReadMt() decodes the blocks of a range on several threads, each block
+is decoded directly to its part of the output buffer.
+
+CrcGenerateTable() and Crc64GenerateTable() must be called before.
+*/
+
+typedef struct
+{
+  UInt64 unpackPos;       /* position of the block in the decoded data */
+  UInt64 unpackSize;
+  UInt64 packPos;         /* position of the block header in the file */
+  UInt64 totalSize;       /* size of block header, packed data and check */
+  CXzStreamFlags flags;   /* flags of the stream of the block */
+} CXzSeekBlock;
+
+typedef struct
+{
+  size_t blockIndex;      /* (numBlocks), if the item is not used */
+  UInt64 lastUse;
+  Byte *data;
+  size_t allocSize;
+} CXzSeekCacheItem;
+
+typedef struct
+{
+  BoolInt created;
+  CXzUnpacker dec;
+  Byte *skipBuf;          /* for the decoded bytes before the range */
+} CXzSeekDecoder;
+
+struct CXzSeekMt_;
+
+typedef struct
+{
+  ISzAllocPtr alloc;
+  ISzAllocPtr allocBig;   /* for the cached blocks */
+  ILookInStream *inStream;
+
+  size_t numBlocks;
+  CXzSeekBlock *blocks;   /* sorted by (unpackPos) */
+  UInt64 unpackSize;      /* size of the decoded data of all streams */
+
+  unsigned numCacheBlocks;
+  size_t cacheBlockSizeMax;
+  UInt64 useCounter;
+  CXzSeekCacheItem cache[XZ_SEEK_CACHE_BLOCKS_MAX];
+
+  CXzSeekDecoder decoder;
+  struct CXzSeekMt_ *mt;  /* threads of XzSeek_ReadMt() */
+
+  /* statistics */
+  UInt64 numDecodedBlocks;
+  UInt64 numCacheHits;
+} CXzSeek;
+
+void XzSeek_Construct(CXzSeek *p, ISzAllocPtr alloc, ISzAllocPtr allocBig);
+void XzSeek_Free(CXzSeek *p);
+
+/*
+XzSeek_Open() reads the indexes of (inStream), that must contain only xz
+  streams (and stream padding). (inStream) is used by XzSeek_Read() until
+  XzSeek_Free() or the next XzSeek_Open().
+  (numCacheBlocks) is limited to XZ_SEEK_CACHE_BLOCKS_MAX, it can be 0.
+
+Returns:
+  SZ_OK
+  SZ_ERROR_NO_ARCHIVE  - it's not a xz file
+  SZ_ERROR_ARCHIVE     - incorrect index
+  SZ_ERROR_UNSUPPORTED - unsupported stream flags or sizes
+  SZ_ERROR_MEM         - memory allocation error
+  the error of (inStream)
+*/
+
+SRes XzSeek_Open(CXzSeek *p, ILookInStream *inStream, unsigned numCacheBlocks, size_t cacheBlockSizeMax);
+
+/*
+XzSeek_Read() reads up to (*size) bytes of the decoded data at (offset).
+  (*size) returns the number of bytes read, it's smaller only at the end of
+  the data.
+
+Returns:
+  SZ_OK
+  SZ_ERROR_DATA        - data error, or the block doesn't match the index
+  SZ_ERROR_CRC         - the check of a block is incorrect
+  SZ_ERROR_UNSUPPORTED - unsupported filters
+  SZ_ERROR_INPUT_EOF   - the file ends in a block
+  SZ_ERROR_MEM         - memory allocation error
+  the error of (inStream)
+*/
+
+SRes XzSeek_Read(CXzSeek *p, UInt64 offset, Byte *dest, size_t *size);
+
+/*
+XzSeek_ReadMt() is XzSeek_Read() with up to (numThreads) threads (limited to
+  XZ_SEEK_THREADS_MAX). The packed data of all blocks of the range is read
+  from (inStream) to memory first, then every thread decodes whole blocks
+  with its own CXzUnpacker directly to their positions in (dest). The cache
+  is not used. The threads are kept until XzSeek_Free().
+  It's the same as XzSeek_Read(), if the range is in one block, or if
+  (numThreads <= 1), or if the code was compiled with _7ZIP_ST.
+
+Returns:
+  the same as XzSeek_Read(), and
+  SZ_ERROR_THREAD      - the threads could not be created
+*/
+
+SRes XzSeek_ReadMt(CXzSeek *p, UInt64 offset, Byte *dest, size_t *size, unsigned numThreads);
+
+EXTERN_C_END
+
+#endif
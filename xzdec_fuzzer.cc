@@ -27,8 +27,10 @@
 
 #include "common-alloc.h"
 #include "common-buffer.h"
+#include "common-timing.h"
 
 extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  ScopedInputTimer timer(data, size);
   CrcGenerateTable();
   Crc64GenerateTable();
 
@@ -40,9 +42,10 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
   CXzStatInfo stats;
   int isMt;
 
-  CXzDecMtHandle handle = XzDecMt_Create(&CommonAlloc, &CommonAlloc);
+  CXzDecMtHandle handle = XzDecMt_Create(&CommonAlloc, &CommonAllocMid);
   XzDecMt_Decode(handle, &props, nullptr, 1, out_buffer.stream(),
       in_buffer.stream(), &stats, &isMt, nullptr);
   XzDecMt_Destroy(handle);
+  timer.add_decoded_size(out_buffer.size());
   return 0;
 }
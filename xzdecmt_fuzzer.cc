@@ -0,0 +1,111 @@
+/**
+ *
+ * @copyright Copyright (c) 2019 Joachim Bauch <mail@joachim-bauch.de>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "7zCrc.h"
+#include "Xz.h"
+#include "XzCrc64.h"
+
+#include "common-alloc.h"
+#include "common-buffer.h"
+
+// The first bytes of the input select the properties of the multithreaded
+// decoder, the remaining data is the xz stream.
+static const size_t kPropsSize = 3;
+
+// Maximum number of threads to use for decoding.
+static const unsigned kMaxThreads = 8;
+
+// If the environment variable "BENCHMARK_MT_ONLY" is set, the single-threaded
+// reference decoding is skipped so benchmarks only measure the multithreaded
+// decoder (see "scripts/benchmark-decmt.sh").
+static bool SkipReference() {
+  static const bool skip = getenv("BENCHMARK_MT_ONLY") != nullptr;
+  return skip;
+}
+
+static SRes Decode(const CXzDecMtProps &props, const uint8_t *data,
+    size_t size, OutputBuffer *out_buffer, CXzStatInfo *stats) {
+  InputBuffer in_buffer(data, size);
+  int isMt;
+
+  CXzDecMtHandle handle = XzDecMt_Create(&CommonAlloc, &CommonAllocMid);
+  if (!handle) {
+    return SZ_ERROR_MEM;
+  }
+
+  SRes res = XzDecMt_Decode(handle, &props, nullptr, 1, out_buffer->stream(),
+      in_buffer.stream(), stats, &isMt, nullptr);
+  XzDecMt_Destroy(handle);
+  return res;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  if (size < kPropsSize) {
+    return 0;
+  }
+
+  CrcGenerateTable();
+  Crc64GenerateTable();
+
+  CXzDecMtProps props;
+  XzDecMtProps_Init(&props);
+#ifndef _7ZIP_ST
+  props.numThreads = 1 + data[0] % kMaxThreads;
+  props.inBufSize_MT = static_cast<size_t>(1) << (10 + data[1] % 9);
+  props.memUseMax = static_cast<size_t>(1) << (16 + data[2] % 13);
+#else
+  // Only the buffer sizes can be changed in single-threaded builds.
+  props.inBufSize_ST = static_cast<size_t>(1) << (10 + data[1] % 9);
+  props.outStep_ST = static_cast<size_t>(1) << (10 + data[2] % 11);
+#endif
+  data += kPropsSize;
+  size -= kPropsSize;
+
+  OutputBuffer out_buffer;
+  CXzStatInfo stats;
+  SRes res = Decode(props, data, size, &out_buffer, &stats);
+  if (SkipReference()) {
+    return 0;
+  }
+
+  CXzDecMtProps reference_props;
+  XzDecMtProps_Init(&reference_props);
+  OutputBuffer reference_buffer;
+  CXzStatInfo reference_stats;
+  SRes reference_res = Decode(reference_props, data, size, &reference_buffer,
+      &reference_stats);
+  if (reference_res == SZ_OK) {
+    // The single-threaded decoder also returns SZ_OK for truncated or broken
+    // streams and only reports the error in "DecodeRes". Only streams that
+    // were decoded completely must also succeed with any number of threads,
+    // the decoded data must always be the same.
+    if (reference_stats.DecodeRes == SZ_OK) {
+      assert(res == SZ_OK);
+    }
+    assert(out_buffer.Equals(reference_buffer.data(),
+        reference_buffer.size()));
+  }
+  return 0;
+}
@@ -25,10 +25,25 @@
 #include "Xz.h"
 #include "XzCrc64.h"
 #include "XzEnc.h"
+#include "XzEncTune.h"
 
 #include "common-alloc.h"
 #include "common-buffer.h"
 
+#ifndef _7ZIP_ST
+// Encode blocks in parallel if built with "ENABLE_MT=1". The block size is
+// small enough so inputs can be split into multiple blocks.
+static const int kNumThreads = 2;
+static const UInt64 kBlockSize = 16 * 1024;
+#endif
+
+// Block sizes that are small enough for fuzzer inputs if the block size is
+// selected by XzEnc_TuneBlockSize.
+static const unsigned kTuneThreads = 4;
+static const UInt64 kTuneMinBlockSize = 1024;
+static const UInt64 kTuneMaxBlockSize = 64 * 1024;
+static const UInt64 kTuneSampleSize = 32 * 1024;
+
 extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
   if (size < 3) {
     return 0;
@@ -40,6 +55,11 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
   SRes res;
   CXzProps props;
   XzProps_Init(&props);
+#ifndef _7ZIP_ST
+  props.blockSize = kBlockSize;
+  props.numBlockThreads_Max = kNumThreads;
+  props.numTotalThreads = kNumThreads;
+#endif
 
   switch (data[0]) {
     case XZ_CHECK_NO:
@@ -69,10 +89,33 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
       break;
   }
 
+  if (data[0] & 0x80) {
+    CXzEncTuneProps tune_props;
+    XzEncTuneProps_Init(&tune_props);
+    tune_props.numThreads = kTuneThreads;
+    tune_props.maxLoss = data[2];
+    tune_props.minBlockSize = kTuneMinBlockSize;
+    tune_props.maxBlockSize = kTuneMaxBlockSize;
+    tune_props.sampleSize = kTuneSampleSize;
+    CXzEncTuneResult result;
+    res = XzEnc_TuneBlockSize(&props, &tune_props, data, size, size, &result,
+        &CommonAlloc, &CommonAllocBig);
+    assert(res == SZ_OK);
+    assert(props.blockSize == result.blockSize);
+    assert(props.forceWriteSizesInHeader);
+    assert(result.blockSize >= kTuneMinBlockSize);
+    assert(result.numBlocks == (size + result.blockSize - 1) / result.blockSize);
+    assert(result.numCandidates > 0);
+    for (unsigned i = 1; i < result.numCandidates; i++) {
+      assert(result.candidates[i - 1].blockSize <
+          result.candidates[i].blockSize);
+    }
+  }
+
   OutputBuffer out_buffer;
   InputBuffer in_buffer(data, size);
   CXzEncHandle enc;
-  enc = XzEnc_Create(&CommonAlloc, &CommonAlloc);
+  enc = XzEnc_Create(&CommonAlloc, &CommonAllocBig);
   if (XzEnc_SetProps(enc, &props) != SZ_OK) {
     goto exit;
   }
@@ -87,16 +130,22 @@ extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
     XzDecMtProps_Init(&dec_props);
 
     OutputBuffer dec_out_buffer;
-    InputBuffer dec_in_buffer(out_buffer.data(), out_buffer.size());
+    InputBuffer dec_in_buffer(out_buffer);
     CXzStatInfo stats;
     int isMt;
 
-    CXzDecMtHandle dec = XzDecMt_Create(&CommonAlloc, &CommonAlloc);
+    CXzDecMtHandle dec = XzDecMt_Create(&CommonAlloc, &CommonAllocMid);
     res = XzDecMt_Decode(dec, &dec_props, nullptr, 1, dec_out_buffer.stream(),
         dec_in_buffer.stream(), &stats, &isMt, nullptr);
     assert(res == SZ_OK);
-    assert(dec_out_buffer.size() == size);
-    assert(memcmp(data, dec_out_buffer.data(), size) == 0);
+    assert(dec_out_buffer.Equals(data, size));
+    if ((data[0] & 0x80) && stats.NumBlocks_Defined) {
+      // Every block of the tuned size can be decoded by its own thread. The
+      // single-threaded encoder adds an empty block if the last block is full.
+      UInt64 num_blocks = (size + props.blockSize - 1) / props.blockSize;
+      assert(stats.NumBlocks == num_blocks ||
+          (size % props.blockSize == 0 && stats.NumBlocks == num_blocks + 1));
+    }
     XzDecMt_Destroy(dec);
   }
 
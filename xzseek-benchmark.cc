@@ -0,0 +1,161 @@
+/**
+ *
+ * @copyright Copyright (c) 2019 Joachim Bauch <mail@joachim-bauch.de>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+// Measures how XzSeek_ReadMt scales with the number of threads. The input
+// files are concatenated and encoded to a xz file with the given block size,
+// then the whole data is read with 1, 2, 4, ... threads and the best run of
+// each is reported.
+//
+// Usage: xzseek-benchmark [-block=KiB] [-threads=N] [-runs=N] <file>...
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "7zCrc.h"
+#include "Alloc.h"
+#include "XzCrc64.h"
+#include "XzEnc.h"
+#include "XzSeek.h"
+
+#include "common-buffer.h"
+
+static const size_t kDefaultBlockKiB = 1024;
+static const unsigned kDefaultThreads = 8;
+static const int kDefaultRuns = 3;
+
+typedef std::chrono::steady_clock Clock;
+
+static bool ReadFile(const char *filename, std::vector<uint8_t> *data) {
+  FILE *f = fopen(filename, "rb");
+  if (!f) {
+    return false;
+  }
+
+  uint8_t buffer[64 * 1024];
+  size_t len;
+  while ((len = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+    data->insert(data->end(), buffer, buffer + len);
+  }
+  bool result = !ferror(f);
+  fclose(f);
+  return result;
+}
+
+static void Usage(const char *program) {
+  fprintf(stderr, "Usage: %s [-block=KiB] [-threads=N] [-runs=N] <file>...\n",
+      program);
+}
+
+int main(int argc, char **argv) {
+  size_t block_kib = kDefaultBlockKiB;
+  unsigned max_threads = kDefaultThreads;
+  int runs = kDefaultRuns;
+  std::vector<uint8_t> input;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (!strncmp(arg, "-block=", 7)) {
+      block_kib = strtoul(arg + 7, nullptr, 10);
+    } else if (!strncmp(arg, "-threads=", 9)) {
+      max_threads = static_cast<unsigned>(strtoul(arg + 9, nullptr, 10));
+    } else if (!strncmp(arg, "-runs=", 6)) {
+      runs = atoi(arg + 6);
+    } else if (arg[0] == '-') {
+      Usage(argv[0]);
+      return 1;
+    } else if (!ReadFile(arg, &input)) {
+      fprintf(stderr, "Could not read %s\n", arg);
+      return 1;
+    }
+  }
+  if (input.empty() || !block_kib || !max_threads || runs < 1) {
+    Usage(argv[0]);
+    return 1;
+  }
+
+  CrcGenerateTable();
+  Crc64GenerateTable();
+
+  CXzProps props;
+  XzProps_Init(&props);
+  props.blockSize = block_kib * 1024;
+  OutputBuffer encoded;
+  InputBuffer in_buffer(input.data(), input.size());
+  CXzEncHandle enc = XzEnc_Create(&g_Alloc, &g_BigAlloc);
+  SRes res = XzEnc_SetProps(enc, &props);
+  if (res == SZ_OK) {
+    XzEnc_SetDataSize(enc, input.size());
+    res = XzEnc_Encode(enc, encoded.stream(), in_buffer.stream(), nullptr);
+  }
+  XzEnc_Destroy(enc);
+  if (res != SZ_OK) {
+    fprintf(stderr, "Encoding failed (%d)\n", res);
+    return 1;
+  }
+
+  std::vector<uint8_t> file(encoded.data(), encoded.data() + encoded.size());
+  InputLookBuffer file_stream(file.data(), file.size());
+  CXzSeek seek;
+  XzSeek_Construct(&seek, &g_Alloc, &g_BigAlloc);
+  res = XzSeek_Open(&seek, file_stream.stream(), 0, 0);
+  if (res != SZ_OK) {
+    fprintf(stderr, "Opening failed (%d)\n", res);
+    return 1;
+  }
+
+#ifdef _7ZIP_ST
+  printf("built without ENABLE_MT=1, only one thread is used\n\n");
+#endif
+  printf("input: %zu bytes, encoded: %zu bytes, %zu blocks of %zu KiB\n\n",
+      input.size(), file.size(), seek.numBlocks, block_kib);
+  printf("%8s %10s %8s\n", "threads", "MB/s", "speedup");
+  std::vector<uint8_t> output(input.size());
+  uint64_t single_ns = 0;
+  for (unsigned threads = 1; threads <= max_threads; threads *= 2) {
+    uint64_t best = 0;
+    for (int i = 0; i < runs; i++) {
+      size_t size = output.size();
+      Clock::time_point start = Clock::now();
+      res = XzSeek_ReadMt(&seek, 0, output.data(), &size, threads);
+      uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+          Clock::now() - start).count();
+      if (res != SZ_OK || size != input.size() || output != input) {
+        fprintf(stderr, "Reading failed (%d)\n", res);
+        return 1;
+      }
+      ns = std::max<uint64_t>(ns, 1);
+      if (!best || ns < best) {
+        best = ns;
+      }
+    }
+    if (threads == 1) {
+      single_ns = best;
+    }
+    printf("%8u %10.1f %7.2fx\n", threads, input.size() * 1e3 / best,
+        static_cast<double>(single_ns) / best);
+  }
+  XzSeek_Free(&seek);
+  return 0;
+}
@@ -0,0 +1,211 @@
+/**
+ *
+ * @copyright Copyright (c) 2019 Joachim Bauch <mail@joachim-bauch.de>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+// Checks the random access reader of "XzSeek.h":
+// - the input is opened as xz file, reads in chunks and a read of everything
+//   with several threads must match the data of a complete decode if that
+//   succeeds.
+// - the input is encoded to two xz streams with small blocks, reads of random
+//   ranges (with and without cache, and with several threads) must match the
+//   input.
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "7zCrc.h"
+#include "Xz.h"
+#include "XzCrc64.h"
+#include "XzEnc.h"
+#include "XzSeek.h"
+
+#include "common-alloc.h"
+#include "common-buffer.h"
+#include "common-timing.h"
+
+// Limit maximum size to avoid running into timeouts with too large data.
+static const size_t kMaxInputSize = 100 * 1024;
+static const size_t kMaxDecodedSize = 1024 * 1024;
+static const size_t kReadSize = 4096;
+static const size_t kNumReads = 16;
+// Threads are only used if built with "ENABLE_MT=1".
+static const unsigned kNumThreads = 3;
+
+// Read the whole file in chunks, must give "expected" if it is not null.
+static void CheckFile(const uint8_t *data, size_t size,
+    const std::vector<uint8_t> *expected) {
+  InputLookBuffer input(data, size);
+  CXzSeek seek;
+  XzSeek_Construct(&seek, &CommonAlloc, &CommonAllocBig);
+  SRes res = XzSeek_Open(&seek, input.stream(), 2, kReadSize);
+  if (res != SZ_OK || seek.unpackSize > kMaxDecodedSize) {
+    assert(res == SZ_OK || !expected);
+    XzSeek_Free(&seek);
+    return;
+  }
+
+  if (expected) {
+    assert(seek.unpackSize == expected->size());
+  }
+  std::vector<uint8_t> dest(kReadSize);
+  for (UInt64 offset = 0; offset < seek.unpackSize; ) {
+    size_t len = dest.size();
+    res = XzSeek_Read(&seek, offset, dest.data(), &len);
+    assert(res == SZ_OK || !expected);
+    if (res != SZ_OK) {
+      break;
+    }
+    assert(len == std::min<UInt64>(dest.size(), seek.unpackSize - offset));
+    if (expected) {
+      assert(!memcmp(dest.data(), expected->data() + offset, len));
+    }
+    offset += len;
+  }
+
+  dest.resize(seek.unpackSize);
+  size_t len = dest.size();
+  res = XzSeek_ReadMt(&seek, 0, dest.data(), &len, kNumThreads);
+  assert(res == SZ_OK || !expected);
+  if (res == SZ_OK) {
+    assert(len == dest.size());
+    assert(!expected || *expected == dest);
+  }
+  XzSeek_Free(&seek);
+}
+
+static bool Decode(const uint8_t *data, size_t size,
+    std::vector<uint8_t> *decoded) {
+  CXzDecMtProps props;
+  XzDecMtProps_Init(&props);
+
+  OutputBuffer out_buffer;
+  InputBuffer in_buffer(data, size);
+  CXzStatInfo stats;
+  int isMt;
+
+  CXzDecMtHandle handle = XzDecMt_Create(&CommonAlloc, &CommonAllocMid);
+  UInt64 out_size = kMaxDecodedSize + 1;
+  SRes res = XzDecMt_Decode(handle, &props, &out_size, 0,
+      out_buffer.stream(), in_buffer.stream(), &stats, &isMt, nullptr);
+  XzDecMt_Destroy(handle);
+  // The result of the decoder is only reported in the stats.
+  if (res != SZ_OK || stats.DecodeRes != SZ_OK || stats.DataAfterEnd ||
+      stats.DecodingTruncated || stats.InSize != size) {
+    return false;
+  }
+
+  decoded->assign(out_buffer.data(), out_buffer.data() + out_buffer.size());
+  return true;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  if (IsInputTooLarge(size, kMaxInputSize)) {
+    return 0;
+  }
+
+  ScopedInputTimer timer(data, size);
+  if (size < 2) {
+    return 0;
+  }
+
+  CrcGenerateTable();
+  Crc64GenerateTable();
+
+  std::vector<uint8_t> decoded;
+  bool valid = Decode(data, size, &decoded);
+  timer.add_decoded_size(decoded.size());
+  CheckFile(data, size, valid ? &decoded : nullptr);
+
+  CXzProps props;
+  XzProps_Init(&props);
+  props.lzma2Props.lzmaProps.level = 1;
+  props.blockSize = 256 * (1 + data[0] % 16);
+  switch (data[1] % 4) {
+    case 0:
+      props.checkId = XZ_CHECK_NO;
+      break;
+    case 1:
+      props.checkId = XZ_CHECK_CRC32;
+      break;
+    case 2:
+      props.checkId = XZ_CHECK_CRC64;
+      break;
+    default:
+      props.checkId = XZ_CHECK_SHA256;
+      break;
+  }
+
+  OutputBuffer out_buffer;
+  InputBuffer in_buffer(data, size);
+  CXzEncHandle enc = XzEnc_Create(&CommonAlloc, &CommonAllocBig);
+  SRes res = XzEnc_SetProps(enc, &props);
+  assert(res == SZ_OK);
+  XzEnc_SetDataSize(enc, size);
+  res = XzEnc_Encode(enc, out_buffer.stream(), in_buffer.stream(), nullptr);
+  assert(res == SZ_OK);
+  XzEnc_Destroy(enc);
+
+  // Two streams with stream padding between them.
+  std::vector<uint8_t> file(out_buffer.data(),
+      out_buffer.data() + out_buffer.size());
+  file.resize(file.size() + 4);
+  file.insert(file.end(), out_buffer.data(),
+      out_buffer.data() + out_buffer.size());
+
+  size_t seed = size;
+  for (size_t i = 0; i < size; i++) {
+    seed = seed * 31 + data[i];
+  }
+
+  InputLookBuffer input(file.data(), file.size());
+  CXzSeek seek;
+  XzSeek_Construct(&seek, &CommonAlloc, &CommonAllocBig);
+  // Without cache, blocks are decoded only until the end of the range.
+  unsigned num_cache_blocks = seed % 3;
+  res = XzSeek_Open(&seek, input.stream(), num_cache_blocks,
+      props.blockSize);
+  assert(res == SZ_OK);
+  assert(seek.unpackSize == 2 * size);
+  assert(seek.numBlocks == 2 * ((size + props.blockSize - 1) /
+      props.blockSize));
+
+  std::vector<uint8_t> dest;
+  for (size_t i = 0; i < kNumReads; i++) {
+    size_t offset = (seed >> i) % (2 * size + 1);
+    size_t len = (seed >> (i + 8)) % (2 * props.blockSize + 1) + i % 2;
+    dest.resize(len);
+    if (i % 2) {
+      res = XzSeek_ReadMt(&seek, offset, dest.data(), &len, 2 + i % 4);
+    } else {
+      res = XzSeek_Read(&seek, offset, dest.data(), &len);
+    }
+    assert(res == SZ_OK);
+    assert(len == std::min(dest.size(), 2 * size - offset));
+    for (size_t j = 0; j < len; j++) {
+      assert(dest[j] == data[(offset + j) % size]);
+    }
+  }
+  XzSeek_Free(&seek);
+  return 0;
+}
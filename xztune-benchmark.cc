@@ -0,0 +1,226 @@
+/**
+ *
+ * @copyright Copyright (c) 2019 Joachim Bauch <mail@joachim-bauch.de>
+ *
+ * @license GNU GPL version 3 or any later version
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ */
+
+// Shows the trade-off XzEnc_TuneBlockSize selects for the input files. The
+// files are concatenated, the candidates measured on the sample are printed,
+// then the input is encoded with the selected block size and as one solid
+// block. The real loss of the compression ratio is reported together with
+// the speed of decoding both files with XzDecMt on 1 and N threads.
+//
+// Usage: xztune-benchmark [-threads=N] [-loss=N] [-sample=KiB] [-runs=N]
+//            <file>...
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "7zCrc.h"
+#include "Alloc.h"
+#include "Xz.h"
+#include "XzCrc64.h"
+#include "XzEnc.h"
+#include "XzEncTune.h"
+
+#include "common-buffer.h"
+
+static const int kDefaultRuns = 3;
+
+typedef std::chrono::steady_clock Clock;
+
+static bool ReadFile(const char *filename, std::vector<uint8_t> *data) {
+  FILE *f = fopen(filename, "rb");
+  if (!f) {
+    return false;
+  }
+
+  uint8_t buffer[64 * 1024];
+  size_t len;
+  while ((len = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+    data->insert(data->end(), buffer, buffer + len);
+  }
+  bool result = !ferror(f);
+  fclose(f);
+  return result;
+}
+
+static uint64_t ElapsedNs(Clock::time_point start) {
+  uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      Clock::now() - start).count();
+  return std::max<uint64_t>(ns, 1);
+}
+
+static SRes Encode(const CXzProps *props, const std::vector<uint8_t> &input,
+    OutputBuffer *encoded) {
+  InputBuffer in_buffer(input.data(), input.size());
+  CXzEncHandle enc = XzEnc_Create(&g_Alloc, &g_BigAlloc);
+  SRes res = XzEnc_SetProps(enc, props);
+  if (res == SZ_OK) {
+    XzEnc_SetDataSize(enc, input.size());
+    res = XzEnc_Encode(enc, encoded->stream(), in_buffer.stream(), nullptr);
+  }
+  XzEnc_Destroy(enc);
+  return res;
+}
+
+// Returns the best time of decoding "encoded" in "runs" runs or 0 on errors.
+static uint64_t Decode(const OutputBuffer &encoded,
+    const std::vector<uint8_t> &input, unsigned threads, int runs) {
+  CXzDecMtProps props;
+  XzDecMtProps_Init(&props);
+#ifndef _7ZIP_ST
+  props.numThreads = threads;
+#else
+  (void) threads;
+#endif
+
+  uint64_t best = 0;
+  CXzDecMtHandle dec = XzDecMt_Create(&g_Alloc, &g_MidAlloc);
+  for (int i = 0; i < runs; i++) {
+    OutputBuffer output;
+    InputBuffer in_buffer(encoded);
+    CXzStatInfo stats;
+    int is_mt;
+    Clock::time_point start = Clock::now();
+    SRes res = XzDecMt_Decode(dec, &props, nullptr, 1, output.stream(),
+        in_buffer.stream(), &stats, &is_mt, nullptr);
+    uint64_t ns = ElapsedNs(start);
+    if (res != SZ_OK || stats.DecodeRes != SZ_OK ||
+        !output.Equals(input.data(), input.size())) {
+      best = 0;
+      break;
+    }
+    if (!best || ns < best) {
+      best = ns;
+    }
+  }
+  XzDecMt_Destroy(dec);
+  return best;
+}
+
+static void Usage(const char *program) {
+  fprintf(stderr, "Usage: %s [-threads=N] [-loss=N] [-sample=KiB] [-runs=N] "
+      "<file>...\n", program);
+}
+
+int main(int argc, char **argv) {
+  CXzEncTuneProps tune_props;
+  XzEncTuneProps_Init(&tune_props);
+  int runs = kDefaultRuns;
+  std::vector<uint8_t> input;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    if (!strncmp(arg, "-threads=", 9)) {
+      tune_props.numThreads =
+          static_cast<unsigned>(strtoul(arg + 9, nullptr, 10));
+    } else if (!strncmp(arg, "-loss=", 6)) {
+      tune_props.maxLoss = static_cast<UInt32>(strtoul(arg + 6, nullptr, 10));
+    } else if (!strncmp(arg, "-sample=", 8)) {
+      tune_props.sampleSize =
+          static_cast<UInt64>(strtoul(arg + 8, nullptr, 10)) * 1024;
+    } else if (!strncmp(arg, "-runs=", 6)) {
+      runs = atoi(arg + 6);
+    } else if (arg[0] == '-') {
+      Usage(argv[0]);
+      return 1;
+    } else if (!ReadFile(arg, &input)) {
+      fprintf(stderr, "Could not read %s\n", arg);
+      return 1;
+    }
+  }
+  if (input.empty() || runs < 1) {
+    Usage(argv[0]);
+    return 1;
+  }
+
+  CrcGenerateTable();
+  Crc64GenerateTable();
+
+  CXzProps props;
+  XzProps_Init(&props);
+  CXzEncTuneResult result;
+  Clock::time_point start = Clock::now();
+  SRes res = XzEnc_TuneBlockSize(&props, &tune_props, input.data(),
+      input.size(), input.size(), &result, &g_Alloc, &g_BigAlloc);
+  uint64_t tune_ns = ElapsedNs(start);
+  if (res != SZ_OK) {
+    fprintf(stderr, "Tuning failed (%d)\n", res);
+    return 1;
+  }
+
+  printf("input: %zu bytes, sample: %llu bytes, solid: %llu bytes, "
+      "tuning: %.1f ms\n\n", input.size(),
+      static_cast<unsigned long long>(result.sampleSize),
+      static_cast<unsigned long long>(result.solidPackSize), tune_ns / 1e6);
+  printf("%10s %8s %12s %7s\n", "block KiB", "blocks", "sample pack", "loss %");
+  for (unsigned i = 0; i < result.numCandidates; i++) {
+    const CXzEncTuneCandidate &c = result.candidates[i];
+    printf("%10.1f %8llu %12llu %7.1f%s%s\n", c.blockSize / 1024.0,
+        static_cast<unsigned long long>(
+            (input.size() + c.blockSize - 1) / c.blockSize),
+        static_cast<unsigned long long>(c.packSize), c.loss / 10.0,
+        c.measured ? "" : " (estimated)",
+        c.blockSize == result.blockSize ? " <-" : "");
+  }
+  printf("\nselected: %.1f KiB, %llu blocks, estimated loss %.1f %%%s\n\n",
+      result.blockSize / 1024.0,
+      static_cast<unsigned long long>(result.numBlocks), result.loss / 10.0,
+      result.targetReached ? "" : " (target not reached)");
+
+  OutputBuffer tuned;
+  res = Encode(&props, input, &tuned);
+  if (res == SZ_OK) {
+    CXzProps solid_props;
+    XzProps_Init(&solid_props);
+    solid_props.blockSize = XZ_PROPS__BLOCK_SIZE__SOLID;
+    OutputBuffer solid;
+    res = Encode(&solid_props, input, &solid);
+    if (res == SZ_OK) {
+#ifdef _7ZIP_ST
+      printf("built without ENABLE_MT=1, XzDecMt uses one thread\n");
+#endif
+      printf("%8s %12s %7s %14s %14s\n", "file", "size", "loss %",
+          "MB/s 1 thread", "MB/s threads");
+      const OutputBuffer *files[] = {&solid, &tuned};
+      const char *names[] = {"solid", "tuned"};
+      for (int i = 0; i < 2; i++) {
+        uint64_t single_ns = Decode(*files[i], input, 1, runs);
+        uint64_t multi_ns = Decode(*files[i], input, tune_props.numThreads,
+            runs);
+        if (!single_ns || !multi_ns) {
+          fprintf(stderr, "Decoding failed\n");
+          return 1;
+        }
+        printf("%8s %12zu %7.2f %14.1f %14.1f\n", names[i], files[i]->size(),
+            (static_cast<double>(files[i]->size()) / solid.size() - 1) * 100,
+            input.size() * 1e3 / single_ns, input.size() * 1e3 / multi_ns);
+      }
+    }
+  }
+  if (res != SZ_OK) {
+    fprintf(stderr, "Encoding failed (%d)\n", res);
+    return 1;
+  }
+  return 0;
+}